@@ -0,0 +1,302 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "corpus.h"
+#include "ini_reader.h"
+#include "loopback.h"
+#include "misc.h"
+#include "nodeinfo.h"
+#include "printout.h"
+#include "renderer.h"
+#include "speedtestutil.h"
+#include "version.h"
+
+std::string ssrspeed_generate_results(std::vector<nodeInfo> &nodes);
+
+struct benchResult
+{
+    std::string name;
+    unsigned int items = 0;
+    size_t bytes = 0;
+    int rounds = 0;
+    double min_ms = 0.0;
+    double median_ms = 0.0;
+    std::string skipped;
+};
+
+static std::vector<benchResult> bench_results;
+static int bench_rounds = 5;
+static std::string bench_filter;
+
+static inline bool benchSelected(const std::string &name)
+{
+    return bench_filter.empty() || name.find(bench_filter) != name.npos;
+}
+
+static void benchSkip(const std::string &name, const std::string &reason)
+{
+    if(!benchSelected(name))
+        return;
+    benchResult result;
+    result.name = name;
+    result.skipped = reason;
+    bench_results.emplace_back(std::move(result));
+}
+
+//setup runs before every round and is not measured
+template <typename S, typename F> static void runBench(const std::string &name, unsigned int items, size_t bytes, S &&setup, F &&func)
+{
+    if(!benchSelected(name))
+        return;
+    std::vector<double> elapsed;
+    setup();
+    func(); //warm up
+    for(int i = 0; i < bench_rounds; i++)
+    {
+        setup();
+        auto start = std::chrono::steady_clock::now();
+        func();
+        elapsed.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(elapsed.begin(), elapsed.end());
+
+    benchResult result;
+    result.name = name;
+    result.items = items;
+    result.bytes = bytes;
+    result.rounds = bench_rounds;
+    result.min_ms = elapsed.front();
+    result.median_ms = elapsed[elapsed.size() / 2];
+    std::cerr << name << ": " << result.median_ms << " ms" << std::endl;
+    bench_results.emplace_back(std::move(result));
+}
+
+template <typename F> static void runBench(const std::string &name, unsigned int items, size_t bytes, F &&func)
+{
+    runBench(name, items, bytes, []{}, func);
+}
+
+static size_t bench_sink = 0;
+
+static void benchExplodeSub()
+{
+    const unsigned int count = 1000;
+    const std::pair<std::string, std::string> formats[] = {{"ss", corpusSSSub(count)}, {"ssr", corpusSSRSub(count)}, {"vmess", corpusVMessSub(count)},
+                                                           {"clash", corpusClash(count)}, {"surge", corpusSurge(count)}, {"ssd", corpusSSD(count)}};
+    for(auto &x : formats)
+    {
+        runBench("explodeSub_" + x.first + "_" + std::to_string(count), count, x.second.size(), [&]()
+        {
+            std::vector<nodeInfo> nodes;
+            explodeSub(x.second, false, false, "", nodes);
+            bench_sink += nodes.size();
+        });
+    }
+}
+
+static void benchBase64()
+{
+    const std::string raw = corpusBinary(1 << 20), encoded = base64_encode(raw);
+    runBench("base64_decode_1MiB", 1, encoded.size(), [&]()
+    {
+        bench_sink += base64_decode(encoded).size();
+    });
+    runBench("base64_encode_1MiB", 1, raw.size(), [&]()
+    {
+        bench_sink += base64_encode(raw).size();
+    });
+}
+
+static void benchFilterNodes()
+{
+    const unsigned int count = 10000;
+    const std::vector<nodeInfo> source = corpusResultNodes(count);
+    std::vector<nodeInfo> nodes;
+    for(unsigned int patterns : {1, 10, 100})
+    {
+        string_array exclude = corpusPatterns(patterns), include;
+        runBench("filterNodes_" + std::to_string(count) + "_patterns_" + std::to_string(patterns), count, 0, [&]() { nodes = source; }, [&]()
+        {
+            filterNodes(nodes, exclude, include, 0);
+            bench_sink += nodes.size();
+        });
+    }
+}
+
+static void benchConstruct()
+{
+    const unsigned int count = 10000;
+    runBench("ssConstruct_" + std::to_string(count), count, 0, [&]()
+    {
+        for(unsigned int i = 0; i < count; i++)
+            bench_sink += ssConstruct("Bench", "Node " + std::to_string(i), "server.example.com", "8388", "password", "aes-128-gcm", "obfs-local", "obfs=http;obfs-host=example.com", false).size();
+    });
+    runBench("ssrConstruct_" + std::to_string(count), count, 0, [&]()
+    {
+        for(unsigned int i = 0; i < count; i++)
+            bench_sink += ssrConstruct("Bench", "Node " + std::to_string(i), "", "server.example.com", "8388", "auth_aes128_md5", "aes-256-cfb", "tls1.2_ticket_auth", "password", "example.com", "", false).size();
+    });
+    runBench("vmessConstruct_" + std::to_string(count), count, 0, [&]()
+    {
+        for(unsigned int i = 0; i < count; i++)
+            bench_sink += vmessConstruct("Bench", "Node " + std::to_string(i), "server.example.com", "443", "none", "00000000-0000-4000-8000-000000000000", "0", "ws", "auto", "/path", "server.example.com", "", "tls").size();
+    });
+    runBench("trojanConstruct_" + std::to_string(count), count, 0, [&]()
+    {
+        for(unsigned int i = 0; i < count; i++)
+            bench_sink += trojanConstruct("Bench", "Node " + std::to_string(i), "server.example.com", "443", "password", "server.example.com", true).size();
+    });
+}
+
+static void benchIni()
+{
+    const unsigned int sections = 50000;
+    const std::string log = corpusResultLog(sections), surge = corpusSurge(sections);
+
+    runBench("ini_parse_result_log_" + std::to_string(sections), sections, log.size(), [&]()
+    {
+        INIReader ini;
+        ini.Parse(log);
+        bench_sink += ini.SectionCount();
+    });
+    runBench("ini_parse_surge_proxy_" + std::to_string(sections), sections, surge.size(), [&]()
+    {
+        INIReader ini;
+        ini.store_isolated_line = true;
+        ini.keep_empty_section = false;
+        ini.allow_dup_section_titles = true;
+        ini.SetIsolatedItemsSection("Proxy");
+        ini.IncludeSection("Proxy");
+        ini.AddDirectSaveSection("Proxy");
+        ini.Parse(surge);
+        bench_sink += ini.ItemCount("Proxy");
+    });
+
+    INIReader ini;
+    ini.Parse(log);
+    string_array section_names = ini.GetSections();
+    runBench("ini_lookup_result_log_" + std::to_string(sections), sections, 0, [&]()
+    {
+        for(std::string &x : section_names)
+            bench_sink += ini.Get(x, "AvgSpeed").size();
+    });
+    runBench("ini_tostring_result_log_" + std::to_string(sections), sections, log.size(), [&]()
+    {
+        bench_sink += ini.ToString().size();
+    });
+}
+
+static void benchRender()
+{
+    const std::string font = "tools" PATH_SLASH "misc" PATH_SLASH "WenQuanYiMicroHei-01.ttf", path = "bench_render.log";
+    for(unsigned int count : {100, 1000, 10000})
+    {
+        std::string name = "exportRender_" + std::to_string(count);
+        if(!fileExist(font))
+        {
+            benchSkip(name, "font not found, run from the program directory");
+            continue;
+        }
+        std::vector<nodeInfo> nodes = corpusResultNodes(count);
+        runBench(name, count, 0, [&]()
+        {
+            bench_sink += exportRender(path, nodes, true, "speed", "rainbow", true, true).size();
+        });
+    }
+    remove("bench_render.png");
+}
+
+static void benchWebResults()
+{
+    for(unsigned int count : {1000, 10000})
+    {
+        std::vector<nodeInfo> nodes = corpusResultNodes(count);
+        runBench("ssrspeed_generate_results_" + std::to_string(count), count, 0, [&]()
+        {
+            bench_sink += ssrspeed_generate_results(nodes).size();
+        });
+    }
+}
+
+//names and key order never change between runs so that two outputs can be diffed directly
+static std::string benchToJSON()
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(sb);
+    writer.StartObject();
+    writer.Key("version");
+    writer.String(VERSION);
+    writer.Key("rounds");
+    writer.Int(bench_rounds);
+    writer.Key("benchmarks");
+    writer.StartArray();
+    for(benchResult &x : bench_results)
+    {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(x.name.data());
+        if(x.skipped.size())
+        {
+            writer.Key("skipped");
+            writer.String(x.skipped.data());
+            writer.EndObject();
+            continue;
+        }
+        writer.Key("items");
+        writer.Uint(x.items);
+        writer.Key("bytes");
+        writer.Uint64(x.bytes);
+        writer.Key("min_ms");
+        writer.Double(x.min_ms);
+        writer.Key("median_ms");
+        writer.Double(x.median_ms);
+        writer.Key("items_per_sec");
+        writer.Double(x.median_ms > 0.0 ? x.items * 1000.0 / x.median_ms : 0.0);
+        writer.Key("mib_per_sec");
+        writer.Double(x.median_ms > 0.0 ? x.bytes / 1048576.0 * 1000.0 / x.median_ms : 0.0);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return sb.GetString();
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc > 1 && !strcmp(argv[1], "loopback"))
+        return runLoopback(argc - 1, argv + 1);
+
+    std::string output;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "--rounds") && argc > i + 1)
+            bench_rounds = std::max(1, to_int(argv[++i], 5));
+        else if(!strcmp(argv[i], "--filter") && argc > i + 1)
+            bench_filter.assign(argv[++i]);
+        else if(!strcmp(argv[i], "--output") && argc > i + 1)
+            output.assign(argv[++i]);
+    }
+
+    benchExplodeSub();
+    benchBase64();
+    benchFilterNodes();
+    benchConstruct();
+    benchIni();
+    benchRender();
+    benchWebResults();
+
+    std::string json = benchToJSON();
+    if(output.size())
+        fileWrite(output, json, true);
+    else
+        std::cout << json << std::endl;
+    return bench_sink ? 0 : 1;
+}
@@ -0,0 +1,248 @@
+#include <string>
+#include <vector>
+#include <random>
+
+#include "corpus.h"
+#include "misc.h"
+#include "printout.h"
+
+static const char *corpus_ciphers[] = {"aes-128-gcm", "aes-256-gcm", "chacha20-ietf-poly1305", "aes-256-cfb"};
+static const char *corpus_regions[] = {"Hong Kong", "Japan", "Singapore", "United States", "Taiwan", "Germany", "United Kingdom", "Korea"};
+
+struct corpusRandom
+{
+    std::mt19937 gen;
+
+    explicit corpusRandom(unsigned int seed) : gen(seed) {}
+
+    unsigned int next(unsigned int bound)
+    {
+        return gen() % bound;
+    }
+
+    std::string word(unsigned int length)
+    {
+        std::string result(length, 'a');
+        for(char &x : result)
+            x = 'a' + next(26);
+        return result;
+    }
+
+    std::string uuid()
+    {
+        static const char hex[] = "0123456789abcdef";
+        std::string result = "xxxxxxxx-xxxx-4xxx-8xxx-xxxxxxxxxxxx";
+        for(char &x : result)
+        {
+            if(x == 'x')
+                x = hex[next(16)];
+        }
+        return result;
+    }
+};
+
+struct corpusNode
+{
+    std::string remarks;
+    std::string server;
+    std::string port;
+    std::string cipher;
+    std::string password;
+};
+
+static corpusNode makeNode(corpusRandom &rnd, unsigned int index)
+{
+    corpusNode node;
+    node.remarks = std::string(corpus_regions[index % 8]) + " " + std::to_string(index / 8 + 1) + " - " + rnd.word(4);
+    node.server = rnd.word(8) + std::to_string(index) + ".example.com";
+    node.port = std::to_string(10000 + rnd.next(50000));
+    node.cipher = corpus_ciphers[rnd.next(4)];
+    node.password = rnd.word(16);
+    return node;
+}
+
+static std::string joinLinks(const std::vector<std::string> &links)
+{
+    std::string content;
+    for(const std::string &x : links)
+        content += x + "\n";
+    return base64_encode(content);
+}
+
+std::string corpusSSSub(unsigned int count)
+{
+    corpusRandom rnd(count * 1 + 1);
+    std::vector<std::string> links;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        corpusNode node = makeNode(rnd, i);
+        links.emplace_back("ss://" + urlsafe_base64_encode(node.cipher + ":" + node.password) + "@" + node.server + ":" + node.port + "#" + UrlEncode(node.remarks));
+    }
+    return joinLinks(links);
+}
+
+std::string corpusSSRSub(unsigned int count)
+{
+    corpusRandom rnd(count * 2 + 1);
+    std::vector<std::string> links;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        corpusNode node = makeNode(rnd, i);
+        std::string link = node.server + ":" + node.port + ":auth_aes128_md5:" + node.cipher + ":tls1.2_ticket_auth:" + urlsafe_base64_encode(node.password);
+        link += "/?obfsparam=" + urlsafe_base64_encode("download.windowsupdate.com") + "&remarks=" + urlsafe_base64_encode(node.remarks) + "&group=" + urlsafe_base64_encode("Bench");
+        links.emplace_back("ssr://" + urlsafe_base64_encode(link));
+    }
+    return joinLinks(links);
+}
+
+std::string corpusVMessSub(unsigned int count)
+{
+    corpusRandom rnd(count * 3 + 1);
+    std::vector<std::string> links;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        corpusNode node = makeNode(rnd, i);
+        std::string json = "{\"v\":\"2\",\"ps\":\"" + node.remarks + "\",\"add\":\"" + node.server + "\",\"port\":\"" + node.port + "\",\"id\":\"" + rnd.uuid() + "\",\"aid\":\"0\",\"net\":\"ws\",\"type\":\"none\",\"host\":\"" + node.server + "\",\"path\":\"/" + rnd.word(6) + "\",\"tls\":\"tls\"}";
+        links.emplace_back("vmess://" + base64_encode(json));
+    }
+    return joinLinks(links);
+}
+
+std::string corpusClash(unsigned int count)
+{
+    corpusRandom rnd(count * 4 + 1);
+    std::string content = "port: 7890\nsocks-port: 7891\nmode: Rule\nproxies:\n";
+    for(unsigned int i = 0; i < count; i++)
+    {
+        corpusNode node = makeNode(rnd, i);
+        if(i % 2)
+            content += "  - {name: \"" + node.remarks + "\", type: vmess, server: " + node.server + ", port: " + node.port + ", uuid: " + rnd.uuid() + ", alterId: 0, cipher: auto, network: ws, ws-path: /" + rnd.word(6) + ", tls: true}\n";
+        else
+            content += "  - {name: \"" + node.remarks + "\", type: ss, server: " + node.server + ", port: " + node.port + ", cipher: " + node.cipher + ", password: \"" + node.password + "\"}\n";
+    }
+    content += "proxy-groups:\n  - {name: Proxy, type: select, proxies: [DIRECT]}\nrules:\n  - MATCH,DIRECT\n";
+    return content;
+}
+
+std::string corpusSurge(unsigned int count)
+{
+    corpusRandom rnd(count * 5 + 1);
+    std::string content = "[General]\nloglevel = notify\nskip-proxy = 127.0.0.1, 192.168.0.0/16\n\n[Proxy]\n";
+    for(unsigned int i = 0; i < count; i++)
+    {
+        corpusNode node = makeNode(rnd, i);
+        if(i % 2)
+            content += node.remarks + " = vmess, " + node.server + ", " + node.port + ", username=" + rnd.uuid() + ", ws=true, ws-path=/" + rnd.word(6) + ", tls=true\n";
+        else
+            content += node.remarks + " = ss, " + node.server + ", " + node.port + ", encrypt-method=" + node.cipher + ", password=" + node.password + "\n";
+    }
+    content += "\n[Proxy Group]\nProxy = select, DIRECT\n\n[Rule]\nFINAL,DIRECT\n";
+    return content;
+}
+
+std::string corpusSSD(unsigned int count)
+{
+    corpusRandom rnd(count * 6 + 1);
+    std::string json = "{\"airport\":\"Bench\",\"port\":8388,\"encryption\":\"aes-128-gcm\",\"password\":\"" + rnd.word(16) + "\",\"servers\":[";
+    for(unsigned int i = 0; i < count; i++)
+    {
+        corpusNode node = makeNode(rnd, i);
+        if(i)
+            json += ",";
+        json += "{\"id\":" + std::to_string(i) + ",\"server\":\"" + node.server + "\",\"remarks\":\"" + node.remarks + "\",\"port\":" + node.port + "}";
+    }
+    json += "]}";
+    return "ssd://" + base64_encode(json);
+}
+
+std::string corpusResultLog(unsigned int sections)
+{
+    corpusRandom rnd(sections * 7 + 1);
+    std::string content = "[Basic]\nTester=Stair Speedtest Reborn\nGenerationTime=2020-01-01 00:00:00\n\n";
+    for(unsigned int i = 0; i < sections; i++)
+    {
+        corpusNode node = makeNode(rnd, i);
+        content += "[Bench^" + node.remarks + "]\n";
+        content += "AvgPing=" + std::to_string(50 + rnd.next(300)) + ".00\nAvgSpeed=" + std::to_string(rnd.next(100)) + ".00MB\nGroupID=0\nID=" + std::to_string(i) + "\n";
+        content += "MaxSpeed=" + std::to_string(rnd.next(200)) + ".00MB\nOnline=true\nPkLoss=0.00%\nRawPing=120,121,122,123,124,125\n";
+        content += "RawSitePing=230,231,232,233,234,235,236,237,238,239\n";
+        content += "RawSpeed=1048576,2097152,3145728,4194304,5242880,6291456,7340032,8388608,9437184,10485760,0,0,0,0,0,0,0,0,0,0\n";
+        content += "SitePing=234.56\nULSpeed=N/A\nUsedTraffic=" + std::to_string(rnd.next(1 << 30)) + "\n\n";
+    }
+    return content;
+}
+
+std::string corpusBinary(size_t size)
+{
+    corpusRandom rnd(size + 8);
+    std::string content(size, '\0');
+    for(char &x : content)
+        x = rnd.next(256);
+    return content;
+}
+
+std::vector<nodeInfo> corpusResultNodes(unsigned int count)
+{
+    corpusRandom rnd(count * 9 + 1);
+    std::vector<nodeInfo> nodes;
+    nodes.reserve(count);
+    for(unsigned int i = 0; i < count; i++)
+    {
+        corpusNode info = makeNode(rnd, i);
+        nodeInfo node;
+        node.linkType = i % 3 ? SPEEDTEST_MESSAGE_FOUNDSS : SPEEDTEST_MESSAGE_FOUNDVMESS;
+        node.id = i;
+        node.groupID = 0;
+        node.online = rnd.next(10) != 0;
+        node.group = "Bench";
+        node.remarks = info.remarks;
+        node.server = info.server;
+        node.port = to_int(info.port);
+        unsigned long long total = 0, max_speed = 0;
+        for(unsigned long long &x : node.rawSpeed)
+        {
+            x = rnd.next(32 << 20);
+            total += x;
+            max_speed = std::max(max_speed, x);
+        }
+        for(int &x : node.rawPing)
+            x = 50 + rnd.next(300);
+        for(int &x : node.rawSitePing)
+            x = 100 + rnd.next(500);
+        node.totalRecvBytes = total / 2;
+        node.avgSpeed = speedCalc(total / 20.0);
+        node.maxSpeed = speedCalc(max_speed);
+        node.ulSpeed = speedCalc(rnd.next(8 << 20));
+        node.pkLoss = std::to_string(rnd.next(20) * 5) + ".00%";
+        node.avgPing = std::to_string(50 + rnd.next(300)) + ".00";
+        node.sitePing = std::to_string(100 + rnd.next(500)) + ".00";
+        node.natType.set(std::string("Full Cone"));
+        nodes.emplace_back(std::move(node));
+    }
+    return nodes;
+}
+
+std::vector<std::string> corpusPatterns(unsigned int count)
+{
+    corpusRandom rnd(count * 10 + 1);
+    std::vector<std::string> patterns;
+    for(unsigned int i = 0; i < count; i++)
+    {
+        switch(i % 4)
+        {
+        case 0:
+            patterns.emplace_back(std::string(corpus_regions[rnd.next(8)]) + " " + std::to_string(rnd.next(100)) + " ");
+            break;
+        case 1:
+            patterns.emplace_back("(" + rnd.word(3) + "|" + rnd.word(3) + ")$");
+            break;
+        case 2:
+            patterns.emplace_back("^" + std::string(corpus_regions[rnd.next(8)]) + ".*?" + rnd.word(2));
+            break;
+        default:
+            patterns.emplace_back(rnd.word(4));
+            break;
+        }
+    }
+    return patterns;
+}
@@ -0,0 +1,22 @@
+#ifndef CORPUS_H_INCLUDED
+#define CORPUS_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "nodeinfo.h"
+
+//every generator is seeded from its arguments, so the same call always returns the same corpus
+
+std::string corpusSSSub(unsigned int count);
+std::string corpusSSRSub(unsigned int count);
+std::string corpusVMessSub(unsigned int count);
+std::string corpusClash(unsigned int count);
+std::string corpusSurge(unsigned int count);
+std::string corpusSSD(unsigned int count);
+std::string corpusResultLog(unsigned int sections);
+std::string corpusBinary(size_t size);
+std::vector<nodeInfo> corpusResultNodes(unsigned int count);
+std::vector<std::string> corpusPatterns(unsigned int count);
+
+#endif // CORPUS_H_INCLUDED
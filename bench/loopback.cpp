@@ -0,0 +1,711 @@
+#include <string>
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif // _WIN32
+
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "loopback.h"
+#include "loadtest.h"
+#include "pageload.h"
+#include "misc.h"
+#include "multithread_test.h"
+#include "nodeinfo.h"
+#include "socket.h"
+#include "speedtestutil.h"
+#include "version.h"
+
+using namespace std::chrono;
+
+typedef std::lock_guard<std::mutex> guarded_mutex;
+
+int tcping(nodeInfo &node);
+
+//shared by every connection of a server, the bucket may go into debt so that a large chunk still passes at the right average rate
+class tokenBucket
+{
+public:
+    void setRate(double bytes_per_second)
+    {
+        guarded_mutex guard(lock);
+        rate = bytes_per_second;
+        tokens = 0.0;
+        last = steady_clock::now();
+    }
+
+    void consume(size_t bytes)
+    {
+        double wait;
+        {
+            guarded_mutex guard(lock);
+            if(rate <= 0.0)
+                return;
+            auto now = steady_clock::now();
+            tokens = std::min(rate / 20.0, tokens + duration<double>(now - last).count() * rate); //allow at most 50ms of burst
+            last = now;
+            tokens -= bytes;
+            if(tokens >= 0.0)
+                return;
+            wait = -tokens / rate;
+        }
+        std::this_thread::sleep_for(duration<double>(wait));
+    }
+
+private:
+    std::mutex lock;
+    double rate = 0.0, tokens = 0.0;
+    steady_clock::time_point last;
+};
+
+static bool waitReadable(SOCKET s, int timeout_ms)
+{
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(s, &fds);
+    timeval tv = {timeout_ms / 1000, (timeout_ms % 1000) * 1000};
+    return select(s + 1, &fds, NULL, NULL, &tv) > 0;
+}
+
+static bool recvAll(SOCKET s, void *data, int len)
+{
+    char *ptr = static_cast<char*>(data);
+    while(len > 0)
+    {
+        int cur_len = Recv(s, ptr, len, 0);
+        if(cur_len <= 0)
+            return false;
+        ptr += cur_len;
+        len -= cur_len;
+    }
+    return true;
+}
+
+static bool sendAll(SOCKET s, const void *data, int len)
+{
+    const char *ptr = static_cast<const char*>(data);
+    while(len > 0)
+    {
+        int cur_len = Send(s, ptr, len, 0);
+        if(cur_len <= 0)
+            return false;
+        ptr += cur_len;
+        len -= cur_len;
+    }
+    return true;
+}
+
+//listens on an ephemeral port of 127.0.0.1 and serves every connection on its own thread
+class loopbackServer
+{
+public:
+    int port = 0;
+
+    int start()
+    {
+        listener = initSocket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if(listener == INVALID_SOCKET)
+            return -1;
+        sockaddr_in addr = {};
+        socklen_t len = sizeof(addr);
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if(::bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(listener, 64) < 0
+                || getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len) < 0)
+        {
+            closesocket(listener);
+            return -1;
+        }
+        port = ntohs(addr.sin_port);
+        running = true;
+        acceptor = std::thread([this]{ acceptLoop(); });
+        return 0;
+    }
+
+    //connection threads poll the running flag, so they leave shortly after their peers are gone
+    void stop()
+    {
+        if(!running)
+            return;
+        running = false;
+        acceptor.join();
+        closesocket(listener);
+        while(active)
+            sleep(20);
+    }
+
+protected:
+    std::atomic_bool running {false};
+
+    virtual void serve(SOCKET s) = 0;
+
+private:
+    SOCKET listener = INVALID_SOCKET;
+    std::thread acceptor;
+    std::atomic_int active {0};
+
+    void acceptLoop()
+    {
+        while(running)
+        {
+            if(!waitReadable(listener, 200))
+                continue;
+            SOCKET s = accept(listener, NULL, NULL);
+            if(s == INVALID_SOCKET)
+                continue;
+            active++;
+            std::thread([this, s]
+            {
+                serve(s);
+                closesocket(s);
+                active--;
+            }).detach();
+        }
+    }
+};
+
+//no-auth SOCKS5 server supporting CONNECT only, just enough for connectSocks5() and connectThruSocks()
+class socksServer : public loopbackServer
+{
+protected:
+    void serve(SOCKET s) override
+    {
+        unsigned char buf[256];
+        setTimeout(s, 5000);
+        if(!recvAll(s, buf, 2) || buf[0] != 5 || !recvAll(s, buf + 2, buf[1]))
+            return;
+        bool noauth = memchr(buf + 2, 0, buf[1]) != NULL;
+        unsigned char method[2] = {5, static_cast<unsigned char>(noauth ? 0x00 : 0xFF)};
+        if(!sendAll(s, method, 2) || !noauth)
+            return;
+
+        if(!recvAll(s, buf, 4) || buf[0] != 5 || buf[1] != 1)
+            return;
+        char addr[128] = {};
+        switch(buf[3])
+        {
+        case 1:
+            if(!recvAll(s, buf, 4))
+                return;
+            inet_ntop(AF_INET, buf, addr, sizeof(addr));
+            break;
+        case 3:
+            if(!recvAll(s, buf, 1) || !recvAll(s, addr, buf[0]))
+                return;
+            break;
+        case 4:
+            if(!recvAll(s, buf, 16))
+                return;
+            inet_ntop(AF_INET6, buf, addr, sizeof(addr));
+            break;
+        default:
+            return;
+        }
+        if(!recvAll(s, buf, 2))
+            return;
+        int dstport = (buf[0] << 8) | buf[1];
+        std::string host = addr;
+        if(!isIPv4(host) && !isIPv6(host))
+            host = hostnameToIPAddr(host);
+
+        SOCKET target = host.empty() ? INVALID_SOCKET : initSocket(getNetworkType(host), SOCK_STREAM, IPPROTO_TCP);
+        bool connected = target != INVALID_SOCKET && startConnect(target, host, dstport) != SOCKET_ERROR;
+        unsigned char reply[10] = {5, static_cast<unsigned char>(connected ? 0 : 5), 0, 1};
+        if(target != INVALID_SOCKET)
+        {
+            if(sendAll(s, reply, sizeof(reply)) && connected)
+                relay(s, target);
+            closesocket(target);
+        }
+        else
+            sendAll(s, reply, sizeof(reply));
+    }
+
+private:
+    void relay(SOCKET client, SOCKET target)
+    {
+        char data[16384];
+        //like the local clients of real nodes, otherwise the partial tail of every response waits for a delayed ACK
+        int one = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, (char *)&one, sizeof(int));
+        setsockopt(target, IPPROTO_TCP, TCP_NODELAY, (char *)&one, sizeof(int));
+        while(running)
+        {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(client, &fds);
+            FD_SET(target, &fds);
+            timeval tv = {0, 200000};
+            int retVal = select(std::max(client, target) + 1, &fds, NULL, NULL, &tv);
+            if(retVal < 0)
+                return;
+            for(SOCKET from : {client, target})
+            {
+                if(!FD_ISSET(from, &fds))
+                    continue;
+                int cur_len = Recv(from, data, sizeof(data), 0);
+                if(cur_len <= 0 || !sendAll(from == client ? target : client, data, cur_len))
+                    return;
+            }
+        }
+    }
+};
+
+//canned page for the page load simulation, both host names reach the same server so the per-host limits apply twice
+static std::string loopbackPageManifest(int port)
+{
+    const std::string hosts[2] = {"http://127.0.0.1:" + std::to_string(port), "http://localhost:" + std::to_string(port)};
+    //name, size in bytes, host, line of the parent
+    static const struct { const char *name; int size; int host; int parent; } resources[] = {
+        {"index.html", 32768, 0, -1}, {"style.css", 24576, 0, 0}, {"theme.css", 8192, 1, 0}, {"vendor.js", 262144, 1, 0},
+        {"app.js", 65536, 0, 0}, {"logo.svg", 4096, 0, 0}, {"font-regular.woff2", 49152, 1, 1}, {"font-bold.woff2", 49152, 1, 1},
+        {"background.jpg", 196608, 0, 2}, {"hero.jpg", 131072, 1, 0}, {"thumb1.jpg", 16384, 0, 0}, {"thumb2.jpg", 16384, 1, 0},
+        {"thumb3.jpg", 16384, 0, 0}, {"data.json", 8192, 0, 4}, {"chunk.js", 98304, 1, 4}, {"avatar.png", 12288, 1, 13}
+    };
+    std::string manifest = "#canned page of the loopback benchmark\n";
+    for(auto &x : resources)
+    {
+        manifest += hosts[x.host] + "/page/" + x.name + "?size=" + std::to_string(x.size);
+        if(x.parent > 0)
+            manifest += "|" + std::to_string(x.parent);
+        manifest += "\n";
+    }
+    return manifest;
+}
+
+//GET /download sends an endless body, POST sinks the request body, GET /page/manifest and /page/<name>?size=<bytes> serve the canned page,
+//anything else gets an empty reply on a kept-alive connection
+class httpServer : public loopbackServer
+{
+public:
+    tokenBucket bucket;
+    std::atomic_int latency {0}; //delay before the first response byte, in milliseconds
+    std::atomic<unsigned long long> sent_bytes {0}, received_bytes {0}, requests {0};
+
+    httpServer()
+    {
+        payload.resize(16384);
+        rand_fill(&payload[0], payload.size());
+    }
+
+protected:
+    void serve(SOCKET s) override
+    {
+        char data[16384];
+        std::string buffer;
+        setTimeout(s, 5000);
+        while(serveRequest(s, data, sizeof(data), buffer));
+    }
+
+private:
+    std::string payload;
+
+    void delay()
+    {
+        int ms = latency;
+        if(ms > 0)
+            sleep(ms);
+    }
+
+    //returns true when the connection is kept for another request
+    bool serveRequest(SOCKET s, char *data, int data_len, std::string &buffer)
+    {
+        std::string::size_type end;
+        int idle = 0;
+        while((end = buffer.find("\r\n\r\n")) == buffer.npos)
+        {
+            if(buffer.size() > 8192 || !running || idle >= 5000)
+                return false;
+            if(!waitReadable(s, 200))
+            {
+                idle += 200;
+                continue;
+            }
+            int cur_len = Recv(s, data, data_len, 0);
+            if(cur_len <= 0)
+                return false; //tcping closes right after its single byte
+            buffer.append(data, cur_len);
+        }
+        std::string header = buffer.substr(0, end);
+        buffer.erase(0, end + 4);
+        std::string::size_type method_end = header.find(' ');
+        std::string method = header.substr(0, method_end), path = header.substr(method_end + 1, header.find(' ', method_end + 1) - method_end - 1);
+
+        if(method == "POST")
+        {
+            std::string lower = toLower(header);
+            std::string::size_type pos = lower.find("content-length:");
+            unsigned long long remain = pos == lower.npos ? 0 : strtoull(lower.data() + pos + 15, NULL, 10), body_received = buffer.size();
+            buffer.clear();
+            remain -= std::min(remain, body_received);
+            received_bytes += body_received;
+            while(remain && running)
+            {
+                int cur_len = Recv(s, data, std::min<unsigned long long>(data_len, remain), 0);
+                if(cur_len <= 0)
+                    return false;
+                received_bytes += cur_len;
+                remain -= cur_len;
+                bucket.consume(cur_len);
+            }
+            delay();
+            const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+            sendAll(s, response.data(), response.size());
+            return false;
+        }
+        else if(path == "/download")
+        {
+            delay();
+            const std::string response = "HTTP/1.1 200 OK\r\nContent-Type: application/octet-stream\r\nContent-Length: 1099511627776\r\nConnection: close\r\n\r\n";
+            if(!sendAll(s, response.data(), response.size()))
+                return false;
+            while(running)
+            {
+                int cur_len = Send(s, payload.data(), payload.size(), 0);
+                if(cur_len <= 0)
+                    return false;
+                sent_bytes += cur_len;
+                bucket.consume(cur_len);
+            }
+            return false;
+        }
+        //HTTP/1.1 keeps the connection unless the client asks otherwise, the load test and the page load rely on it
+        bool keepalive = endsWith(header.substr(0, header.find("\r\n")), "HTTP/1.1") && toLower(header).find("connection: close") == std::string::npos;
+        delay();
+        requests++;
+        if(startsWith(path, "/page/"))
+        {
+            std::string body;
+            std::string::size_type pos = path.find("?size=");
+            if(path == "/page/manifest")
+                body = loopbackPageManifest(port);
+            else if(pos != path.npos)
+            {
+                //one send for the whole response, a separate small tail would wait for a delayed ACK
+                size_t size = std::min<unsigned long long>(strtoull(path.data() + pos + 6, NULL, 10), 16777216);
+                for(body.reserve(size); body.size() < size;)
+                    body.append(payload, 0, std::min(payload.size(), size - body.size()));
+            }
+            const std::string response = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\nConnection: " + (keepalive ? "keep-alive" : "close") + "\r\n\r\n" + body;
+            bucket.consume(body.size());
+            if(!sendAll(s, response.data(), response.size()))
+                return false;
+            sent_bytes += body.size();
+            return keepalive;
+        }
+        const std::string response = std::string("HTTP/1.1 204 No Content\r\nContent-Length: 0\r\nConnection: ") + (keepalive ? "keep-alive" : "close") + "\r\n\r\n";
+        return sendAll(s, response.data(), response.size()) && keepalive;
+    }
+};
+
+struct loopbackCase
+{
+    std::string name;
+    double rate = 0.0; //bytes per second, 0 means unlimited
+    int latency = 0;
+    double download_tester = 0.0;
+    double download_server = 0.0;
+    double upload_tester = 0.0;
+    double upload_server = 0.0;
+    double tcp_ping = 0.0;
+    double site_ping = 0.0;
+};
+
+static void runCase(httpServer &http, socksServer &socks, loopbackCase &test, int threads)
+{
+    const std::string socks_addr = "127.0.0.1", base = "http://127.0.0.1:" + std::to_string(http.port);
+    http.bucket.setRate(test.rate);
+    http.latency = test.latency;
+
+    nodeInfo node;
+    node.id = 0;
+    node.server = "127.0.0.1";
+    node.port = http.port;
+    node.testFile = base + "/download";
+    node.ulTarget = base + "/upload";
+
+    std::cerr << "loopback " << test.name << ": download" << std::endl;
+    unsigned long long before = http.sent_bytes;
+    auto start = steady_clock::now();
+    perform_test(node, socks_addr, socks.port, "", "", threads);
+    test.download_server = (http.sent_bytes - before) / duration<double>(steady_clock::now() - start).count();
+    //every sample is already scaled to bytes per second, so their mean is the rate the tester saw
+    unsigned long long total = 0;
+    for(unsigned long long x : node.rawSpeed)
+        total += x;
+    test.download_tester = total / 20.0;
+
+    std::cerr << "loopback " << test.name << ": upload" << std::endl;
+    before = http.received_bytes;
+    start = steady_clock::now();
+    upload_test(node, socks_addr, socks.port, "", "");
+    test.upload_server = (http.received_bytes - before) / duration<double>(steady_clock::now() - start).count();
+    test.upload_tester = node.ulSpeed == "N/A" ? 0.0 : streamToInt(node.ulSpeed);
+
+    std::cerr << "loopback " << test.name << ": tcping" << std::endl;
+    tcping(node);
+    test.tcp_ping = stod(node.avgPing);
+
+    std::cerr << "loopback " << test.name << ": site ping" << std::endl;
+    sitePing(node, socks_addr, socks.port, "", "", base + "/");
+    test.site_ping = stod(node.sitePing);
+}
+
+static double errorPercent(double measured, double configured)
+{
+    return configured > 0.0 ? (measured - configured) * 100.0 / configured : 0.0;
+}
+
+static void loadResultToJSON(rapidjson::PrettyWriter<rapidjson::StringBuffer> &writer, const loadTestResult &result)
+{
+    writer.StartObject();
+    writer.Key("knee_concurrency");
+    writer.Int(result.knee < 0 ? 0 : result.steps[result.knee].concurrency);
+    writer.Key("knee_per_sec");
+    writer.Double(result.knee < 0 ? 0.0 : result.steps[result.knee].rate);
+    writer.Key("stop");
+    writer.String(result.stop.data());
+    writer.Key("errors");
+    writer.StartObject();
+    for(int i = 0; i < LOAD_ERROR_COUNT; i++)
+    {
+        writer.Key(load_error_names[i]);
+        writer.Uint(result.errors[i]);
+    }
+    writer.EndObject();
+    writer.Key("steps");
+    writer.StartArray();
+    for(const loadTestStep &x : result.steps)
+    {
+        writer.StartObject();
+        writer.Key("concurrency");
+        writer.Int(x.concurrency);
+        writer.Key("completed");
+        writer.Uint(x.completed);
+        writer.Key("failed");
+        writer.Uint(x.failed);
+        writer.Key("per_sec");
+        writer.Double(x.rate);
+        writer.Key("p50_ms");
+        writer.Int(x.p50);
+        writer.Key("p95_ms");
+        writer.Int(x.p95);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+static void pageResultToJSON(rapidjson::PrettyWriter<rapidjson::StringBuffer> &writer, const std::vector<pageResource> &resources, const pageLoadResult &result)
+{
+    writer.StartObject();
+    writer.Key("resources");
+    writer.Uint(resources.size());
+    writer.Key("total_ms");
+    writer.Int(result.total);
+    writer.Key("failed");
+    writer.Uint(result.failed);
+    writer.Key("summary");
+    writer.String(pageLoadString(resources, result).data());
+    writer.Key("timings");
+    writer.StartArray();
+    for(size_t i = 0; i < result.timings.size(); i++)
+    {
+        const pageResourceTiming &x = result.timings[i];
+        writer.StartObject();
+        writer.Key("url");
+        writer.String(resources[i].url.data());
+        writer.Key("ok");
+        writer.Bool(x.ok);
+        writer.Key("start_ms");
+        writer.Int(x.start);
+        writer.Key("end_ms");
+        writer.Int(x.end);
+        writer.Key("queue_ms");
+        writer.Int(x.queue);
+        writer.Key("connect_ms");
+        writer.Int(x.connect);
+        writer.Key("tls_ms");
+        writer.Int(x.tls);
+        writer.Key("wait_ms");
+        writer.Int(x.wait);
+        writer.Key("receive_ms");
+        writer.Int(x.receive);
+        writer.Key("bytes");
+        writer.Uint64(x.bytes);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+}
+
+static std::string loopbackToJSON(const std::vector<loopbackCase> &cases, int threads, const loadTestResult *load, int load_latency, unsigned long long load_requests,
+                                  const std::vector<pageResource> &page_resources, const pageLoadResult *page)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(sb);
+    writer.StartObject();
+    writer.Key("version");
+    writer.String(VERSION);
+    writer.Key("threads");
+    writer.Int(threads);
+    //the unlimited case is always first, whatever it reaches is the ceiling of the tester on this machine
+    writer.Key("max_download_bytes_per_sec");
+    writer.Double(cases.front().download_tester);
+    writer.Key("max_upload_bytes_per_sec");
+    writer.Double(cases.front().upload_tester);
+    writer.Key("cases");
+    writer.StartArray();
+    for(const loopbackCase &x : cases)
+    {
+        writer.StartObject();
+        writer.Key("name");
+        writer.String(x.name.data());
+        writer.Key("rate_bytes_per_sec");
+        writer.Double(x.rate);
+        writer.Key("latency_ms");
+        writer.Int(x.latency);
+        writer.Key("download_tester_bytes_per_sec");
+        writer.Double(x.download_tester);
+        writer.Key("download_server_bytes_per_sec");
+        writer.Double(x.download_server);
+        writer.Key("download_error_pct");
+        writer.Double(errorPercent(x.download_tester, x.rate));
+        writer.Key("upload_tester_bytes_per_sec");
+        writer.Double(x.upload_tester);
+        writer.Key("upload_server_bytes_per_sec");
+        writer.Double(x.upload_server);
+        writer.Key("upload_error_pct");
+        writer.Double(errorPercent(x.upload_tester, x.rate));
+        writer.Key("tcp_ping_ms");
+        writer.Double(x.tcp_ping);
+        writer.Key("site_ping_ms");
+        writer.Double(x.site_ping);
+        writer.Key("site_ping_error_ms");
+        writer.Double(x.site_ping - x.latency);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    if(load)
+    {
+        writer.Key("load_test");
+        writer.StartObject();
+        writer.Key("latency_ms");
+        writer.Int(load_latency);
+        writer.Key("server_requests");
+        writer.Uint64(load_requests);
+        writer.Key("connections");
+        loadResultToJSON(writer, load[0]);
+        writer.Key("requests");
+        loadResultToJSON(writer, load[1]);
+        writer.EndObject();
+    }
+    if(page)
+    {
+        writer.Key("page_load");
+        pageResultToJSON(writer, page_resources, *page);
+    }
+    writer.EndObject();
+    return sb.GetString();
+}
+
+int runLoopback(int argc, char *argv[])
+{
+    double rate = 0.0;
+    int latency = 0, threads = 4, load = 0;
+    bool page = false;
+    std::string output;
+    for(int i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "--rate") && argc > i + 1)
+            rate = std::max(0.0, atof(argv[++i])) * 1048576.0;
+        else if(!strcmp(argv[i], "--latency") && argc > i + 1)
+            latency = std::max(0, to_int(argv[++i], 0));
+        else if(!strcmp(argv[i], "--threads") && argc > i + 1)
+            threads = std::max(1, to_int(argv[++i], 4));
+        else if(!strcmp(argv[i], "--load") && argc > i + 1)
+            load = std::max(0, to_int(argv[++i], 0));
+        else if(!strcmp(argv[i], "--page"))
+            page = true;
+        else if(!strcmp(argv[i], "--output") && argc > i + 1)
+            output.assign(argv[++i]);
+    }
+
+#ifdef _WIN32
+    WSADATA wsd;
+    if(WSAStartup(MAKEWORD(2, 2), &wsd) != 0)
+        return -1;
+#else
+    signal(SIGPIPE, SIG_IGN);
+#endif // _WIN32
+
+    httpServer http;
+    socksServer socks;
+    if(http.start() != 0 || socks.start() != 0)
+    {
+        std::cerr << "loopback: cannot listen on 127.0.0.1" << std::endl;
+        http.stop();
+        socks.stop();
+        return -1;
+    }
+
+    std::vector<loopbackCase> cases(1);
+    cases[0].name = "unlimited";
+    if(rate > 0.0 || latency > 0)
+    {
+        loopbackCase limited;
+        limited.name = "configured";
+        limited.rate = rate;
+        limited.latency = latency;
+        cases.push_back(limited);
+    }
+    for(loopbackCase &x : cases)
+        runCase(http, socks, x, threads);
+
+    //runs through the last case, so the configured latency applies to every request
+    loadTestResult load_results[2];
+    unsigned long long load_requests = http.requests;
+    if(load)
+    {
+        loadTestConfig config;
+        config.target = "http://127.0.0.1:" + std::to_string(http.port) + "/";
+        config.max_concurrency = load;
+        std::cerr << "loopback: load test, new connections" << std::endl;
+        loadTestRun(false, "127.0.0.1", socks.port, "", "", config, load_results[0]);
+        std::cerr << "loopback: load test, keep-alive requests" << std::endl;
+        loadTestRun(true, "127.0.0.1", socks.port, "", "", config, load_results[1]);
+    }
+    load_requests = http.requests - load_requests;
+
+    //the manifest comes from the server itself, as a real one would come from a URL
+    std::vector<pageResource> page_resources;
+    pageLoadResult page_result;
+    if(page)
+    {
+        std::cerr << "loopback: page load" << std::endl;
+        if(pageManifestLoad("http://127.0.0.1:" + std::to_string(http.port) + "/page/manifest", page_resources) == 0)
+            pageLoadRun(page_resources, "socks5://127.0.0.1:" + std::to_string(socks.port), 6, page_result);
+        else
+            page = false;
+    }
+
+    socks.stop();
+    http.stop();
+
+    std::string json = loopbackToJSON(cases, threads, load ? load_results : nullptr, cases.back().latency, load_requests, page_resources, page ? &page_result : nullptr);
+    if(output.size())
+        fileWrite(output, json, true);
+    else
+        std::cout << json << std::endl;
+    return 0;
+}
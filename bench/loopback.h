@@ -0,0 +1,7 @@
+#ifndef LOOPBACK_H_INCLUDED
+#define LOOPBACK_H_INCLUDED
+
+//runs the real test engine against in-process SOCKS5 and HTTP servers on 127.0.0.1
+int runLoopback(int argc, char *argv[]);
+
+#endif // LOOPBACK_H_INCLUDED
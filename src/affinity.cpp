@@ -0,0 +1,263 @@
+#include <string>
+#include <vector>
+#include <set>
+#include <mutex>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <tuple>
+#include <climits>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <sched.h>
+#include <pthread.h>
+#endif // __linux__
+
+#include "affinity.h"
+#include "logger.h"
+#include "misc.h"
+#include "trace.h"
+
+typedef std::lock_guard<std::mutex> guarded_mutex;
+
+static bool affinity_enabled = false;
+static std::vector<std::vector<int>> affinity_slots;
+static std::vector<bool> affinity_busy;
+static std::vector<int> affinity_service, affinity_all;
+static std::mutex affinity_mutex;
+
+static std::string coreListString(const std::vector<int> &cores)
+{
+    std::string result;
+    for(int x : cores)
+        result += (result.empty() ? "" : ",") + std::to_string(x);
+    return result;
+}
+
+#ifdef __linux__
+//procfs and sysfs files report a size of 0 or 4096, so they are read through a stream instead of fileGet()
+static std::string readSysFile(const std::string &path)
+{
+    std::ifstream file(path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return trim(ss.str());
+}
+
+//parses "0-3,8,10-11"
+static std::vector<int> parseCoreList(const std::string &list)
+{
+    std::vector<int> result;
+    for(std::string &x : split(list, ","))
+    {
+        string_size pos = x.find('-');
+        int first = to_int(trim(x.substr(0, pos)), -1), last = pos == x.npos ? first : to_int(trim(x.substr(pos + 1)), -1);
+        for(int i = first; i >= 0 && i <= last; i++)
+            result.push_back(i);
+    }
+    return result;
+}
+
+static std::string defaultRouteInterface()
+{
+    std::ifstream file("/proc/net/route");
+    std::string line, iface, destination;
+    std::getline(file, line); //header
+    while(std::getline(file, line))
+    {
+        std::stringstream ss(line);
+        if(ss >> iface >> destination && destination == "00000000")
+            return iface;
+    }
+    return std::string();
+}
+
+static std::vector<int> interfaceIRQCores(const std::string &interface)
+{
+    std::set<int> result;
+    std::ifstream file("/proc/interrupts");
+    std::string line;
+    while(std::getline(file, line))
+    {
+        string_size pos = line.find(':');
+        if(pos == line.npos || line.find(interface, pos) == line.npos)
+            continue;
+        int irq = to_int(trim(line.substr(0, pos)), -1);
+        if(irq < 0)
+            continue;
+        std::string list = readSysFile("/proc/irq/" + std::to_string(irq) + "/effective_affinity_list");
+        if(list.empty())
+            list = readSysFile("/proc/irq/" + std::to_string(irq) + "/smp_affinity_list");
+        for(int x : parseCoreList(list))
+            result.insert(x);
+    }
+    return std::vector<int>(result.begin(), result.end());
+}
+
+static int pinThread(const std::vector<int> &cores)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int x : cores)
+        CPU_SET(x, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+#endif // __linux__
+
+int affinityInit(const std::string &policy, int cores_per_slot, const std::string &interface)
+{
+    affinity_enabled = false;
+    if(policy != "node")
+        return 0;
+#ifdef __linux__
+    cpu_set_t allowed;
+    if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return -1;
+    affinity_all.clear();
+    for(int i = 0; i < CPU_SETSIZE; i++)
+        if(CPU_ISSET(i, &allowed))
+            affinity_all.push_back(i);
+
+    std::string iface = interface.size() ? interface : defaultRouteInterface();
+    int nic_numa = iface.size() ? to_int(readSysFile("/sys/class/net/" + iface + "/device/numa_node"), -1) : -1;
+    std::vector<int> irq_cores = iface.size() ? interfaceIRQCores(iface) : std::vector<int>();
+    std::vector<int> core_numa(CPU_SETSIZE, 0);
+    for(int node = 0; node < 1024 && fileExist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"); node++)
+        for(int x : parseCoreList(readSysFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist")))
+            if(x < CPU_SETSIZE)
+                core_numa[x] = node;
+
+    auto rank = [&](int core)
+    {
+        int numa = nic_numa < 0 || core_numa[core] == nic_numa ? -1 : core_numa[core];
+        bool irq = std::find(irq_cores.begin(), irq_cores.end(), core) != irq_cores.end();
+        int distance = INT_MAX;
+        for(int x : irq_cores)
+            distance = std::min(distance, std::abs(core - x));
+        return std::make_tuple(numa, irq, irq_cores.empty() ? 0 : distance, core);
+    };
+    std::vector<int> order = affinity_all;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return rank(a) < rank(b); });
+
+    size_t per_slot = std::max(1, cores_per_slot);
+    if(order.size() < per_slot * 2)
+    {
+        writeLog(LOG_TYPE_WARN, "CPU affinity: only " + std::to_string(order.size()) + " usable cores, placement disabled.");
+        return -1;
+    }
+    guarded_mutex guard(affinity_mutex);
+    affinity_service.assign(order.end() - per_slot, order.end());
+    order.resize(order.size() - per_slot);
+    affinity_slots.clear();
+    for(size_t i = 0; i + per_slot <= order.size(); i += per_slot)
+        affinity_slots.emplace_back(order.begin() + i, order.begin() + i + per_slot);
+    affinity_busy.assign(affinity_slots.size(), false);
+    affinity_enabled = true;
+
+    writeLog(LOG_TYPE_INFO, "CPU affinity: interface '" + iface + "' NUMA node " + std::to_string(nic_numa) + " IRQ cores [" + coreListString(irq_cores) + "], " +
+             std::to_string(affinity_slots.size()) + " slot(s) of " + std::to_string(per_slot) + " core(s), first slot [" + coreListString(affinity_slots[0]) +
+             "], web server cores [" + coreListString(affinity_service) + "].");
+    return 0;
+#else
+    writeLog(LOG_TYPE_WARN, "CPU affinity is only supported on Linux, placement disabled.");
+    return -1;
+#endif // __linux__
+}
+
+bool affinityEnabled()
+{
+    return affinity_enabled;
+}
+
+int affinityAcquire()
+{
+    if(!affinity_enabled)
+        return -1;
+    guarded_mutex guard(affinity_mutex);
+    for(size_t i = 0; i < affinity_busy.size(); i++)
+    {
+        if(!affinity_busy[i])
+        {
+            affinity_busy[i] = true;
+            return i;
+        }
+    }
+    return -1;
+}
+
+void affinityRelease(int slot)
+{
+    guarded_mutex guard(affinity_mutex);
+    if(slot >= 0 && slot < (int)affinity_busy.size())
+        affinity_busy[slot] = false;
+}
+
+//for a forked pool worker, every node it tests then takes the same slot instead of the first one
+void affinityKeepSlot(int slot)
+{
+    guarded_mutex guard(affinity_mutex);
+    if(!affinity_enabled || affinity_busy.empty() || slot < 0)
+        return;
+    affinity_busy.assign(affinity_busy.size(), true);
+    affinity_busy[slot % affinity_busy.size()] = false;
+}
+
+std::string affinityPinThread(int slot)
+{
+#ifdef __linux__
+    if(affinity_enabled && slot >= 0 && slot < (int)affinity_slots.size() && pinThread(affinity_slots[slot]) == 0)
+        return coreListString(affinity_slots[slot]);
+#endif // __linux__
+    return std::string();
+}
+
+std::string affinityPinService()
+{
+#ifdef __linux__
+    if(affinity_enabled && pinThread(affinity_service) == 0)
+    {
+        std::string cores = coreListString(affinity_service);
+        traceInstant("affinity", -1, "cores=" + cores);
+        return cores;
+    }
+#endif // __linux__
+    return std::string();
+}
+
+void affinityRestoreThread()
+{
+#ifdef __linux__
+    if(affinity_enabled)
+        pinThread(affinity_all);
+#endif // __linux__
+}
+
+affinityScope::affinityScope(int node_id)
+{
+    _slot = affinityAcquire();
+    if(_slot < 0)
+    {
+        if(affinity_enabled)
+            writeLog(LOG_TYPE_WARN, "CPU affinity: no free core slot, node runs unpinned.");
+        return;
+    }
+    std::string cores = affinityPinThread(_slot);
+    if(cores.empty())
+    {
+        writeLog(LOG_TYPE_WARN, "CPU affinity: cannot pin to slot " + std::to_string(_slot) + ", node runs unpinned.");
+        affinityRelease(_slot);
+        _slot = -1;
+        return;
+    }
+    writeLog(LOG_TYPE_INFO, "Pinned to cores [" + cores + "].");
+    traceInstant("affinity", node_id, "cores=" + cores);
+}
+
+affinityScope::~affinityScope()
+{
+    if(_slot < 0)
+        return;
+    affinityRestoreThread();
+    affinityRelease(_slot);
+}
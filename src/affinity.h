@@ -0,0 +1,35 @@
+#ifndef AFFINITY_H_INCLUDED
+#define AFFINITY_H_INCLUDED
+
+#include <string>
+
+/*
+CPU placement of test workers, only implemented on Linux.
+Usable cores are ordered once: cores on the NUMA node of the network interface come first, nearest to the
+cores serving its interrupts, and the interrupt cores themselves come last within that node. The order is cut into
+slots of cpu_affinity_cores cores. A node holds one slot while it is tested, the tail of the order is kept for
+the web server workers.
+*/
+
+int affinityInit(const std::string &policy, int cores_per_slot, const std::string &interface);
+bool affinityEnabled();
+int affinityAcquire();
+void affinityRelease(int slot);
+void affinityKeepSlot(int slot);
+std::string affinityPinThread(int slot);
+std::string affinityPinService();
+void affinityRestoreThread();
+
+//pins the calling thread for the lifetime of the scope, threads and processes it starts meanwhile inherit the core set
+class affinityScope
+{
+public:
+    affinityScope(int node_id);
+    ~affinityScope();
+    affinityScope(const affinityScope&) = delete;
+    affinityScope& operator=(const affinityScope&) = delete;
+private:
+    int _slot = -1;
+};
+
+#endif // AFFINITY_H_INCLUDED
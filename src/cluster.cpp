@@ -0,0 +1,378 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <ctime>
+
+#include <rapidjson/stringbuffer.h>
+
+#include "cluster.h"
+#include "logger.h"
+#include "misc.h"
+#include "webget.h"
+#include "resultfile.h"
+#include "rapidjson_extra.h"
+#include "speedtestutil.h"
+#include "profile.h"
+#include "version.h"
+
+typedef std::lock_guard<std::mutex> guarded_mutex;
+
+//variables from main
+extern int socksport;
+extern testProfile test_profile;
+
+//functions from main
+int singleTest(nodeInfo &node, bool screen);
+bool selectTestProfile(const std::string &name);
+
+//coordinator side
+
+struct clusterWorker
+{
+    std::string url;
+    bool failed = false;
+    bool busy = false;
+    std::string shard;
+    std::vector<size_t> nodes; //indices into the coordinator list, in test order
+    size_t received = 0;
+    time_t last_progress = 0;
+    unsigned int tested = 0;
+};
+
+static std::string clusterShardRequest(const std::vector<nodeInfo> &nodes, const std::string &shard, const std::vector<size_t> &indices)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    writer.StartObject();
+    writer.Key("shard");
+    writer.String(shard.data());
+    writer.Key("profile");
+    writer.String(test_profile.name.data());
+    writer.Key("socksport");
+    writer.Int(socksport);
+    writer.Key("nodes");
+    writer.StartArray();
+    for(size_t x : indices)
+    {
+        const nodeInfo &node = nodes[x];
+        writer.StartObject();
+        writer.Key("id");
+        writer.Int(node.id);
+        writer.Key("groupID");
+        writer.Int(node.groupID);
+        writer.Key("linkType");
+        writer.Int(node.linkType);
+        writer.Key("group");
+        writer.String(node.group.data());
+        writer.Key("remarks");
+        writer.String(node.remarks.data());
+        writer.Key("server");
+        writer.String(node.server.data());
+        writer.Key("port");
+        writer.Int(node.port);
+        writer.Key("config");
+        writer.String(node.proxyStr.data());
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return sb.GetString();
+}
+
+//results come back without the client configs, so the coordinator keeps its own copy of them
+static void clusterMerge(nodeInfo &node, nodeInfo &result)
+{
+    result.linkType = node.linkType;
+    result.id = node.id;
+    result.groupID = node.groupID;
+    result.server = node.server;
+    result.port = node.port;
+    result.proxyStr = node.proxyStr;
+    node = result;
+}
+
+static bool clusterSend(std::vector<nodeInfo> &nodes, clusterWorker &worker, std::vector<size_t> indices, std::deque<size_t> &pending)
+{
+    static unsigned int counter = 0;
+    std::string shard = std::to_string(time(NULL)) + "-" + std::to_string(counter++), response;
+    int code = webPost(worker.url + "/worker/shard", clusterShardRequest(nodes, shard, indices), "", {}, &response);
+    if(code != 200 || response != "accepted")
+    {
+        writeLog(LOG_TYPE_WARN, "Cluster: worker " + worker.url + " refused shard (" + std::to_string(code) + " " + response + "), dropping it.");
+        worker.failed = true;
+        pending.insert(pending.end(), indices.begin(), indices.end());
+        return false;
+    }
+    writeLog(LOG_TYPE_INFO, "Cluster: sent shard " + shard + " with " + std::to_string(indices.size()) + " node(s) to " + worker.url + ".");
+    worker.busy = true;
+    worker.shard = shard;
+    worker.nodes = std::move(indices);
+    worker.received = 0;
+    worker.last_progress = time(NULL);
+    return true;
+}
+
+//the untested part of the shard goes back to the queue, the worker is not used again in this run
+static void clusterDrop(clusterWorker &worker, std::deque<size_t> &pending, const std::string &reason)
+{
+    writeLog(LOG_TYPE_WARN, "Cluster: worker " + worker.url + " " + reason + ", " + std::to_string(worker.nodes.size() - worker.received) + " node(s) go back to the queue.");
+    std::string response;
+    webPost(worker.url + "/worker/truncate", "{\"shard\":\"" + worker.shard + "\",\"keep\":0}", "", {}, &response);
+    pending.insert(pending.end(), worker.nodes.begin() + worker.received, worker.nodes.end());
+    worker.failed = true;
+    worker.busy = false;
+}
+
+static size_t clusterPoll(std::vector<nodeInfo> &nodes, clusterWorker &worker, std::deque<size_t> &pending, int timeout)
+{
+    time_t now = time(NULL);
+    std::string data = webGet(worker.url + "/worker/results?shard=" + worker.shard + "&from=" + std::to_string(worker.received));
+    rapidjson::Document json;
+    json.Parse(data.data());
+    if(data.empty() || json.HasParseError() || !json.IsObject())
+    {
+        if(now - worker.last_progress > timeout)
+            clusterDrop(worker, pending, "is unreachable");
+        return 0;
+    }
+    if(GetMember(json, "status") == "unknown") //restarted or truncated by someone else
+    {
+        clusterDrop(worker, pending, "lost the shard");
+        return 0;
+    }
+
+    std::vector<nodeInfo> results;
+    resultFileReader reader;
+    std::string results_data = base64_decode(GetMember(json, "results"));
+    if(results_data.size() && (reader.load(results_data) != 0 || resultFileLoad(reader, results) != 0))
+    {
+        clusterDrop(worker, pending, "sent an invalid result");
+        return 0;
+    }
+    size_t count = std::min(results.size(), worker.nodes.size() - worker.received);
+    for(size_t i = 0; i < count; i++)
+        clusterMerge(nodes[worker.nodes[worker.received + i]], results[i]);
+    worker.received += count;
+    worker.tested += count;
+    if(count)
+        worker.last_progress = now;
+
+    if(worker.received >= worker.nodes.size())
+        worker.busy = false;
+    else if(GetMember(json, "status") == "done")
+        clusterDrop(worker, pending, "stopped early");
+    else if(now - worker.last_progress > timeout)
+        clusterDrop(worker, pending, "made no progress for " + std::to_string(timeout) + "s");
+    return count;
+}
+
+//the busy worker keeps the node it is testing and the first half of the rest
+static bool clusterSteal(std::vector<nodeInfo> &nodes, clusterWorker &idle, std::vector<clusterWorker> &workers, std::deque<size_t> &pending)
+{
+    clusterWorker *victim = nullptr;
+    for(clusterWorker &x : workers)
+    {
+        if(!x.failed && x.busy && x.nodes.size() - x.received >= 3 && (!victim || x.nodes.size() - x.received > victim->nodes.size() - victim->received))
+            victim = &x;
+    }
+    if(!victim)
+        return false;
+    size_t remaining = victim->nodes.size() - victim->received, keep = victim->received + 1 + (remaining - 1) / 2;
+    std::string response;
+    if(webPost(victim->url + "/worker/truncate", "{\"shard\":\"" + victim->shard + "\",\"keep\":" + std::to_string(keep) + "}", "", {}, &response) != 200)
+        return false;
+    rapidjson::Document json;
+    json.Parse(response.data());
+    if(json.HasParseError() || !json.IsObject())
+        return false;
+    keep = to_int(GetMember(json, "keep"), victim->nodes.size());
+    if(keep >= victim->nodes.size())
+        return false;
+    std::vector<size_t> stolen(victim->nodes.begin() + keep, victim->nodes.end());
+    victim->nodes.resize(keep);
+    writeLog(LOG_TYPE_INFO, "Cluster: " + idle.url + " takes " + std::to_string(stolen.size()) + " node(s) from " + victim->url + ".");
+    return clusterSend(nodes, idle, std::move(stolen), pending);
+}
+
+int clusterTest(std::vector<nodeInfo> &nodes, const clusterConfig &config)
+{
+    std::vector<clusterWorker> workers;
+    std::deque<size_t> pending;
+    size_t finished = 0;
+    int timeout = std::max(config.worker_timeout, 10);
+    for(const std::string &x : config.workers)
+    {
+        clusterWorker worker;
+        worker.url = x;
+        while(endsWith(worker.url, "/"))
+            worker.url.pop_back();
+        workers.push_back(worker);
+    }
+    for(size_t i = 0; i < nodes.size(); i++)
+        pending.push_back(i);
+    writeLog(LOG_TYPE_INFO, "Cluster: testing " + std::to_string(nodes.size()) + " node(s) on " + std::to_string(workers.size()) + " worker(s).");
+
+    while(finished < nodes.size())
+    {
+        for(clusterWorker &x : workers)
+        {
+            if(!x.failed && x.busy)
+                finished += clusterPoll(nodes, x, pending, timeout);
+        }
+        //the queue is shared out evenly among the idle workers, once it is empty they steal instead
+        for(clusterWorker &x : workers)
+        {
+            if(x.failed || x.busy)
+                continue;
+            size_t idle = std::count_if(workers.begin(), workers.end(), [](const clusterWorker &y){ return !y.failed && !y.busy; });
+            if(pending.size())
+            {
+                size_t count = (pending.size() + idle - 1) / idle;
+                std::vector<size_t> shard(pending.begin(), pending.begin() + count);
+                pending.erase(pending.begin(), pending.begin() + count);
+                clusterSend(nodes, x, std::move(shard), pending);
+            }
+            else
+                clusterSteal(nodes, x, workers, pending);
+        }
+        if(std::none_of(workers.begin(), workers.end(), [](const clusterWorker &y){ return !y.failed; }))
+            break;
+        if(finished < nodes.size())
+            sleep(1000);
+    }
+
+    for(clusterWorker &x : workers)
+        writeLog(LOG_TYPE_INFO, "Cluster: worker " + x.url + " tested " + std::to_string(x.tested) + " node(s)" + (x.failed ? ", dropped." : "."));
+    if(pending.size())
+    {
+        writeLog(LOG_TYPE_WARN, "Cluster: no worker left, testing the remaining " + std::to_string(pending.size()) + " node(s) locally.");
+        for(size_t x : pending)
+            singleTest(nodes[x], false);
+    }
+    return 0;
+}
+
+//worker side, one shard at a time since every test goes through the same local port
+
+static std::mutex worker_mutex;
+static std::string worker_shard;
+static std::vector<nodeInfo> worker_nodes;
+static size_t worker_limit = 0, worker_tested = 0;
+static bool worker_running = false;
+
+static void clusterWorkerRoutine()
+{
+    for(size_t i = 0; ; i++)
+    {
+        nodeInfo node;
+        {
+            guarded_mutex guard(worker_mutex);
+            if(i >= worker_limit)
+            {
+                worker_running = false;
+                break;
+            }
+            node = worker_nodes[i];
+        }
+        singleTest(node, false);
+        guarded_mutex guard(worker_mutex);
+        worker_nodes[i] = node;
+        worker_tested = i + 1;
+    }
+    writeLog(LOG_TYPE_INFO, "Cluster: shard " + worker_shard + " finished.");
+}
+
+std::string clusterWorkerAccept(const std::string &request)
+{
+    rapidjson::Document json;
+    json.Parse(request.data());
+    if(json.HasParseError() || !json.IsObject() || !json.HasMember("nodes") || !json["nodes"].IsArray())
+        return "error";
+    guarded_mutex guard(worker_mutex);
+    if(worker_running)
+        return "busy";
+
+    int port = to_int(GetMember(json, "socksport"), socksport);
+    std::string profile = GetMember(json, "profile");
+    if(profile.size())
+        selectTestProfile(profile);
+    eraseElements(worker_nodes);
+    for(rapidjson::SizeType i = 0; i < json["nodes"].Size(); i++)
+    {
+        const rapidjson::Value &x = json["nodes"][i];
+        nodeInfo node;
+        node.id = to_int(GetMember(x, "id"), i);
+        node.groupID = to_int(GetMember(x, "groupID"), 0);
+        node.linkType = to_int(GetMember(x, "linkType"), -1);
+        node.group = GetMember(x, "group");
+        node.remarks = GetMember(x, "remarks");
+        node.server = GetMember(x, "server");
+        node.port = to_int(GetMember(x, "port"), 0);
+        node.proxyStr = rebindLocalPort(GetMember(x, "config"), port, socksport);
+        worker_nodes.push_back(node);
+    }
+    worker_shard = GetMember(json, "shard");
+    worker_limit = worker_nodes.size();
+    worker_tested = 0;
+    worker_running = true;
+    writeLog(LOG_TYPE_INFO, "Cluster: accepted shard " + worker_shard + " with " + std::to_string(worker_limit) + " node(s).");
+    std::thread(clusterWorkerRoutine).detach();
+    return "accepted";
+}
+
+std::string clusterWorkerResults(const std::string &shard, size_t from)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    std::vector<nodeInfo> results;
+    std::string status;
+    {
+        guarded_mutex guard(worker_mutex);
+        if(shard.empty() || shard != worker_shard)
+            status = "unknown";
+        else
+        {
+            status = worker_running ? "running" : "done";
+            if(from < worker_tested)
+                results.assign(worker_nodes.begin() + from, worker_nodes.begin() + worker_tested);
+        }
+    }
+    writer.StartObject();
+    writer.Key("status");
+    writer.String(status.data());
+    writer.Key("count");
+    writer.Uint(results.size());
+    writer.Key("results");
+    writer.String(results.size() ? base64_encode(resultFileBuild(results, "Stair Speedtest Reborn " VERSION)).data() : "");
+    writer.EndObject();
+    return sb.GetString();
+}
+
+//the node under test is always kept, the answer tells how many were kept in the end
+std::string clusterWorkerTruncate(const std::string &request)
+{
+    rapidjson::Document json;
+    json.Parse(request.data());
+    if(json.HasParseError() || !json.IsObject())
+        return "error";
+    guarded_mutex guard(worker_mutex);
+    if(GetMember(json, "shard") != worker_shard)
+        return "{\"keep\":-1}";
+    size_t keep = std::max<size_t>(to_int(GetMember(json, "keep"), worker_limit), worker_tested + (worker_running ? 1 : 0));
+    if(keep < worker_limit)
+    {
+        writeLog(LOG_TYPE_INFO, "Cluster: shard " + worker_shard + " truncated to " + std::to_string(keep) + " node(s).");
+        worker_limit = keep;
+    }
+    return "{\"keep\":" + std::to_string(worker_limit) + "}";
+}
+
+//a shard under test owns the local port and the client, nothing else may test meanwhile
+bool clusterWorkerRunning()
+{
+    guarded_mutex guard(worker_mutex);
+    return worker_running;
+}
@@ -0,0 +1,34 @@
+#ifndef CLUSTER_H_INCLUDED
+#define CLUSTER_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "misc.h"
+#include "nodeinfo.h"
+
+/*
+Coordinator/worker sharding over the web server.
+The coordinator splits the node list into one shard per worker and posts each shard to "/worker/shard". Workers test
+their shard in order and the coordinator polls "/worker/results", which returns the nodes finished since the last
+poll as a binary result file. A worker that cannot be reached or makes no progress for worker_timeout seconds is
+dropped and the rest of its shard goes back to the queue. When the queue is empty, an idle worker takes the second
+half of the untested part of the largest shard through "/worker/truncate". Nodes left when no worker is alive
+are tested locally.
+*/
+
+struct clusterConfig
+{
+    string_array workers; //web server addresses, like http://127.0.0.1:10871
+    int worker_timeout = 120; //seconds without a finished node
+};
+
+int clusterTest(std::vector<nodeInfo> &nodes, const clusterConfig &config);
+
+//worker side, the bodies of the web server routes
+std::string clusterWorkerAccept(const std::string &request);
+std::string clusterWorkerResults(const std::string &shard, size_t from);
+std::string clusterWorkerTruncate(const std::string &request);
+bool clusterWorkerRunning();
+
+#endif // CLUSTER_H_INCLUDED
@@ -56,7 +56,37 @@ int explodeLog(const std::string &log, std::vector<nodeInfo> &nodes)
         ini.GetNumberArray<int>("RawPing", ",", node.rawPing);
         ini.GetNumberArray<int>("RawSitePing", ",", node.rawSitePing);
         ini.GetNumberArray<unsigned long long>("RawSpeed", ",", node.rawSpeed);
+        ini.GetNumberArray<int>("PhaseDuration", ",", node.phaseDuration);
         node.sitePing = ini.Get("SitePing");
+        node.socketOptions = ini.Get("SocketOptions");
+        node.testFile = ini.Get("TestFile");
+        node.mirrorProbe = ini.Get("MirrorProbe");
+        node.screenOnly = ini.GetBool("ScreenOnly");
+        if(ini.ItemExist("CachedTime"))
+            node.cachedTime = ini.GetNumber<long long>("CachedTime");
+        if(ini.ItemExist("LoadTest"))
+        {
+            node.connRate = ini.Get("ConnRate");
+            node.reqRate = ini.Get("ReqRate");
+            node.loadTest = ini.Get("LoadTest");
+        }
+        if(ini.ItemExist("PageLoadPath"))
+        {
+            node.pageLoad = ini.Get("PageLoad");
+            node.pageLoadPath = ini.Get("PageLoadPath");
+        }
+        if(ini.ItemExist("ScreenSpeed"))
+        {
+            node.screenSpeed = ini.Get("ScreenSpeed");
+            node.screenPing = ini.Get("ScreenPing");
+            node.screenTraffic = ini.GetNumber<unsigned long long>("ScreenTraffic");
+            node.screenScore = ini.GetNumber<double>("ScreenScore");
+        }
+        strTemp = ini.Get("TestMirrors");
+        node.testMirrors = strTemp.size() ? split(strTemp, "|") : string_array();
+        eraseElements(node.mirrorSpeed);
+        for(std::string &y : split(ini.Get("MirrorSpeed"), ","))
+            node.mirrorSpeed.push_back(to_number<unsigned long long>(y));
         node.totalRecvBytes = ini.GetNumber<unsigned long long>("UsedTraffic");
         node.ulSpeed = ini.Get("ULSpeed");
         nodes.push_back(node);
@@ -73,6 +103,15 @@ std::string replace_first(std::string str, const std::string &old_value, const s
     return str.replace(pos, old_value.size(), new_value);
 }
 
+//configs carry the local port of the instance that parsed them, a worker moves them onto its own
+std::string rebindLocalPort(const std::string &config, int from, int to)
+{
+    std::string result = config;
+    for(const std::string key : {"\"local_port\":", "\"localPort\":", "\"inbounds\":[{\"port\":"})
+        result = replace_all_distinct(result, key + std::to_string(from), key + std::to_string(to));
+    return result;
+}
+
 std::string vmessConstruct(const std::string &group, const std::string &remarks, const std::string &add, const std::string &port, const std::string &type, const std::string &id, const std::string &aid, const std::string &net, const std::string &cipher, const std::string &path, const std::string &host, const std::string &edge, const std::string &tls, tribool udp, tribool tfo, tribool scv, tribool tls13)
 {
     std::string base = base_vmess;
@@ -0,0 +1,310 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+#include "daemon.h"
+#include "logger.h"
+#include "misc.h"
+
+typedef std::lock_guard<std::mutex> guarded_mutex;
+
+//variables from main
+extern std::vector<nodeInfo> allNodes;
+extern int curGroupID;
+extern unsigned int node_count;
+extern bool save_history;
+
+//functions from main
+void addNodes(std::string link, bool multilink);
+int singleTest(nodeInfo &node, bool screen);
+int sweepTest(nodeInfo &node, int tcping_count, std::string *exit_ip);
+
+//every test starts from a copy of source, so nothing of an earlier result leaks into the next one
+struct daemonEntry
+{
+    uint64_t key = 0;
+    nodeInfo source;
+    daemonNodeState state;
+    size_t ring_head = 0; //slot overwritten next once the history is full
+    //the last full test, which every sweep is compared with
+    float base_ping = 0.0f;
+    float base_loss = 0.0f;
+    float base_site_ping = 0.0f;
+    std::string base_exit_ip;
+    std::string pending_trigger;
+};
+
+//only the scheduler thread changes the entry list, the mutex guards it against the web server readers
+static daemonConfig daemon_config;
+static std::vector<daemonEntry> daemon_entries;
+static daemonStatus daemon_status;
+static std::mutex daemon_mutex;
+static std::atomic<bool> daemon_running = false;
+
+static time_t daemonNextTest(time_t from)
+{
+    time_t spread = (time_t)daemon_config.interval * daemon_config.jitter / 100;
+    time_t offset = spread ? (time_t)(rand_u64() % (spread * 2 + 1)) - spread : 0;
+    return from + std::max<time_t>(daemon_config.interval + offset, 1);
+}
+
+static void daemonRingPush(daemonEntry &entry, const historyRecord &record)
+{
+    std::vector<historyRecord> &ring = entry.state.history;
+    if(ring.size() < (size_t)daemon_config.history_size)
+    {
+        ring.push_back(record);
+        return;
+    }
+    ring[entry.ring_head] = record;
+    entry.ring_head = (entry.ring_head + 1) % ring.size();
+}
+
+static float daemonLoss(const nodeInfo &node)
+{
+    return to_number<float>(node.pkLoss.substr(0, node.pkLoss.find('%')), 100.0f);
+}
+
+//returns why a full test should run now, or an empty string while the sweep matches the last full test
+static std::string daemonTrigger(daemonEntry &entry, const nodeInfo &probe, const std::string &exit_ip)
+{
+    float ping = to_number<float>(probe.avgPing, 0.0f), site_ping = to_number<float>(probe.sitePing, 0.0f), loss = daemonLoss(probe);
+    auto shifted = [](float now, float base)
+    {
+        float change = std::abs(now - base);
+        return change > daemon_config.sweep_latency_margin && change > base * daemon_config.sweep_latency_change / 100.0f;
+    };
+    if(entry.base_loss < 100.0f && loss >= 100.0f)
+        return "unreachable";
+    if(entry.base_loss >= 100.0f && loss < 100.0f)
+        return "reachable";
+    if(entry.base_loss == 0.0f && loss > 0.0f)
+        return "loss";
+    if(entry.base_ping > 0.0f && ping > 0.0f && shifted(ping, entry.base_ping))
+        return "latency";
+    //the full test may have skipped the website ping, then the first sweep sets the baseline
+    if(entry.base_site_ping > 0.0f && site_ping == 0.0f)
+        return "probe failed";
+    if(entry.base_site_ping > 0.0f && shifted(site_ping, entry.base_site_ping))
+        return "site latency";
+    if(entry.base_site_ping == 0.0f)
+        entry.base_site_ping = site_ping;
+    if(entry.base_exit_ip.size() && exit_ip.size() && exit_ip != entry.base_exit_ip)
+        return "exit ip";
+    if(entry.base_exit_ip.empty())
+        entry.base_exit_ip = exit_ip;
+    return std::string();
+}
+
+static void daemonRefresh()
+{
+    std::vector<nodeInfo> nodes;
+    eraseElements(allNodes);
+    curGroupID = 0;
+    for(std::string &x : daemon_config.links)
+    {
+        addNodes(x, daemon_config.links.size() > 1);
+        curGroupID++;
+    }
+    nodes.swap(allNodes);
+
+    time_t now = time(NULL);
+    guarded_mutex guard(daemon_mutex);
+    daemon_status.last_refresh = now;
+    daemon_status.next_refresh = now + daemon_config.refresh_interval;
+    if(nodes.empty())
+    {
+        writeLog(LOG_TYPE_WARN, "Daemon: no node found in the subscriptions, keeping " + std::to_string(daemon_entries.size()) + " node(s) from the last refresh.");
+        return;
+    }
+
+    std::map<uint64_t, size_t> old_index;
+    for(size_t i = 0; i < daemon_entries.size(); i++)
+        old_index[daemon_entries[i].key] = i;
+    std::set<uint64_t> seen;
+    size_t new_count = 0, new_index = 0;
+    for(nodeInfo &x : nodes)
+        if(!old_index.count(historyNodeKey(x)))
+            new_count++;
+
+    //nodes seen for the first time are spread evenly over one interval instead of all being due at once
+    std::vector<daemonEntry> entries;
+    for(nodeInfo &x : nodes)
+    {
+        uint64_t key = historyNodeKey(x);
+        if(!seen.insert(key).second)
+            continue;
+        daemonEntry entry;
+        auto iter = old_index.find(key);
+        if(iter != old_index.end())
+        {
+            entry = std::move(daemon_entries[iter->second]);
+            entry.state.node.group = x.group;
+            entry.state.node.remarks = x.remarks;
+        }
+        else
+        {
+            entry.key = key;
+            entry.state.node = x;
+            entry.state.next_test = now + (time_t)daemon_config.interval * new_index++ / new_count;
+            entry.state.history.reserve(daemon_config.history_size);
+        }
+        entry.source = x;
+        entries.push_back(std::move(entry));
+    }
+    for(size_t i = 0; i < entries.size(); i++)
+        entries[i].source.id = entries[i].state.node.id = i;
+    writeLog(LOG_TYPE_INFO, "Daemon: refreshed subscriptions, " + std::to_string(entries.size()) + " node(s), " + std::to_string(new_index) + " new, " +
+             std::to_string(daemon_entries.size() + new_index - entries.size()) + " removed.");
+    daemon_entries.swap(entries);
+    node_count = daemon_entries.size();
+}
+
+static void daemonRoutine()
+{
+    time_t spacing = daemon_config.rate_limit > 0 ? std::max(60 / daemon_config.rate_limit, 1) : 0, last_start = 0;
+    while(daemon_running)
+    {
+        time_t now = time(NULL);
+        if(now >= daemon_status.next_refresh)
+            daemonRefresh();
+
+        //a due full test goes first as long as the rate limit allows it, sweeps are not rate limited
+        nodeInfo node;
+        int index = -1;
+        bool sweep = false;
+        {
+            guarded_mutex guard(daemon_mutex);
+            for(size_t i = 0; i < daemon_entries.size() && now - last_start >= spacing; i++)
+            {
+                if(daemon_entries[i].state.next_test <= now && (index < 0 || daemon_entries[i].state.next_test < daemon_entries[index].state.next_test))
+                    index = i;
+            }
+            for(size_t i = 0; i < daemon_entries.size() && index < 0 && daemon_config.sweep_interval > 0; i++)
+            {
+                const daemonNodeState &state = daemon_entries[i].state;
+                if(state.runs && state.next_sweep <= now && state.next_test > now)
+                {
+                    index = i;
+                    sweep = true;
+                }
+            }
+            if(index >= 0)
+            {
+                node = daemon_entries[index].source;
+                daemon_status.current = node.group + " - " + node.remarks;
+            }
+        }
+        if(index < 0)
+        {
+            sleep(1000);
+            continue;
+        }
+
+        if(sweep)
+        {
+            std::string exit_ip;
+            sweepTest(node, daemon_config.sweep_tcping_count, daemon_config.sweep_exit_ip ? &exit_ip : nullptr);
+            guarded_mutex guard(daemon_mutex);
+            daemonEntry &entry = daemon_entries[index];
+            entry.state.last_sweep = now;
+            entry.state.next_sweep = now + daemon_config.sweep_interval;
+            entry.state.sweeps++;
+            entry.state.sweep_ping = to_number<float>(node.avgPing, 0.0f);
+            entry.state.sweep_loss = daemonLoss(node);
+            entry.state.sweep_site_ping = to_number<float>(node.sitePing, 0.0f);
+            entry.state.exit_ip = exit_ip;
+            std::string trigger = daemonTrigger(entry, node, exit_ip);
+            if(trigger.size() && entry.state.next_test > now)
+            {
+                writeLog(LOG_TYPE_INFO, "Daemon: " + trigger + " on " + node.group + " - " + node.remarks + ", full test brought forward.");
+                entry.pending_trigger = trigger;
+                entry.state.next_test = now;
+                daemon_status.triggered++;
+            }
+            daemon_status.sweeps++;
+            daemon_status.current.clear();
+            continue;
+        }
+
+        last_start = now;
+        singleTest(node, false);
+        historyRecord record = historyMakeRecord(node, now);
+        std::string exit_ip = daemon_config.sweep_interval > 0 && daemon_config.sweep_exit_ip ? node.outboundGeoIP.get().ip : "";
+        {
+            guarded_mutex guard(daemon_mutex);
+            daemonEntry &entry = daemon_entries[index];
+            entry.state.trigger = entry.pending_trigger.size() ? entry.pending_trigger : (entry.state.runs ? "schedule" : "first test");
+            entry.pending_trigger.clear();
+            entry.state.node = node;
+            entry.state.last_test = now;
+            entry.state.next_test = daemonNextTest(now);
+            entry.state.next_sweep = now + daemon_config.sweep_interval;
+            entry.state.runs++;
+            entry.base_ping = to_number<float>(node.avgPing, 0.0f);
+            entry.base_loss = daemonLoss(node);
+            entry.base_site_ping = to_number<float>(node.sitePing, 0.0f);
+            entry.base_exit_ip = exit_ip;
+            daemonRingPush(entry, record);
+            daemon_status.tests++;
+            daemon_status.current.clear();
+        }
+        if(save_history)
+            historyAppend({node}, now);
+    }
+}
+
+int daemonStart(const daemonConfig &config)
+{
+    if(daemon_running)
+        return -1;
+    if(config.links.empty())
+    {
+        writeLog(LOG_TYPE_ERROR, "Daemon mode needs at least one subscription link.");
+        return -1;
+    }
+    daemon_config = config;
+    daemon_config.interval = std::max(daemon_config.interval, 60);
+    daemon_config.jitter = std::clamp(daemon_config.jitter, 0, 50);
+    daemon_config.rate_limit = std::max(daemon_config.rate_limit, 0);
+    daemon_config.refresh_interval = std::max(daemon_config.refresh_interval, 60);
+    daemon_config.history_size = std::max(daemon_config.history_size, 1);
+    daemon_config.sweep_interval = std::max(daemon_config.sweep_interval, 0);
+    daemon_config.sweep_tcping_count = std::clamp(daemon_config.sweep_tcping_count, 1, 6);
+    daemon_status.started = time(NULL);
+    daemon_running = true;
+    writeLog(LOG_TYPE_INFO, "Daemon: " + std::to_string(daemon_config.links.size()) + " link(s), interval " + std::to_string(daemon_config.interval) + "s +/- " +
+             std::to_string(daemon_config.jitter) + "%, " + (daemon_config.rate_limit ? "at most " + std::to_string(daemon_config.rate_limit) + " test(s) per minute" : std::string("no rate limit")) + ", refresh every " +
+             std::to_string(daemon_config.refresh_interval) + "s, " + std::to_string(daemon_config.history_size) + " result(s) kept per node.");
+    if(daemon_config.sweep_interval > 0)
+        writeLog(LOG_TYPE_INFO, "Daemon: sweep every " + std::to_string(daemon_config.sweep_interval) + "s with " + std::to_string(daemon_config.sweep_tcping_count) +
+                 " TCP ping(s), latency trigger " + std::to_string(daemon_config.sweep_latency_change) + "% and " + std::to_string(daemon_config.sweep_latency_margin) +
+                 "ms, exit address check " + (daemon_config.sweep_exit_ip ? "on" : "off") + ".");
+    std::thread(daemonRoutine).detach();
+    return 0;
+}
+
+bool daemonRunning()
+{
+    return daemon_running;
+}
+
+void daemonSnapshot(std::vector<daemonNodeState> &result, daemonStatus &status)
+{
+    guarded_mutex guard(daemon_mutex);
+    status = daemon_status;
+    eraseElements(result);
+    for(daemonEntry &x : daemon_entries)
+    {
+        result.push_back(x.state);
+        std::vector<historyRecord> &history = result.back().history;
+        std::rotate(history.begin(), history.begin() + x.ring_head, history.end());
+    }
+}
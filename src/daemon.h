@@ -0,0 +1,69 @@
+#ifndef DAEMON_H_INCLUDED
+#define DAEMON_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <ctime>
+
+#include "misc.h"
+#include "nodeinfo.h"
+#include "history.h"
+
+/*
+Continuous monitoring: the node set stays in memory and every node is tested again on its own schedule.
+Nodes start spread evenly over one interval, each retest lands interval +/- jitter after the previous one, and
+a rate limit keeps a minimum spacing between two tests. Subscriptions are fetched again every refresh interval,
+nodes that are still listed keep their schedule and their last results.
+With sweeps enabled, tested nodes also get a cheap check every sweep interval: a few TCP pings, one website ping
+and the exit address through the node. A full test is brought forward when the check differs from the last full
+test, so the interval only caps the age of a speed result.
+*/
+
+struct daemonConfig
+{
+    string_array links;
+    int interval = 3600; //seconds between two tests of a node
+    int jitter = 10; //percent of the interval
+    int rate_limit = 6; //tests per minute, 0 for no limit
+    int refresh_interval = 21600; //seconds between subscription refreshes
+    int history_size = 48; //results kept in memory per node
+    int sweep_interval = 0; //seconds between two sweeps of a node, 0 to disable
+    int sweep_tcping_count = 3;
+    int sweep_latency_change = 50; //percent of the last full test
+    int sweep_latency_margin = 30; //milliseconds, smaller changes never count
+    bool sweep_exit_ip = true;
+};
+
+struct daemonNodeState
+{
+    nodeInfo node; //latest result, or the parsed node before the first test
+    time_t last_test = 0;
+    time_t next_test = 0;
+    unsigned int runs = 0;
+    std::string trigger; //why the latest full test ran
+    std::vector<historyRecord> history; //oldest first
+    time_t last_sweep = 0;
+    time_t next_sweep = 0;
+    unsigned int sweeps = 0;
+    float sweep_ping = 0.0f; //milliseconds
+    float sweep_loss = 0.0f; //percent
+    float sweep_site_ping = 0.0f;
+    std::string exit_ip;
+};
+
+struct daemonStatus
+{
+    time_t started = 0;
+    time_t last_refresh = 0;
+    time_t next_refresh = 0;
+    unsigned int tests = 0;
+    unsigned int sweeps = 0;
+    unsigned int triggered = 0; //full tests brought forward by a sweep
+    std::string current;
+};
+
+int daemonStart(const daemonConfig &config);
+bool daemonRunning();
+void daemonSnapshot(std::vector<daemonNodeState> &result, daemonStatus &status);
+
+#endif // DAEMON_H_INCLUDED
@@ -0,0 +1,41 @@
+#include <algorithm>
+
+#include "deadline.h"
+
+using namespace std::chrono;
+
+static thread_local deadlineTime deadline_current = deadlineTime::max();
+
+deadlineScope::deadlineScope(int seconds) : _saved(deadline_current)
+{
+    if(seconds > 0)
+        deadline_current = std::min(deadline_current, steady_clock::now() + std::chrono::seconds(seconds));
+}
+
+deadlineScope::deadlineScope(deadlineTime deadline) : _saved(deadline_current)
+{
+    deadline_current = std::min(deadline_current, deadline);
+}
+
+deadlineScope::~deadlineScope()
+{
+    deadline_current = _saved;
+}
+
+deadlineTime deadlineCurrent()
+{
+    return deadline_current;
+}
+
+bool deadlineExpired()
+{
+    return deadline_current != deadlineTime::max() && steady_clock::now() >= deadline_current;
+}
+
+int deadlineRemaining(int timeout)
+{
+    if(deadline_current == deadlineTime::max())
+        return timeout;
+    long long left = duration_cast<milliseconds>(deadline_current - steady_clock::now()).count();
+    return std::max<long long>(std::min<long long>(timeout, left), 1);
+}
@@ -0,0 +1,31 @@
+#ifndef DEADLINE_H_INCLUDED
+#define DEADLINE_H_INCLUDED
+
+#include <chrono>
+
+/*
+Time budget of the node being tested. singleTest() opens a deadlineScope and every wait on its way asks for
+what is left: socket timeouts and connects are cut to it, probe loops stop once it has run out, curl calls get
+it as their total timeout and futures are only awaited until it. The deadline belongs to the thread, tasks
+started for the node take deadlineCurrent() along and open a scope with it.
+*/
+
+typedef std::chrono::steady_clock::time_point deadlineTime;
+
+class deadlineScope
+{
+public:
+    deadlineScope(int seconds); //0 for no limit, an inner scope never extends the outer one
+    deadlineScope(deadlineTime deadline);
+    ~deadlineScope();
+    deadlineScope(const deadlineScope&) = delete;
+    deadlineScope& operator=(const deadlineScope&) = delete;
+private:
+    deadlineTime _saved;
+};
+
+deadlineTime deadlineCurrent(); //time_point::max() without a deadline
+bool deadlineExpired();
+int deadlineRemaining(int timeout); //timeout in milliseconds cut to the time left, at least 1
+
+#endif // DEADLINE_H_INCLUDED
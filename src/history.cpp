@@ -0,0 +1,492 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "history.h"
+#include "logger.h"
+#include "misc.h"
+#include "speedtestutil.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/file.h>
+#endif // _WIN32
+
+#ifdef _WIN32
+#define history_fseek _fseeki64
+#define history_ftell _ftelli64
+#else
+#define history_fseek fseeko
+#define history_ftell ftello
+#endif // _WIN32
+
+#define HISTORY_DIR "history"
+#define HISTORY_INDEX_DIR HISTORY_DIR PATH_SLASH "index"
+#define HISTORY_RECORDS_PATH HISTORY_DIR PATH_SLASH "records.dat"
+#define HISTORY_NODES_PATH HISTORY_DIR PATH_SLASH "nodes.txt"
+
+static const char history_magic[8] = {'S', 'S', 'T', 'H', 'I', 'S', 'T', '\0'};
+static const uint32_t history_version = 1;
+static const long long history_header_size = 16;
+static const size_t history_scan_chunk = 4096;
+
+static_assert(sizeof(historyRecord) == 64, "history record layout changed, bump history_version");
+
+typedef std::lock_guard<std::mutex> guarded_mutex;
+static std::mutex history_mutex;
+
+//node table cache, reloaded when the file on disk changes size
+static std::map<uint64_t, historyNode> history_nodes;
+static long long history_nodes_size = -1;
+
+std::string historyNodeIdentity(const nodeInfo &node)
+{
+    if(node.server.empty())
+        return node.group + "^" + node.remarks;
+    return std::to_string(node.linkType) + "|" + node.server + ":" + std::to_string(node.port);
+}
+
+uint64_t historyNodeKey(const nodeInfo &node)
+{
+    return hash_(historyNodeIdentity(node));
+}
+
+std::string historyKeyString(uint64_t key)
+{
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)key);
+    return std::string(buf);
+}
+
+std::string historyTimeString(int64_t time)
+{
+    char buf[32] = {};
+    time_t lt = time;
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&lt));
+    return std::string(buf);
+}
+
+static std::string historyIndexPath(uint64_t key)
+{
+    return HISTORY_INDEX_DIR PATH_SLASH + historyKeyString(key) + ".idx";
+}
+
+static uint64_t historySpeed(const std::string &speed)
+{
+    if(speed.empty() || speed == "N/A")
+        return 0;
+    return streamToInt(speed);
+}
+
+static std::string historyEscapeField(std::string str)
+{
+    std::replace(str.begin(), str.end(), '\t', ' ');
+    std::replace(str.begin(), str.end(), '\n', ' ');
+    std::replace(str.begin(), str.end(), '\r', ' ');
+    return str;
+}
+
+static long long historyFileSize(const std::string &path)
+{
+    FILE *fp = fopen(path.data(), "rb");
+    if(!fp)
+        return -1;
+    history_fseek(fp, 0, SEEK_END);
+    long long size = history_ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+static void historyLoadNodes()
+{
+    long long size = historyFileSize(HISTORY_NODES_PATH);
+    if(size == history_nodes_size)
+        return;
+    history_nodes.clear();
+    history_nodes_size = size;
+    if(size <= 0)
+        return;
+
+    std::ifstream infile(HISTORY_NODES_PATH, std::ios::binary);
+    std::string line;
+    while(getline(infile, line))
+    {
+        string_array vArray = split(line, "\t");
+        if(vArray.size() != 4)
+            continue;
+        historyNode node;
+        node.key = std::stoull(vArray[0], nullptr, 16);
+        node.identity = vArray[1];
+        node.group = vArray[2];
+        node.remarks = vArray[3];
+        history_nodes[node.key] = std::move(node); //later lines carry the latest names
+    }
+}
+
+static int historyOpenRecords(std::ifstream &infile, uint64_t &count)
+{
+    char header[history_header_size] = {};
+    uint32_t version = 0, record_size = 0;
+    infile.open(HISTORY_RECORDS_PATH, std::ios::binary);
+    if(!infile.is_open())
+        return -1;
+    infile.seekg(0, std::ios::end);
+    long long size = infile.tellg();
+    if(size < history_header_size)
+        return -1;
+    infile.seekg(0, std::ios::beg);
+    infile.read(header, history_header_size);
+    memcpy(&version, header + 8, sizeof(version));
+    memcpy(&record_size, header + 12, sizeof(record_size));
+    if(memcmp(header, history_magic, sizeof(history_magic)) != 0 || version != history_version || record_size != sizeof(historyRecord))
+    {
+        writeLog(LOG_TYPE_ERROR, "History store has an unknown format. Ignoring.");
+        return -1;
+    }
+    count = (size - history_header_size) / sizeof(historyRecord);
+    return 0;
+}
+
+static bool historyReadRecord(std::ifstream &infile, long long offset, historyRecord &record)
+{
+    infile.seekg(offset, std::ios::beg);
+    infile.read(reinterpret_cast<char*>(&record), sizeof(historyRecord));
+    return infile.gcount() == sizeof(historyRecord);
+}
+
+//records are appended in time order, so the first one inside a window can be found by bisection
+static uint64_t historyLowerBound(std::ifstream &infile, uint64_t count, time_t from)
+{
+    uint64_t low = 0, high = count;
+    historyRecord record;
+    while(low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+        if(!historyReadRecord(infile, history_header_size + mid * sizeof(historyRecord), record))
+            return count;
+        if(record.time < from)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+template <typename F>
+static void historyScan(std::ifstream &infile, uint64_t begin, uint64_t count, F &&op)
+{
+    std::vector<historyRecord> buffer(history_scan_chunk);
+    infile.clear();
+    infile.seekg(history_header_size + begin * sizeof(historyRecord), std::ios::beg);
+    while(begin < count)
+    {
+        size_t batch = std::min<uint64_t>(history_scan_chunk, count - begin);
+        infile.read(reinterpret_cast<char*>(buffer.data()), batch * sizeof(historyRecord));
+        size_t got = infile.gcount() / sizeof(historyRecord);
+        for(size_t i = 0; i < got; i++)
+            op(buffer[i]);
+        if(got < batch)
+            break;
+        begin += got;
+    }
+}
+
+static historyNode historyGetNode(uint64_t key)
+{
+    auto iter = history_nodes.find(key);
+    if(iter != history_nodes.end())
+        return iter->second;
+    historyNode node;
+    node.key = key;
+    node.identity = historyKeyString(key);
+    return node;
+}
+
+historyRecord historyMakeRecord(const nodeInfo &node, time_t run_time)
+{
+    historyRecord record;
+    record.key = historyNodeKey(node);
+    record.time = run_time;
+    record.avg_speed = historySpeed(node.avgSpeed);
+    record.max_speed = historySpeed(node.maxSpeed);
+    record.ul_speed = historySpeed(node.ulSpeed);
+    record.traffic = node.totalRecvBytes;
+    record.avg_ping = to_number<float>(node.avgPing, 0.0f);
+    record.site_ping = to_number<float>(node.sitePing, 0.0f);
+    record.pk_loss = to_number<float>(node.pkLoss.substr(0, node.pkLoss.find('%')), 100.0f);
+    record.flags = node.online ? HISTORY_FLAG_ONLINE : 0;
+    return record;
+}
+
+//whole-file lock shared with other instances using the same directory, history_mutex only covers this process
+static bool historyLockFile(FILE *fp, bool lock)
+{
+#ifdef _WIN32
+    HANDLE handle = (HANDLE)_get_osfhandle(_fileno(fp));
+    OVERLAPPED overlapped = {};
+    if(lock)
+        return LockFileEx(handle, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
+    return UnlockFileEx(handle, 0, MAXDWORD, MAXDWORD, &overlapped);
+#else
+    return flock(fileno(fp), lock ? LOCK_EX : LOCK_UN) == 0;
+#endif // _WIN32
+}
+
+int historyAppend(const std::vector<nodeInfo> &nodes, time_t run_time)
+{
+    guarded_mutex guard(history_mutex);
+    if(!run_time)
+        run_time = time(NULL);
+    makeDir(HISTORY_DIR);
+    makeDir(HISTORY_INDEX_DIR);
+
+    FILE *fp = fopen(HISTORY_RECORDS_PATH, "ab");
+    if(!fp)
+    {
+        writeLog(LOG_TYPE_ERROR, "Cannot open history store for writing.");
+        return -1;
+    }
+    defer(fclose(fp);)
+    //the offsets written to the indexes are only right while nobody else appends
+    if(!historyLockFile(fp, true))
+    {
+        writeLog(LOG_TYPE_ERROR, "Cannot lock history store for writing.");
+        return -1;
+    }
+    defer(fflush(fp); historyLockFile(fp, false);)
+    historyLoadNodes();
+    history_fseek(fp, 0, SEEK_END);
+    long long offset = history_ftell(fp);
+    if(offset == 0)
+    {
+        char header[history_header_size] = {};
+        uint32_t record_size = sizeof(historyRecord);
+        memcpy(header, history_magic, sizeof(history_magic));
+        memcpy(header + 8, &history_version, sizeof(history_version));
+        memcpy(header + 12, &record_size, sizeof(record_size));
+        fwrite(header, 1, history_header_size, fp);
+        offset = history_header_size;
+    }
+
+    std::string node_lines;
+    unsigned int appended = 0;
+    for(const nodeInfo &x : nodes)
+    {
+        if(x.proxyStr == "LOG" || x.cachedTime) //imported from an old result or reused, already recorded when it was tested
+            continue;
+        historyRecord record = historyMakeRecord(x, run_time);
+        if(fwrite(&record, sizeof(historyRecord), 1, fp) != 1)
+        {
+            writeLog(LOG_TYPE_ERROR, "Failed to append to history store.");
+            return -1;
+        }
+
+        uint64_t record_offset = offset;
+        FILE *idx = fopen(historyIndexPath(record.key).data(), "ab");
+        if(idx)
+        {
+            fwrite(&record_offset, sizeof(record_offset), 1, idx);
+            fclose(idx);
+        }
+        offset += sizeof(historyRecord);
+        appended++;
+
+        auto iter = history_nodes.find(record.key);
+        if(iter == history_nodes.end() || iter->second.group != x.group || iter->second.remarks != x.remarks)
+        {
+            historyNode &node = history_nodes[record.key];
+            node.key = record.key;
+            node.identity = historyEscapeField(historyNodeIdentity(x));
+            node.group = historyEscapeField(x.group);
+            node.remarks = historyEscapeField(x.remarks);
+            node_lines += historyKeyString(node.key) + "\t" + node.identity + "\t" + node.group + "\t" + node.remarks + "\n";
+        }
+    }
+    if(node_lines.size())
+    {
+        fileWrite(HISTORY_NODES_PATH, node_lines, false);
+        history_nodes_size = historyFileSize(HISTORY_NODES_PATH);
+    }
+    writeLog(LOG_TYPE_INFO, "Appended " + std::to_string(appended) + " record(s) to history store.");
+    return 0;
+}
+
+int historyFindNodes(const std::string &query, std::vector<historyNode> &result)
+{
+    guarded_mutex guard(history_mutex);
+    historyLoadNodes();
+    for(auto &x : history_nodes)
+    {
+        if(historyKeyString(x.first) == query || x.second.identity == query)
+        {
+            result.clear();
+            result.push_back(x.second);
+            return 0;
+        }
+        if(strFind(x.second.remarks, query) || strFind(x.second.identity, query))
+            result.push_back(x.second);
+    }
+    return 0;
+}
+
+int historyNodeRecords(uint64_t key, time_t from, time_t to, std::vector<historyRecord> &result)
+{
+    guarded_mutex guard(history_mutex);
+    std::string index = fileGet(historyIndexPath(key));
+    std::vector<uint64_t> offsets(index.size() / sizeof(uint64_t));
+    memcpy(offsets.data(), index.data(), offsets.size() * sizeof(uint64_t));
+    if(offsets.empty())
+        return 0;
+
+    std::ifstream infile;
+    uint64_t count = 0;
+    if(historyOpenRecords(infile, count) != 0)
+        return -1;
+
+    //offsets of one node are in time order as well
+    size_t low = 0, high = offsets.size();
+    historyRecord record;
+    while(low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if(!historyReadRecord(infile, offsets[mid], record))
+            return -1;
+        if(record.time < from)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    for(size_t i = low; i < offsets.size(); i++)
+    {
+        if(!historyReadRecord(infile, offsets[i], record) || record.key != key)
+            break;
+        if(to && record.time > to)
+            break;
+        result.push_back(record);
+    }
+    return 0;
+}
+
+int historyBestNodes(int hours, unsigned int count, std::vector<historySummary> &result)
+{
+    guarded_mutex guard(history_mutex);
+    std::ifstream infile;
+    uint64_t total = 0;
+    if(historyOpenRecords(infile, total) != 0)
+        return -1;
+    historyLoadNodes();
+
+    std::unordered_map<uint64_t, historySummary> summaries;
+    uint64_t begin = historyLowerBound(infile, total, time(NULL) - hours * 3600LL);
+    historyScan(infile, begin, total, [&](const historyRecord &x)
+    {
+        historySummary &summary = summaries[x.key];
+        summary.runs++;
+        summary.latest = x;
+        if(!(x.flags & HISTORY_FLAG_ONLINE))
+            return;
+        summary.online_runs++;
+        summary.avg_speed += x.avg_speed;
+        summary.avg_ping += x.avg_ping;
+        if(x.avg_speed > summary.best.avg_speed)
+            summary.best = x;
+    });
+
+    for(auto &x : summaries)
+    {
+        if(!x.second.online_runs)
+            continue;
+        x.second.node = historyGetNode(x.first);
+        x.second.avg_speed /= x.second.online_runs;
+        x.second.avg_ping /= x.second.online_runs;
+        result.push_back(std::move(x.second));
+    }
+    std::sort(result.begin(), result.end(), [](const historySummary &a, const historySummary &b)
+    {
+        if(a.best.avg_speed != b.best.avg_speed)
+            return a.best.avg_speed > b.best.avg_speed;
+        return a.avg_ping < b.avg_ping;
+    });
+    if(count && result.size() > count)
+        result.resize(count);
+    return 0;
+}
+
+template <typename T>
+static double historyMedian(std::vector<T> values)
+{
+    if(values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    size_t mid = values.size() / 2;
+    if(values.size() % 2)
+        return values[mid];
+    return (values[mid - 1] + values[mid]) / 2.0;
+}
+
+int historyRegressions(int hours, double threshold, std::vector<historyRegression> &result)
+{
+    guarded_mutex guard(history_mutex);
+    std::ifstream infile;
+    uint64_t total = 0;
+    if(historyOpenRecords(infile, total) != 0)
+        return -1;
+    historyLoadNodes();
+
+    std::unordered_map<uint64_t, std::vector<historyRecord>> runs;
+    uint64_t begin = historyLowerBound(infile, total, time(NULL) - hours * 3600LL);
+    historyScan(infile, begin, total, [&](const historyRecord &x)
+    {
+        runs[x.key].push_back(x);
+    });
+
+    for(auto &x : runs)
+    {
+        std::vector<historyRecord> &records = x.second;
+        if(records.size() < 3) //not enough runs to have a baseline
+            continue;
+        historyRecord &latest = records.back();
+        std::vector<uint64_t> speeds;
+        std::vector<float> pings;
+        unsigned int online = 0;
+        for(size_t i = 0; i < records.size() - 1; i++)
+        {
+            if(!(records[i].flags & HISTORY_FLAG_ONLINE))
+                continue;
+            online++;
+            speeds.push_back(records[i].avg_speed);
+            pings.push_back(records[i].avg_ping);
+        }
+        if(online * 2 < records.size() - 1) //was mostly offline before, nothing to regress from
+            continue;
+
+        historyRegression regression;
+        regression.baseline_speed = historyMedian(speeds);
+        regression.baseline_ping = historyMedian(pings);
+        if(!(latest.flags & HISTORY_FLAG_ONLINE))
+            regression.reason = "offline";
+        else if(regression.baseline_speed > 0 && latest.avg_speed < regression.baseline_speed * (1.0 - threshold))
+            regression.reason = "speed";
+        else if(regression.baseline_ping > 0 && latest.avg_ping > regression.baseline_ping * (1.0 + threshold))
+            regression.reason = "ping";
+        else
+            continue;
+        regression.node = historyGetNode(x.first);
+        regression.latest = latest;
+        result.push_back(std::move(regression));
+    }
+    std::sort(result.begin(), result.end(), [](const historyRegression &a, const historyRegression &b)
+    {
+        return a.latest.time > b.latest.time;
+    });
+    return 0;
+}
@@ -0,0 +1,70 @@
+#ifndef HISTORY_H_INCLUDED
+#define HISTORY_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "nodeinfo.h"
+
+enum
+{
+    HISTORY_FLAG_ONLINE = 1
+};
+
+//fixed-size record appended to history/records.dat for every tested node
+struct historyRecord
+{
+    uint64_t key = 0; //hash of node identity
+    int64_t time = 0; //unix time of the run
+    uint64_t avg_speed = 0; //bytes per second
+    uint64_t max_speed = 0;
+    uint64_t ul_speed = 0;
+    uint64_t traffic = 0;
+    float avg_ping = 0.0f; //milliseconds
+    float site_ping = 0.0f;
+    float pk_loss = 0.0f; //percent
+    uint32_t flags = 0;
+};
+
+struct historyNode
+{
+    uint64_t key = 0;
+    std::string identity;
+    std::string group;
+    std::string remarks;
+};
+
+struct historySummary
+{
+    historyNode node;
+    unsigned int runs = 0;
+    unsigned int online_runs = 0;
+    historyRecord best;
+    historyRecord latest;
+    double avg_speed = 0.0;
+    double avg_ping = 0.0;
+};
+
+struct historyRegression
+{
+    historyNode node;
+    historyRecord latest;
+    double baseline_speed = 0.0;
+    double baseline_ping = 0.0;
+    std::string reason;
+};
+
+std::string historyNodeIdentity(const nodeInfo &node);
+uint64_t historyNodeKey(const nodeInfo &node);
+std::string historyKeyString(uint64_t key);
+std::string historyTimeString(int64_t time);
+historyRecord historyMakeRecord(const nodeInfo &node, time_t run_time);
+
+int historyAppend(const std::vector<nodeInfo> &nodes, time_t run_time = 0);
+int historyFindNodes(const std::string &query, std::vector<historyNode> &result);
+int historyNodeRecords(uint64_t key, time_t from, time_t to, std::vector<historyRecord> &result);
+int historyBestNodes(int hours, unsigned int count, std::vector<historySummary> &result);
+int historyRegressions(int hours, double threshold, std::vector<historyRegression> &result);
+
+#endif // HISTORY_H_INCLUDED
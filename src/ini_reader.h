@@ -2,8 +2,9 @@
 #define INI_READER_H_INCLUDED
 
 #include <string>
-#include <sstream>
+#include <string_view>
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <numeric>
 
@@ -23,12 +24,14 @@ typedef std::map<std::string, std::multimap<std::string, std::string>> ini_data_
 typedef std::multimap<std::string, std::string> string_multimap;
 typedef std::vector<std::string> string_array;
 typedef std::string::size_type string_size;
+typedef std::unordered_map<std::string_view, ini_data_struct::iterator> ini_index_struct;
 
 class INIReader
 {
     /**
     *  @brief A simple INI reader which utilize map and vector
     *  to store sections and items, allowing access in logarithmic time.
+    *  Sections are also indexed by a hash table keyed on the map's own keys, so looking up a section takes constant time.
     */
 private:
     /**
@@ -39,6 +42,7 @@ private:
     ini_data_struct ini_content;
     string_array exclude_sections, include_sections, direct_save_sections;
     string_array section_order;
+    ini_index_struct section_index;
 
     std::string cached_section;
     ini_data_struct::iterator cached_section_content;
@@ -72,6 +76,37 @@ private:
         return std::find(direct_save_sections.cbegin(), direct_save_sections.cend(), section) != direct_save_sections.cend();
     }
 
+    inline ini_data_struct::iterator __priv_find_section(const std::string &section)
+    {
+        auto iter = section_index.find(section);
+        return iter != section_index.end() ? iter->second : ini_content.end();
+    }
+
+    inline ini_data_struct::iterator __priv_add_section(std::string section, string_multimap items)
+    {
+        auto iter = ini_content.emplace(std::move(section), std::move(items)).first;
+        if(section_index.emplace(iter->first, iter).second)
+            section_order.emplace_back(iter->first);
+        return iter;
+    }
+
+    inline void __priv_rebuild_index()
+    {
+        eraseElements(section_index);
+        section_index.reserve(ini_content.size());
+        for(auto iter = ini_content.begin(); iter != ini_content.end(); iter++)
+            section_index.emplace(iter->first, iter);
+    }
+
+    inline void __priv_cache_section(const std::string &section)
+    {
+        if(cached_section != section)
+        {
+            cached_section = section;
+            cached_section_content = __priv_find_section(section);
+        }
+    }
+
     inline std::string __priv_get_err_str(int error)
     {
         switch(error)
@@ -138,6 +173,8 @@ public:
 
     INIReader& operator=(const INIReader& src)
     {
+        if(this == &src)
+            return *this;
         //copy contents
         ini_content = src.ini_content;
         //copy status
@@ -145,8 +182,14 @@ public:
         current_section = src.current_section;
         exclude_sections = src.exclude_sections;
         include_sections = src.include_sections;
+        direct_save_sections = src.direct_save_sections;
         section_order = src.section_order;
+        __priv_rebuild_index();
+        cached_section.clear();
+        cached_section_content = ini_content.end();
         isolated_items_section = src.isolated_items_section;
+        last_error = src.last_error;
+        last_error_index = src.last_error_index;
         //copy preferences
         do_utf8_to_gbk = src.do_utf8_to_gbk;
         store_any_line = src.store_any_line;
@@ -156,7 +199,10 @@ public:
         return *this;
     }
 
-    INIReader(const INIReader &src) = default;
+    INIReader(const INIReader &src)
+    {
+        *this = src;
+    }
 
     std::string GetLastError()
     {
@@ -202,26 +248,35 @@ public:
     *  @brief Parse INI content into mapped data structure.
     * If exclude sections are set, these sections will not be stored.
     * If include sections are set, only these sections will be stored.
+    * Lines are scanned in place, only names and values are copied into the data structure.
     */
-    int Parse(std::string content) //parse content into mapped data
+    int Parse(std::string_view content) //parse content into mapped data
     {
         if(!content.size()) //empty content
             return __priv_save_error_and_return(INIREADER_EXCEPTION_EMPTY);
 
         //remove UTF-8 BOM
         if(content.compare(0, 3, "\xEF\xBB\xBF") == 0)
-            content.erase(0, 3);
+            content.remove_prefix(3);
 
         bool inExcludedSection = false, inDirectSaveSection = false, inIsolatedSection = false;
-        std::string strLine, thisSection, curSection, itemName, itemVal;
+        std::string thisSection, curSection, converted, escaped;
+        std::string_view strLine;
         string_multimap itemGroup;
         string_array read_sections;
-        std::stringstream strStrm;
-        char delimiter = getLineBreak(content);
+        char delimiter = content.find('\n') != content.npos ? '\n' : '\r';
+        string_size line_begin = 0, line_end;
 
         EraseAll(); //first erase all data
-        if(do_utf8_to_gbk && is_str_utf8(content))
-            content = UTF8ToACP(content); //do conversion if flag is set
+        if(do_utf8_to_gbk)
+        {
+            converted.assign(content);
+            if(is_str_utf8(converted))
+            {
+                converted = UTF8ToACP(converted); //do conversion if flag is set
+                content = converted;
+            }
+        }
 
         if(store_isolated_line && isolated_items_section.size())
         {
@@ -231,18 +286,30 @@ public:
             inDirectSaveSection = __priv_chk_direct_save(curSection); //check if this section requires direct-save
             inIsolatedSection = true;
         }
-        strStrm<<content;
         last_error_index = 0; //reset error index
-        while(getline(strStrm, strLine, delimiter)) //get one line of content
+        while(line_begin < content.size()) //get one line of content
         {
+            line_end = content.find(delimiter, line_begin);
+            if(line_end == content.npos)
+                line_end = content.size();
+            strLine = content.substr(line_begin, line_end - line_begin);
+            line_begin = line_end + 1;
+
             last_error_index++;
-            string_size lineSize = strLine.size(), pos_equal = strLine.find("=");
-            if(lineSize && strLine[lineSize - 1] == '\r') //remove line break
-                strLine.erase(--lineSize);
+            if(strLine.size() && strLine.back() == '\r') //remove line break
+                strLine.remove_suffix(1);
+            string_size lineSize = strLine.size();
             if((!lineSize || strLine[0] == ';' || strLine[0] == '#' || (lineSize >= 2 && strLine[0] == '/' && strLine[1] == '/')) && !inDirectSaveSection) //empty lines and comments are ignored
                 continue;
-            ProcessEscapeChar(strLine);
-            if(strLine[0] == '[' && strLine[lineSize - 1] == ']') //is a section title
+            if(strLine.find('\\') != strLine.npos) //only lines with escape characters need a copy
+            {
+                escaped.assign(strLine);
+                ProcessEscapeChar(escaped);
+                strLine = escaped;
+                lineSize = strLine.size();
+            }
+            string_size pos_equal = strLine.find('=');
+            if(lineSize && strLine[0] == '[' && strLine[lineSize - 1] == ']') //is a section title
             {
                 thisSection = strLine.substr(1, lineSize - 2); //save section title
                 inExcludedSection = __priv_chk_ignore(thisSection); //check if this section is excluded
@@ -250,23 +317,19 @@ public:
 
                 if(curSection.size() && (keep_empty_section || itemGroup.size())) //just finished reading a section
                 {
-                    if(ini_content.find(curSection) != ini_content.end()) //a section with the same name has been inserted
+                    auto iter = __priv_find_section(curSection);
+                    if(iter != ini_content.end()) //a section with the same name has been inserted
                     {
-                        if(allow_dup_section_titles || !ini_content.at(curSection).size())
-                        {
-                            auto iter = ini_content.at(curSection); //get the existing section
-                            iter.merge(itemGroup); //move new items to this section
-                        }
-                        else if(ini_content.at(curSection).size())
+                        if(allow_dup_section_titles || !iter->second.size())
+                            iter->second.merge(itemGroup); //move new items to this section
+                        else if(iter->second.size())
                             return __priv_save_error_and_return(INIREADER_EXCEPTION_DUPLICATE); //not allowed, stop
                     }
                     else if(!inIsolatedSection || isolated_items_section != thisSection)
                     {
                         if(itemGroup.size())
                             read_sections.push_back(curSection); //add to read sections list
-                        if(std::find(section_order.cbegin(), section_order.cend(), curSection) == section_order.cend())
-                            section_order.emplace_back(curSection); //add to section order if not added before
-                        ini_content.emplace(std::move(curSection), std::move(itemGroup)); //insert previous section to content map
+                        __priv_add_section(std::move(curSection), std::move(itemGroup)); //insert previous section to content map
                     }
                 }
                 inIsolatedSection = false;
@@ -284,37 +347,33 @@ public:
                 if(!curSection.size()) //not in any section
                     return __priv_save_error_and_return(INIREADER_EXCEPTION_OUTOFBOUND);
                 string_size pos_value = strLine.find_first_not_of(' ', pos_equal + 1);
-                itemName = trim(strLine.substr(0, pos_equal));
+                std::string_view itemName = strLine.substr(0, pos_equal);
+                string_size name_begin = itemName.find_first_not_of(' '), name_end = itemName.find_last_not_of(' ');
+                if(name_begin != itemName.npos)
+                    itemName = itemName.substr(name_begin, name_end - name_begin + 1);
                 if(pos_value != strLine.npos) //not a key with empty value
-                {
-                    itemVal = strLine.substr(pos_value);
-                    itemGroup.emplace(std::move(itemName), std::move(itemVal)); //insert to current section
-                }
+                    itemGroup.emplace(itemName, strLine.substr(pos_value)); //insert to current section
                 else
-                    itemGroup.emplace(std::move(itemName), std::string());
+                    itemGroup.emplace(itemName, std::string());
             }
             if(include_sections.size() && include_sections == read_sections) //all included sections has been read
                 break; //exit now
         }
         if(curSection.size() && (keep_empty_section || itemGroup.size())) //final section
         {
-            if(ini_content.find(curSection) != ini_content.end()) //a section with the same name has been inserted
+            auto iter = __priv_find_section(curSection);
+            if(iter != ini_content.end()) //a section with the same name has been inserted
             {
                 if(allow_dup_section_titles || isolated_items_section == thisSection)
-                {
-                    auto &iter = ini_content.at(curSection); //get the existing section
-                    iter.merge(itemGroup); //move new items to this section
-                }
-                else if(ini_content.at(curSection).size())
+                    iter->second.merge(itemGroup); //move new items to this section
+                else if(iter->second.size())
                     return __priv_save_error_and_return(INIREADER_EXCEPTION_DUPLICATE); //not allowed, stop
             }
             else if(!inIsolatedSection || isolated_items_section != thisSection)
             {
                 if(itemGroup.size())
                     read_sections.emplace_back(curSection); //add to read sections list
-                if(std::find(section_order.cbegin(), section_order.cend(), curSection) == section_order.cend())
-                    section_order.emplace_back(curSection); //add to section order if not added before
-                ini_content.emplace(std::move(curSection), std::move(itemGroup)); //insert this section to content map
+                __priv_add_section(std::move(curSection), std::move(itemGroup)); //insert this section to content map
             }
         }
         parsed = true;
@@ -336,7 +395,7 @@ public:
     */
     bool SectionExist(const std::string &section)
     {
-        return ini_content.find(section) != ini_content.end();
+        return section_index.find(section) != section_index.end();
     }
 
     /**
@@ -363,7 +422,7 @@ public:
         if(!SectionExist(section))
             return __priv_save_error_and_return(INIREADER_EXCEPTION_NOTEXIST);
         current_section = cached_section = section;
-        cached_section_content = ini_content.find(section);
+        cached_section_content = __priv_find_section(section);
         return __priv_save_error_and_return(INIREADER_EXCEPTION_NONE);
     }
 
@@ -383,11 +442,7 @@ public:
         if(!SectionExist(section))
             return false;
 
-        if(section != cached_section)
-        {
-            cached_section = section;
-            cached_section_content = ini_content.find(section);
-        }
+        __priv_cache_section(section);
         auto &cache = cached_section_content->second;
         return cache.find(itemName) != cache.end();
     }
@@ -408,11 +463,7 @@ public:
         if(!SectionExist(section))
             return false;
 
-        if(section != cached_section)
-        {
-            cached_section = section;
-            cached_section_content = ini_content.find(section);
-        }
+        __priv_cache_section(section);
 
         for(auto &x : cached_section_content->second)
         {
@@ -439,7 +490,7 @@ public:
         if(!parsed || !SectionExist(section))
             return __priv_save_error_and_return(INIREADER_EXCEPTION_NOTPARSED);
 
-        return ini_content.at(section).size();
+        return __priv_find_section(section)->second.size();
     }
 
     /**
@@ -447,6 +498,7 @@ public:
     */
     void EraseAll()
     {
+        eraseElements(section_index);
         eraseElements(ini_content);
         eraseElements(section_order);
         cached_section.clear();
@@ -459,11 +511,7 @@ public:
         if(!parsed || !SectionExist(section))
             return ini_content.end();
 
-        if(cached_section != section)
-        {
-            cached_section = section;
-            cached_section_content = ini_content.find(section);
-        }
+        __priv_cache_section(section);
         return cached_section_content;
     }
 
@@ -525,14 +573,10 @@ public:
         if(!parsed || !SectionExist(section))
             return std::string();
 
-        if(cached_section != section)
-        {
-            cached_section = section;
-            cached_section_content = ini_content.find(section);
-        }
+        __priv_cache_section(section);
 
         auto &cache = cached_section_content->second;
-        auto iter = std::find_if(cache.begin(), cache.end(), [&](auto x) { return x.first == itemName; });
+        auto iter = cache.find(itemName);
         if(iter != cache.end())
             return iter->second;
 
@@ -720,18 +764,10 @@ public:
         if(!parsed)
             parsed = true;
 
-        if(SectionExist(section))
-        {
-            string_multimap &mapTemp = ini_content.at(section);
-            mapTemp.insert(std::pair<std::string, std::string>(std::move(itemName), std::move(itemVal)));
-        }
-        else
-        {
-            string_multimap mapTemp;
-            mapTemp.insert(std::pair<std::string, std::string>(std::move(itemName), std::move(itemVal)));
-            ini_content.insert(std::pair<std::string, std::multimap<std::string, std::string>>(section, std::move(mapTemp)));
-            section_order.emplace_back(section);
-        }
+        auto iter = __priv_find_section(section);
+        if(iter == ini_content.end())
+            iter = __priv_add_section(section, string_multimap());
+        iter->second.emplace(std::move(itemName), std::move(itemVal));
 
         return __priv_save_error_and_return(INIREADER_EXCEPTION_NONE);
     }
@@ -804,10 +840,17 @@ public:
     {
         if(!SectionExist(oldName) || SectionExist(newName))
             return __priv_save_error_and_return(INIREADER_EXCEPTION_DUPLICATE);
+        std::replace(section_order.begin(), section_order.end(), oldName, newName);
+        section_index.erase(oldName);
         auto nodeHandler = ini_content.extract(oldName);
         nodeHandler.key() = std::move(newName);
-        ini_content.insert(std::move(nodeHandler));
-        std::replace(section_order.begin(), section_order.end(), oldName, newName);
+        auto iter = ini_content.insert(std::move(nodeHandler)).position;
+        section_index.emplace(iter->first, iter);
+        if(cached_section == oldName)
+        {
+            cached_section.clear();
+            cached_section_content = ini_content.end();
+        }
         return __priv_save_error_and_return(INIREADER_EXCEPTION_NONE);
     }
 
@@ -820,11 +863,7 @@ public:
         if(!SectionExist(section))
             return __priv_save_error_and_return(INIREADER_EXCEPTION_NOTEXIST);
 
-        retVal = ini_content.at(section).erase(itemName);
-        if(retVal && cached_section == section)
-        {
-            cached_section_content = ini_content.find(section);
-        }
+        retVal = __priv_find_section(section)->second.erase(itemName);
         return retVal;
     }
 
@@ -867,9 +906,10 @@ public:
     */
     void EraseSection(const std::string &section)
     {
-        if(ini_content.find(section) == ini_content.end())
+        auto iter = __priv_find_section(section);
+        if(iter == ini_content.end())
             return;
-        eraseElements(ini_content.at(section));
+        eraseElements(iter->second);
         if(cached_section == section)
         {
             cached_section_content = ini_content.end();
@@ -891,9 +931,11 @@ public:
     */
     void RemoveSection(const std::string &section)
     {
-        if(ini_content.find(section) == ini_content.end())
+        auto iter = __priv_find_section(section);
+        if(iter == ini_content.end())
             return;
-        ini_content.erase(section);
+        section_index.erase(section);
+        ini_content.erase(iter);
         if(cached_section == section)
         {
             cached_section.clear();
@@ -925,9 +967,10 @@ public:
         {
             string_size strsize = 0;
             content += "[" + x + "]\n";
-            if(ini_content.find(x) != ini_content.end())
+            auto section_iter = __priv_find_section(x);
+            if(section_iter != ini_content.end())
             {
-                auto section = ini_content.at(x);
+                const string_multimap &section = section_iter->second;
                 if(section.empty())
                 {
                     content += "\n";
@@ -937,11 +980,17 @@ public:
                 {
                     if(iter->first != "{NONAME}")
                         content += iter->first + "=";
-                    itemVal = iter->second;
-                    ProcessEscapeCharReverse(itemVal);
-                    content += itemVal + "\n";
+                    if(iter->second.find_first_of("\r\n\t") != iter->second.npos)
+                    {
+                        itemVal = iter->second;
+                        ProcessEscapeCharReverse(itemVal);
+                        content += itemVal;
+                    }
+                    else
+                        content += iter->second;
+                    content += "\n";
                     if(std::next(iter) == section.end())
-                        strsize = itemVal.size();
+                        strsize = iter->second.size();
                 }
             }
             if(strsize)
@@ -0,0 +1,519 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif // _WIN32
+
+#include "loadtest.h"
+#include "deadline.h"
+#include "logger.h"
+#include "misc.h"
+#include "socket.h"
+
+#ifdef _WIN32
+#define poll WSAPoll
+#endif // _WIN32
+
+using namespace std::chrono;
+
+#define LOAD_LATENCY_FLOOR 50 //milliseconds, a p95 below this never counts as blown up
+
+enum
+{
+    LOAD_STATE_CONNECT,
+    LOAD_STATE_METHOD,
+    LOAD_STATE_AUTH,
+    LOAD_STATE_SOCKS,
+    LOAD_STATE_RESPONSE
+};
+
+struct loadConnection
+{
+    SOCKET s = INVALID_SOCKET;
+    int state = LOAD_STATE_CONNECT;
+    std::string out, in;
+    time_point<steady_clock> started, expires;
+};
+
+struct loadStepStats
+{
+    std::vector<int> latency; //milliseconds of every completed request
+    unsigned int errors[LOAD_ERROR_COUNT] = {};
+};
+
+static bool loadWouldBlock()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+#endif // _WIN32
+}
+
+static bool loadConnectPending()
+{
+#ifdef _WIN32
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EINPROGRESS;
+#endif // _WIN32
+}
+
+//1 with the response length set once a whole response is buffered, 0 when more is needed, -1 when it cannot be read
+static int loadParseResponse(const std::string &in, bool eof, size_t &length, int &status, bool &close)
+{
+    std::string::size_type end = in.find("\r\n\r\n"), pos;
+    if(end == in.npos)
+        return eof || in.size() > 16384 ? -1 : 0;
+    if(end < 12 || !startsWith(in, "HTTP/1."))
+        return -1;
+    status = to_int(in.substr(9, 3), 0);
+    std::string header = toLower(in.substr(0, end));
+    close = header.find("connection: close") != header.npos || (in[7] == '0' && header.find("connection: keep-alive") == header.npos);
+    size_t body = end + 4;
+    if(status / 100 == 1 || status == 204 || status == 304)
+    {
+        length = body;
+        return 1;
+    }
+    if((pos = header.find("content-length:")) != header.npos)
+    {
+        length = body + strtoull(header.data() + pos + 15, NULL, 10);
+        return in.size() >= length ? 1 : (eof ? -1 : 0);
+    }
+    //only small responses are expected here, the first empty chunk is taken as the end
+    if(header.find("transfer-encoding: chunked") != header.npos)
+    {
+        if((pos = in.find("\r\n0\r\n\r\n", end)) == in.npos)
+            return eof ? -1 : 0;
+        length = pos + 7;
+        return 1;
+    }
+    //the body runs until the connection is closed
+    close = true;
+    length = in.size();
+    return eof ? 1 : 0;
+}
+
+//keeps a fixed number of connections busy from a single thread, every finished or failed one is replaced
+class loadEngine
+{
+public:
+    loadEngine(const sockaddr_storage &addr, socklen_t addrlen, bool keepalive, int timeout) : _addr(addr), _addrlen(addrlen), _keepalive(keepalive), _timeout(timeout) {}
+    ~loadEngine()
+    {
+        for(loadConnection &x : _conns)
+            drop(x);
+    }
+    loadEngine(const loadEngine&) = delete;
+    loadEngine& operator=(const loadEngine&) = delete;
+
+    std::string greeting, auth, socks_request, request;
+
+    //new connections are opened by the next run(), kept-alive ones carry over from the last step
+    void resize(size_t count)
+    {
+        _conns.resize(std::max(count, _conns.size()));
+    }
+
+    void run(time_point<steady_clock> until, loadStepStats &stats)
+    {
+        std::vector<pollfd> fds;
+        std::vector<loadConnection*> polled;
+        _stats = &stats;
+        while(true)
+        {
+            auto now = steady_clock::now();
+            if(now >= until)
+                break;
+            fds.clear();
+            polled.clear();
+            for(loadConnection &x : _conns)
+            {
+                if(x.s == INVALID_SOCKET)
+                    open(x);
+                else if(now >= x.expires)
+                {
+                    fail(x, LOAD_ERROR_TIMEOUT);
+                    open(x);
+                }
+                if(x.s == INVALID_SOCKET)
+                    continue;
+                pollfd pfd = {};
+                pfd.fd = x.s;
+                pfd.events = x.state == LOAD_STATE_CONNECT ? POLLOUT : (POLLIN | (x.out.size() ? POLLOUT : 0));
+                fds.push_back(pfd);
+                polled.push_back(&x);
+            }
+            int wait = std::clamp<long long>(duration_cast<milliseconds>(until - now).count(), 1, 100);
+            if(fds.empty()) //every connection failed right away, do not spin on it
+            {
+                sleep(std::min(wait, 10));
+                continue;
+            }
+            if(poll(fds.data(), fds.size(), wait) < 0 && !loadWouldBlock())
+                break;
+            for(size_t i = 0; i < fds.size(); i++)
+            {
+                if(fds[i].revents)
+                    handle(*polled[i], fds[i].revents);
+            }
+        }
+        _stats = nullptr;
+    }
+
+private:
+    std::vector<loadConnection> _conns;
+    sockaddr_storage _addr;
+    socklen_t _addrlen;
+    bool _keepalive;
+    int _timeout;
+    loadStepStats *_stats = nullptr;
+
+    void drop(loadConnection &x)
+    {
+        if(x.s != INVALID_SOCKET)
+            closesocket(x.s);
+        x.s = INVALID_SOCKET;
+        x.out.clear();
+        x.in.clear();
+    }
+
+    void fail(loadConnection &x, int type)
+    {
+        _stats->errors[type]++;
+        drop(x);
+    }
+
+    void restart(loadConnection &x)
+    {
+        x.started = steady_clock::now();
+        x.expires = x.started + milliseconds(_timeout);
+    }
+
+    void open(loadConnection &x)
+    {
+        x.s = initSocket(_addr.ss_family, SOCK_STREAM, IPPROTO_TCP);
+        x.state = LOAD_STATE_CONNECT;
+        restart(x);
+        if(x.s == INVALID_SOCKET || setSocketBlocking(x.s, false) != 0)
+            return fail(x, LOAD_ERROR_CONNECT);
+        if(::connect(x.s, reinterpret_cast<const sockaddr*>(&_addr), _addrlen) == 0)
+            return connected(x);
+        if(!loadConnectPending())
+            fail(x, LOAD_ERROR_CONNECT);
+    }
+
+    void connected(loadConnection &x)
+    {
+        x.state = LOAD_STATE_METHOD;
+        queue(x, greeting);
+    }
+
+    void queue(loadConnection &x, const std::string &data)
+    {
+        x.out += data;
+        flush(x);
+    }
+
+    bool flush(loadConnection &x)
+    {
+        while(x.out.size())
+        {
+            int cur_len = Send(x.s, x.out.data(), x.out.size(), 0);
+            if(cur_len > 0)
+                x.out.erase(0, cur_len);
+            else if(cur_len < 0 && loadWouldBlock())
+                break;
+            else
+            {
+                fail(x, x.state == LOAD_STATE_RESPONSE ? LOAD_ERROR_RESET : LOAD_ERROR_SOCKS);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void handle(loadConnection &x, short revents)
+    {
+        if(x.state == LOAD_STATE_CONNECT)
+        {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if(getsockopt(x.s, SOL_SOCKET, SO_ERROR, reinterpret_cast<char*>(&error), &len) != 0 || error != 0)
+                return fail(x, LOAD_ERROR_CONNECT);
+            return connected(x);
+        }
+        if((revents & POLLOUT) && !flush(x))
+            return;
+        if(!(revents & (POLLIN | POLLHUP | POLLERR)))
+            return;
+        char data[4096];
+        int cur_len = Recv(x.s, data, sizeof(data), 0);
+        if(cur_len < 0 && loadWouldBlock())
+            return;
+        if(cur_len <= 0)
+            return closed(x);
+        x.in.append(data, cur_len);
+        process(x);
+    }
+
+    void closed(loadConnection &x)
+    {
+        size_t length = 0;
+        int status = 0;
+        bool close = true;
+        if(x.state != LOAD_STATE_RESPONSE)
+            return fail(x, LOAD_ERROR_SOCKS);
+        switch(loadParseResponse(x.in, true, length, status, close))
+        {
+        case 1:
+            return finish(x, status, length, true);
+        case -1:
+            if(x.in.size())
+                return fail(x, LOAD_ERROR_HTTP);
+        }
+        fail(x, LOAD_ERROR_RESET);
+    }
+
+    void process(loadConnection &x)
+    {
+        size_t length = 0;
+        int status = 0;
+        bool close = false;
+        const unsigned char *in = reinterpret_cast<const unsigned char*>(x.in.data());
+        switch(x.state)
+        {
+        case LOAD_STATE_METHOD:
+            if(x.in.size() < 2)
+                return;
+            if(in[0] != 5 || (in[1] != 0 && (in[1] != 2 || auth.empty())))
+                return fail(x, LOAD_ERROR_SOCKS);
+            x.state = in[1] == 0 ? LOAD_STATE_SOCKS : LOAD_STATE_AUTH;
+            x.in.erase(0, 2);
+            return queue(x, x.state == LOAD_STATE_SOCKS ? socks_request : auth);
+        case LOAD_STATE_AUTH:
+            if(x.in.size() < 2)
+                return;
+            if(in[1] != 0)
+                return fail(x, LOAD_ERROR_SOCKS);
+            x.state = LOAD_STATE_SOCKS;
+            x.in.erase(0, 2);
+            return queue(x, socks_request);
+        case LOAD_STATE_SOCKS:
+            if(x.in.size() < 5)
+                return;
+            switch(in[3])
+            {
+            case 1:
+                length = 10;
+                break;
+            case 3:
+                length = 7 + in[4];
+                break;
+            case 4:
+                length = 22;
+                break;
+            default:
+                return fail(x, LOAD_ERROR_SOCKS);
+            }
+            if(in[1] != 0)
+                return fail(x, LOAD_ERROR_SOCKS);
+            if(x.in.size() < length)
+                return;
+            x.state = LOAD_STATE_RESPONSE;
+            x.in.erase(0, length);
+            if(_keepalive) //only the requests are timed, the connection is set up once
+                restart(x);
+            return queue(x, request);
+        case LOAD_STATE_RESPONSE:
+            switch(loadParseResponse(x.in, false, length, status, close))
+            {
+            case 1:
+                return finish(x, status, length, close);
+            case -1:
+                return fail(x, LOAD_ERROR_HTTP);
+            }
+        }
+    }
+
+    void finish(loadConnection &x, int status, size_t length, bool close)
+    {
+        if(status >= 400)
+            return fail(x, LOAD_ERROR_HTTP);
+        _stats->latency.push_back(duration_cast<milliseconds>(steady_clock::now() - x.started).count());
+        if(!_keepalive || close)
+            return drop(x);
+        x.in.erase(0, length);
+        restart(x);
+        queue(x, request);
+    }
+};
+
+static std::string loadTestRate(const loadTestResult &result)
+{
+    if(result.knee < 0)
+        return "N/A";
+    char buf[32] = {};
+    snprintf(buf, sizeof(buf), "%0.1f", result.steps[result.knee].rate);
+    return buf;
+}
+
+int loadTestRun(bool keepalive, const std::string &localaddr, int localport, const std::string &username, const std::string &password, const loadTestConfig &config, loadTestResult &result)
+{
+    result = loadTestResult();
+    std::string target = config.target, host, uri;
+    int port = 0;
+    bool useTLS = false;
+    urlParse(target, host, uri, port, useTLS);
+    if(useTLS || host.empty() || host.size() > 255)
+    {
+        writeLog(LOG_TYPE_LOAD, "ERROR: Load test needs a plain HTTP target, '" + config.target + "' cannot be used.");
+        return -1;
+    }
+
+    sockaddr_storage addr = {};
+    socklen_t addrlen = 0;
+    std::string server = isIPv4(localaddr) || isIPv6(localaddr) ? localaddr : hostnameToIPAddr(localaddr);
+    if(isIPv4(server))
+    {
+        sockaddr_in *addr4 = reinterpret_cast<sockaddr_in*>(&addr);
+        addr4->sin_family = AF_INET;
+        addr4->sin_port = htons(localport);
+        inet_pton(AF_INET, server.data(), &addr4->sin_addr);
+        addrlen = sizeof(sockaddr_in);
+    }
+    else if(isIPv6(server))
+    {
+        sockaddr_in6 *addr6 = reinterpret_cast<sockaddr_in6*>(&addr);
+        addr6->sin6_family = AF_INET6;
+        addr6->sin6_port = htons(localport);
+        inet_pton(AF_INET6, server.data(), &addr6->sin6_addr);
+        addrlen = sizeof(sockaddr_in6);
+    }
+    else
+    {
+        writeLog(LOG_TYPE_LOAD, "ERROR: Cannot resolve SOCKS5 server " + localaddr + ".");
+        return -1;
+    }
+
+    loadEngine engine(addr, addrlen, keepalive, config.request_timeout);
+    char buf[512], *ptr = buf;
+    *ptr++ = 5;
+    *ptr++ = 1;
+    *ptr++ = 0;
+    putSocksAddress(&ptr, host, port);
+    engine.socks_request.assign(buf, ptr - buf);
+    if(username.empty())
+        engine.greeting.assign("\x05\x01\x00", 3);
+    else
+    {
+        engine.greeting.assign("\x05\x02\x00\x02", 4);
+        engine.auth = std::string(1, 1) + static_cast<char>(username.size()) + username + static_cast<char>(password.size()) + password;
+    }
+    engine.request = "GET " + uri + " HTTP/1.1\r\n"
+                     "Host: " + host + "\r\n" +
+                     (keepalive ? "" : "Connection: close\r\n") +
+                     "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/72.0.3626.121 Safari/537.36\r\n\r\n";
+
+    const char *mode = keepalive ? "requests" : "connections";
+    int max_concurrency = std::max(config.max_concurrency, 1), baseline = 0;
+    for(int concurrency = 1;; concurrency = std::min(concurrency * 2, max_concurrency))
+    {
+        if(deadlineExpired())
+        {
+            result.stop = "deadline";
+            break;
+        }
+        auto start = steady_clock::now();
+        loadStepStats stats;
+        engine.resize(concurrency);
+        engine.run(std::min(start + milliseconds(config.step_time), deadlineCurrent()), stats);
+        double elapsed = std::max(duration<double>(steady_clock::now() - start).count(), 0.001);
+
+        loadTestStep step;
+        step.concurrency = concurrency;
+        step.completed = stats.latency.size();
+        step.rate = step.completed / elapsed;
+        for(int i = 0; i < LOAD_ERROR_COUNT; i++)
+        {
+            step.failed += stats.errors[i];
+            result.errors[i] += stats.errors[i];
+        }
+        if(stats.latency.size())
+        {
+            std::sort(stats.latency.begin(), stats.latency.end());
+            step.p50 = stats.latency[stats.latency.size() / 2];
+            step.p95 = stats.latency[std::min(stats.latency.size() - 1, stats.latency.size() * 95 / 100)];
+        }
+        result.steps.push_back(step);
+        writeLog(LOG_TYPE_LOAD, [&]{ return std::string(mode) + " at concurrency " + std::to_string(concurrency) + ": " + std::to_string(step.completed) + " completed, " + std::to_string(step.failed) +
+                                            " failed, " + std::to_string(step.rate) + "/s, p50 " + std::to_string(step.p50) + "ms, p95 " + std::to_string(step.p95) + "ms"; }, LOG_LEVEL_VERBOSE);
+
+        if(step.completed == 0 || step.failed > (step.completed + step.failed) * config.max_error_rate)
+        {
+            result.stop = "errors";
+            break;
+        }
+        if(result.steps.size() == 1)
+            baseline = std::max(step.p95, LOAD_LATENCY_FLOOR);
+        else if(step.p95 > baseline * config.max_latency_growth)
+        {
+            result.stop = "latency";
+            break;
+        }
+        if(result.knee < 0 || step.rate > result.steps[result.knee].rate)
+            result.knee = result.steps.size() - 1;
+        if(concurrency >= max_concurrency)
+        {
+            result.stop = "max";
+            break;
+        }
+    }
+    return 0;
+}
+
+std::string loadTestString(const loadTestResult &result)
+{
+    std::string data, errors;
+    if(result.knee < 0)
+        data = "no healthy step";
+    else
+    {
+        const loadTestStep &knee = result.steps[result.knee];
+        data = "knee " + std::to_string(knee.concurrency) + " at " + loadTestRate(result) + "/s p95 " + std::to_string(knee.p95) + "ms";
+    }
+    data += ", stopped by " + (result.stop.size() ? result.stop : std::string("errors"));
+    for(int i = 0; i < LOAD_ERROR_COUNT; i++)
+    {
+        if(result.errors[i])
+            errors += " " + std::string(load_error_names[i]) + " " + std::to_string(result.errors[i]);
+    }
+    return data + ", errors:" + (errors.size() ? errors : std::string(" none"));
+}
+
+int loadTest(nodeInfo &node, const std::string &localaddr, int localport, const std::string &username, const std::string &password, const loadTestConfig &config)
+{
+    loadTestResult connections, requests;
+    node.connRate = node.reqRate = "N/A";
+    node.loadTest.clear();
+    writeLog(LOG_TYPE_LOAD, "Load test started. Target: '" + config.target + "' . Proxy: '" + localaddr + ":" + std::to_string(localport) + "' .");
+    if(loadTestRun(false, localaddr, localport, username, password, config, connections) != 0)
+        return -1;
+    if(!deadlineExpired())
+        loadTestRun(true, localaddr, localport, username, password, config, requests);
+    else
+        requests.stop = "deadline";
+    node.connRate = loadTestRate(connections);
+    node.reqRate = loadTestRate(requests);
+    node.loadTest = "connections: " + loadTestString(connections) + "; requests: " + loadTestString(requests);
+    writeLog(LOG_TYPE_LOAD, "Load test: " + node.loadTest);
+    return 0;
+}
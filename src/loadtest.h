@@ -0,0 +1,61 @@
+#ifndef LOADTEST_H_INCLUDED
+#define LOADTEST_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "nodeinfo.h"
+
+/*
+Load test through the node: many small HTTP requests driven by one poll() loop. The connection mode opens a
+new SOCKS5 connection for every request and closes it afterwards, the request mode sends one request after
+another over keep-alive connections. Concurrency starts at 1 and doubles every step until the error rate or
+the p95 latency blows up, max_concurrency is reached or the node deadline runs out. The knee is the healthy
+step with the highest rate, adding connections beyond it only adds latency.
+*/
+
+enum
+{
+    LOAD_ERROR_CONNECT, //to the local SOCKS5 port
+    LOAD_ERROR_SOCKS, //handshake refused or cut off, usually the node failing to reach the target
+    LOAD_ERROR_TIMEOUT,
+    LOAD_ERROR_RESET, //closed before a full response
+    LOAD_ERROR_HTTP, //unreadable response or a status of 400 and above
+    LOAD_ERROR_COUNT
+};
+
+static const char *const load_error_names[LOAD_ERROR_COUNT] = {"connect", "socks", "timeout", "reset", "http"};
+
+struct loadTestConfig
+{
+    std::string target = "http://www.gstatic.com/generate_204"; //plain HTTP only
+    int max_concurrency = 32;
+    int step_time = 2000; //milliseconds per concurrency step
+    int request_timeout = 5000; //milliseconds
+    double max_error_rate = 0.05;
+    double max_latency_growth = 4.0; //p95 over that of the first step
+};
+
+struct loadTestStep
+{
+    int concurrency = 0;
+    unsigned int completed = 0;
+    unsigned int failed = 0;
+    double rate = 0.0; //completed per second
+    int p50 = 0; //milliseconds
+    int p95 = 0;
+};
+
+struct loadTestResult
+{
+    std::vector<loadTestStep> steps;
+    int knee = -1; //index into steps, -1 when not even the first step was healthy
+    std::string stop; //errors, latency, max, deadline
+    unsigned int errors[LOAD_ERROR_COUNT] = {};
+};
+
+int loadTestRun(bool keepalive, const std::string &localaddr, int localport, const std::string &username, const std::string &password, const loadTestConfig &config, loadTestResult &result);
+std::string loadTestString(const loadTestResult &result);
+int loadTest(nodeInfo &node, const std::string &localaddr, int localport, const std::string &username, const std::string &password, const loadTestConfig &config);
+
+#endif // LOADTEST_H_INCLUDED
@@ -2,6 +2,14 @@
 #include <fstream>
 #include <sstream>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <queue>
+#include <cstdio>
+#include <cstdlib>
+
+#include <zlib.h>
 
 #include "logger.h"
 #include "version.h"
@@ -16,11 +24,64 @@
 #include <sys/stat.h>
 #endif // _WIN32
 
+#define LOG_RING_SIZE 8192 //must be a power of 2
+
 typedef std::lock_guard<std::mutex> guarded_mutex;
 std::mutex logger_mutex;
 
 std::string curtime, result_content;
 std::string resultPath, logPath;
+int log_level = LOG_LEVEL_VERBOSE;
+
+//bounded MPSC queue, producers claim cells with CAS, the writer thread is the only consumer
+struct logEntry
+{
+    int type = LOG_TYPE_INFO;
+    long long tv_sec = 0;
+    long tv_usec = 0;
+    std::string content;
+};
+
+struct logCell
+{
+    std::atomic<size_t> sequence;
+    logEntry entry;
+};
+
+static logCell log_ring[LOG_RING_SIZE];
+static std::atomic<size_t> log_enqueue_pos(0);
+static size_t log_dequeue_pos = 0;
+
+static std::atomic<bool> log_writer_running(false), log_writer_idle(false), log_stopped(false), log_eof(false);
+static std::thread log_writer;
+static std::mutex log_wait_mutex;
+static std::condition_variable log_wait_cv;
+static FILE *log_fp = NULL;
+
+//rotation state, only touched by the writer thread
+static std::string log_basename;
+static long long log_segment_bytes = 0;
+static time_t log_segment_start = 0;
+static int log_segment_index = 0;
+static std::atomic<long long> log_rotate_size(0);
+static std::atomic<int> log_rotate_interval(0), log_keep_segments(0);
+static std::atomic<bool> log_compress(true);
+
+//rotated segments are handed over to a separate thread for compression
+static std::thread log_compressor;
+static std::mutex log_compress_mutex;
+static std::condition_variable log_compress_cv;
+static std::queue<std::pair<std::string, int>> log_compress_queue;
+static bool log_compressor_running = false;
+
+static struct logRingInit
+{
+    logRingInit()
+    {
+        for(size_t i = 0; i < LOG_RING_SIZE; i++)
+            log_ring[i].sequence.store(i, std::memory_order_relaxed);
+    }
+} log_ring_init;
 
 int makeDir(const char *path)
 {
@@ -57,10 +118,264 @@ std::string getTime(int type)
     return std::string(tmpbuf);
 }
 
+static const char *logTypeString(int type)
+{
+    switch(type)
+    {
+    case LOG_TYPE_ERROR:
+        return "[ERROR]";
+    case LOG_TYPE_INFO:
+        return "[INFO]";
+    case LOG_TYPE_RAW:
+        return "[RAW]";
+    case LOG_TYPE_WARN:
+        return "[WARNING]";
+    case LOG_TYPE_GEOIP:
+        return "[GEOIP]";
+    case LOG_TYPE_TCPING:
+        return "[TCPING]";
+    case LOG_TYPE_FILEDL:
+        return "[FILEDL]";
+    case LOG_TYPE_FILEUL:
+        return "[FILEUL]";
+    case LOG_TYPE_RULES:
+        return "[RULES]";
+    case LOG_TYPE_GPING:
+        return "[GPING]";
+    case LOG_TYPE_RENDER:
+        return "[RENDER]";
+    case LOG_TYPE_STUN:
+        return "[STUN]";
+    case LOG_TYPE_LOAD:
+        return "[LOAD]";
+    case LOG_TYPE_PAGE:
+        return "[PAGE]";
+    default:
+        return "[UNKNOWN]";
+    }
+}
+
+//the date part only changes once per second, so keep the last one around
+static void logFormatEntry(const logEntry &entry, std::string &dest)
+{
+    static long long cached_sec = -1;
+    static char cached_prefix[32] = {};
+    char usec[8];
+    if(entry.tv_sec != cached_sec)
+    {
+        time_t lt = entry.tv_sec;
+        cached_sec = entry.tv_sec;
+        strftime(cached_prefix, sizeof(cached_prefix), "%Y/%m/%d %a %H:%M:%S", localtime(&lt));
+    }
+    snprintf(usec, sizeof(usec), ".%.6ld", entry.tv_usec);
+    dest += "[";
+    dest += cached_prefix;
+    dest += usec;
+    dest += "]";
+    dest += logTypeString(entry.type);
+    dest += entry.content;
+    dest += "\n";
+}
+
+static bool logEnqueue(logEntry &entry)
+{
+    size_t pos = log_enqueue_pos.load(std::memory_order_relaxed);
+    logCell *cell;
+    while(true)
+    {
+        cell = &log_ring[pos & (LOG_RING_SIZE - 1)];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if(diff == 0)
+        {
+            if(log_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if(diff < 0) //queue is full
+        {
+            if(!log_writer_running)
+                return false;
+            log_wait_cv.notify_one();
+            std::this_thread::yield();
+            pos = log_enqueue_pos.load(std::memory_order_relaxed);
+        }
+        else
+            pos = log_enqueue_pos.load(std::memory_order_relaxed);
+    }
+    cell->entry = std::move(entry);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+static bool logDequeue(logEntry &entry)
+{
+    logCell *cell = &log_ring[log_dequeue_pos & (LOG_RING_SIZE - 1)];
+    size_t seq = cell->sequence.load(std::memory_order_acquire);
+    if(seq != log_dequeue_pos + 1)
+        return false;
+    entry = std::move(cell->entry);
+    cell->sequence.store(log_dequeue_pos + LOG_RING_SIZE, std::memory_order_release);
+    log_dequeue_pos++;
+    return true;
+}
+
+static void logDrain(std::string &batch)
+{
+    logEntry entry;
+    batch.clear();
+    while(logDequeue(entry))
+        logFormatEntry(entry, batch);
+    if(batch.size() && log_fp)
+    {
+        fwrite(batch.data(), 1, batch.size(), log_fp);
+        fflush(log_fp);
+        log_segment_bytes += batch.size();
+    }
+}
+
+static std::string logSegmentPath(int index)
+{
+    return "logs" PATH_SLASH + log_basename + "." + std::to_string(index) + ".log";
+}
+
+static int logGzipFile(const std::string &source, const std::string &dest)
+{
+    FILE *fp = fopen(source.data(), "rb");
+    if(!fp)
+        return -1;
+    gzFile gz = gzopen(dest.data(), "wb6");
+    if(!gz)
+    {
+        fclose(fp);
+        return -1;
+    }
+    char buffer[65536];
+    size_t len;
+    int retVal = 0;
+    while((len = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+    {
+        if(gzwrite(gz, buffer, len) != (int)len)
+        {
+            retVal = -1;
+            break;
+        }
+    }
+    fclose(fp);
+    if(gzclose(gz) != Z_OK)
+        retVal = -1;
+    return retVal;
+}
+
+static void logPruneSegments(int index)
+{
+    int keep = log_keep_segments;
+    if(keep <= 0 || index - keep < 1)
+        return;
+    std::string expired = logSegmentPath(index - keep);
+    remove(expired.data());
+    remove((expired + ".gz").data());
+}
+
+static void logCompressorRoutine()
+{
+    while(true)
+    {
+        std::pair<std::string, int> segment;
+        {
+            std::unique_lock<std::mutex> lock(log_compress_mutex);
+            log_compress_cv.wait(lock, []{ return !log_compress_queue.empty() || !log_compressor_running; });
+            if(log_compress_queue.empty())
+                break;
+            segment = log_compress_queue.front();
+            log_compress_queue.pop();
+        }
+        if(logGzipFile(segment.first, segment.first + ".gz") == 0)
+            remove(segment.first.data());
+        else
+            remove((segment.first + ".gz").data()); //keep the plain segment if compression failed
+        logPruneSegments(segment.second);
+    }
+}
+
+//called by the writer thread only, so producers never wait for rename or compression
+static void logRotateIfNeeded()
+{
+    long long size_limit = log_rotate_size;
+    int interval = log_rotate_interval;
+    if(!log_fp || log_basename.empty())
+        return;
+    bool by_size = size_limit > 0 && log_segment_bytes >= size_limit;
+    bool by_time = interval > 0 && log_segment_bytes > 0 && time(NULL) - log_segment_start >= interval;
+    if(!by_size && !by_time)
+        return;
+
+    std::string segment = logSegmentPath(++log_segment_index);
+    fclose(log_fp);
+    if(rename(logPath.data(), segment.data()) != 0)
+        segment.clear();
+    log_fp = fopen(logPath.data(), "ab");
+    log_segment_bytes = 0;
+    log_segment_start = time(NULL);
+    if(segment.empty())
+        return;
+
+    logEntry entry;
+    timeval tv;
+    std::string line;
+    gettimeofday(&tv, NULL);
+    entry.tv_sec = tv.tv_sec;
+    entry.tv_usec = tv.tv_usec;
+    entry.content = "Previous log segment saved to " + segment + (log_compress ? ".gz" : "") + " .";
+    logFormatEntry(entry, line);
+    if(log_fp)
+    {
+        fwrite(line.data(), 1, line.size(), log_fp);
+        log_segment_bytes += line.size();
+    }
+
+    if(!log_compress)
+    {
+        logPruneSegments(log_segment_index);
+        return;
+    }
+    guarded_mutex guard(log_compress_mutex);
+    if(!log_compressor_running)
+    {
+        log_compressor_running = true;
+        log_compressor = std::thread(logCompressorRoutine);
+    }
+    log_compress_queue.emplace(segment, log_segment_index);
+    log_compress_cv.notify_one();
+}
+
+static void logWriterRoutine()
+{
+    std::string batch;
+    while(log_writer_running)
+    {
+        logDrain(batch);
+        logRotateIfNeeded();
+        if(batch.empty())
+        {
+            std::unique_lock<std::mutex> lock(log_wait_mutex);
+            log_writer_idle = true;
+            log_wait_cv.wait_for(lock, std::chrono::milliseconds(50));
+            log_writer_idle = false;
+        }
+    }
+    logDrain(batch);
+}
+
 void logInit(bool rpcmode)
 {
     curtime = getTime(1);
+    log_basename = curtime;
     logPath = "logs" PATH_SLASH + curtime + ".log";
+    log_fp = fopen(logPath.data(), "ab");
+    log_segment_start = time(NULL);
+    log_writer_running = true;
+    log_writer = std::thread(logWriterRoutine);
+    atexit(logEOF);
     std::string log_header = "Stair Speedtest " VERSION " started in ";
     if(rpcmode)
         log_header += "GUI mode.";
@@ -69,6 +384,14 @@ void logInit(bool rpcmode)
     writeLog(LOG_TYPE_INFO, log_header);
 }
 
+void logSetRotation(int size_mb, int interval_hours, int keep_segments, bool compress)
+{
+    log_rotate_size = size_mb * 1048576LL;
+    log_rotate_interval = interval_hours * 3600;
+    log_keep_segments = keep_segments;
+    log_compress = compress;
+}
+
 void resultInit()
 {
     curtime = getTime(1);
@@ -77,54 +400,75 @@ void resultInit()
 
 void writeLog(int type, std::string content, int level)
 {
-    guarded_mutex guard(logger_mutex);
-    std::string timestr = "[" + getTime(2) + "]", typestr = "[UNKNOWN]";
-    switch(type)
+    if(!logEnabled(type, level))
+        return;
+    logEntry entry;
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    entry.type = type;
+    entry.tv_sec = tv.tv_sec;
+    entry.tv_usec = tv.tv_usec;
+    entry.content = std::move(content);
+    if(!log_stopped && logEnqueue(entry))
     {
-    case LOG_TYPE_ERROR:
-        typestr = "[ERROR]";
-        break;
-    case LOG_TYPE_INFO:
-        typestr = "[INFO]";
-        break;
-    case LOG_TYPE_RAW:
-        typestr = "[RAW]";
-        break;
-    case LOG_TYPE_WARN:
-        typestr = "[WARNING]";
-        break;
-    case LOG_TYPE_GEOIP:
-        typestr = "[GEOIP]";
-        break;
-    case LOG_TYPE_TCPING:
-        typestr = "[TCPING]";
-        break;
-    case LOG_TYPE_FILEDL:
-        typestr = "[FILEDL]";
-        break;
-    case LOG_TYPE_FILEUL:
-        typestr = "[FILEUL]";
-        break;
-    case LOG_TYPE_RULES:
-        typestr = "[RULES]";
-        break;
-    case LOG_TYPE_GPING:
-        typestr = "[GPING]";
-        break;
-    case LOG_TYPE_RENDER:
-        typestr = "[RENDER]";
-        break;
-    case LOG_TYPE_STUN:
-        typestr = "[STUN]";
+        if(log_writer_idle)
+            log_wait_cv.notify_one();
+        return;
     }
-    content = timestr + typestr + content + "\n";
-    fileWrite(logPath, content, false);
+    //writer is gone, fall back to writing directly
+    if(logPath.empty())
+        return;
+    guarded_mutex guard(logger_mutex);
+    std::string line;
+    logFormatEntry(entry, line);
+    fileWrite(logPath, line, false);
 }
 
 void logEOF()
 {
+    if(log_eof.exchange(true))
+        return;
     writeLog(LOG_TYPE_INFO,"Program terminated.");
+    log_stopped = true;
+    if(log_writer_running)
+    {
+        log_writer_running = false;
+        log_wait_cv.notify_one();
+        if(log_writer.joinable())
+        {
+            if(log_writer.get_id() == std::this_thread::get_id()) //signal landed on the writer itself
+                log_writer.detach();
+            else
+                log_writer.join();
+        }
+    }
+    std::string batch;
+    logDrain(batch); //anything queued before the writer was started
+    if(log_fp)
+    {
+        fclose(log_fp);
+        log_fp = NULL;
+    }
     fileWrite(logPath, "--EOF--", false);
+    {
+        guarded_mutex guard(log_compress_mutex);
+        if(!log_compressor_running)
+            return;
+        log_compressor_running = false;
+    }
+    log_compress_cv.notify_one();
+    if(log_compressor.joinable())
+        log_compressor.join(); //finish pending segments so none is left half-compressed
+}
+
+//the writer thread does not exist in a forked child, its lines go straight to the file
+void logAfterFork()
+{
+    log_eof = true;
+    log_stopped = true;
+    log_writer_running = false;
+    log_fp = NULL; //the parent keeps writing through its own copy
+    log_compressor_running = false;
 }
 
 /*
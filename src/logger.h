@@ -2,6 +2,7 @@
 #define LOGGER_H_INCLUDED
 
 #include <string>
+#include <type_traits>
 
 #include "misc.h"
 
@@ -18,11 +19,14 @@ enum
     LOG_TYPE_GPING,
     LOG_TYPE_RENDER,
     LOG_TYPE_FILEUL,
-    LOG_TYPE_STUN
+    LOG_TYPE_STUN,
+    LOG_TYPE_LOAD,
+    LOG_TYPE_PAGE
 };
 
 enum
 {
+    LOG_LEVEL_AUTO = -1, //derive from log type
     LOG_LEVEL_FATAL,
     LOG_LEVEL_ERROR,
     LOG_LEVEL_WARNING,
@@ -32,13 +36,46 @@ enum
 };
 
 extern std::string resultPath, logPath;
+extern int log_level;
+
+static inline int logTypeLevel(int type)
+{
+    switch(type)
+    {
+    case LOG_TYPE_ERROR:
+        return LOG_LEVEL_ERROR;
+    case LOG_TYPE_WARN:
+        return LOG_LEVEL_WARNING;
+    case LOG_TYPE_RAW:
+        return LOG_LEVEL_DEBUG;
+    default:
+        return LOG_LEVEL_INFO;
+    }
+}
+
+static inline bool logEnabled(int type, int level = LOG_LEVEL_AUTO)
+{
+    if(level == LOG_LEVEL_AUTO)
+        level = logTypeLevel(type);
+    return level <= log_level;
+}
 
 int makeDir(const char *path);
 std::string getTime(int type);
 void logInit(bool rpcmode);
+void logSetRotation(int size_mb, int interval_hours, int keep_segments, bool compress);
 void resultInit();
-void writeLog(int type, std::string content, int level = LOG_LEVEL_VERBOSE);
+void writeLog(int type, std::string content, int level = LOG_LEVEL_AUTO);
 void logEOF();
+void logAfterFork();
+
+//only build the message when it is going to be written, use for logs in hot loops
+template <typename F, typename = typename std::enable_if<std::is_invocable_r<std::string, F>::value>::type>
+void writeLog(int type, F &&builder, int level = LOG_LEVEL_AUTO)
+{
+    if(logEnabled(type, level))
+        writeLog(type, builder(), level);
+}
 
 /*
 void resultInit(bool export_with_maxspeed);
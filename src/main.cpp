@@ -8,6 +8,9 @@
 #include <iomanip>
 #include <algorithm>
 #include <numeric>
+#include <cmath>
+#include <thread>
+#include <csignal>
 
 #ifdef _WIN32
 #include <conio.h>
@@ -29,6 +32,18 @@
 #include "ini_reader.h"
 #include "multithread_test.h"
 #include "nodeinfo.h"
+#include "history.h"
+#include "resultfile.h"
+#include "trace.h"
+#include "affinity.h"
+#include "profile.h"
+#include "daemon.h"
+#include "cluster.h"
+#include "procpool.h"
+#include "resultcache.h"
+#include "deadline.h"
+#include "loadtest.h"
+#include "pageload.h"
 
 using namespace std::chrono;
 
@@ -42,6 +57,7 @@ std::string sub_url;
 bool multilink = false;
 int socksport = 65432;
 std::string socksaddr = "127.0.0.1";
+std::string client_config = "config.json"; //pool processes each write their own
 std::string custom_group;
 std::string pngpath;
 
@@ -64,15 +80,45 @@ std::string speedtest_mode = "all";
 std::string override_conf_port = "";
 std::string export_color_style = "rainbow";
 int def_thread_count = 4;
+int node_timeout = 60;
 bool export_with_maxspeed = false;
 bool export_as_new_style = true;
 bool test_site_ping = true;
 bool test_upload = false;
 bool test_nat_type = true;
+bool test_load = false;
+loadTestConfig load_test_config;
+bool test_page_load = false;
+int page_host_connections = 6;
+std::vector<pageResource> page_resources;
 bool multilink_export_as_one_image = false;
 bool single_test_force_export = false;
 bool verbose = false;
 std::string export_sort_method = "none";
+bool save_history = true;
+double history_regression_threshold = 0.3;
+resultCacheConfig result_cache;
+std::string history_query, history_query_arg;
+std::string result_format = "both";
+std::string convert_format, convert_path;
+std::string cpu_affinity = "none", cpu_affinity_interface;
+socketProfile socket_profile;
+int cpu_affinity_cores = 2;
+bool mirror_download = false;
+std::string mirror_tag, mirror_select = "none";
+int mirror_probe_count = 4, mirror_probe_time = 2000;
+bool tournament_mode = false;
+std::string tournament_top = "10", tournament_score = "speed:1,ping:0.3,loss:0.5";
+int tournament_screen_time = 2;
+testProfile test_profile;
+std::map<std::string, testProfile> test_profiles;
+std::string default_test_profile = "standard", arg_test_profile;
+bool daemon_mode = false;
+daemonConfig daemon_options;
+bool worker_mode = false;
+clusterConfig cluster_config;
+int process_pool = 0, process_timeout = 180;
+extern int connect_timeout;
 
 int avail_status[5] = {0, 0, 0, 0, 0};
 unsigned int node_count = 0;
@@ -86,6 +132,8 @@ bool serve_cache_on_fetch_fail = false, print_debug_info = false;
 int explodeLog(const std::string &log, std::vector<nodeInfo> &nodes);
 int tcping(nodeInfo &node);
 void getTestFile(nodeInfo &node, const std::string &proxy, const std::vector<downloadLink> &downloadFiles, const std::vector<linkMatchRule> &matchRules, const std::string &defaultTestFile);
+void getTestMirrors(nodeInfo &node, const std::vector<downloadLink> &downloadFiles, const std::string &tag);
+void selectTestFile(nodeInfo &node, const std::string &localaddr, int localport, const std::string &username, const std::string &password, const std::vector<downloadLink> &downloadFiles, int probe_count, int probe_time);
 void ssrspeed_webserver_routine(const std::string &listen_address, int listen_port);
 std::string get_nat_type_thru_socks5(const std::string &server, uint16_t port, const std::string &username = "", const std::string &password = "", const std::string &stun_server = "stun.ekiga.net", uint16_t stun_port = 3478);
 
@@ -215,18 +263,18 @@ void clientCheck()
 int runClient(int client)
 {
 #ifdef _WIN32
-    std::string v2core_path = "tools\\clients\\v2ray.exe -config config.json";
-    std::string ssr_libev_path = "tools\\clients\\ssr-local.exe -u -c config.json";
+    std::string v2core_path = "tools\\clients\\v2ray.exe -config " + client_config;
+    std::string ssr_libev_path = "tools\\clients\\ssr-local.exe -u -c " + client_config;
 
     std::string ss_libev_dir = "tools\\clients\\";
-    std::string ss_libev_path = ss_libev_dir + "ss-local.exe -u -c ..\\..\\config.json";
+    std::string ss_libev_path = ss_libev_dir + "ss-local.exe -u -c ..\\..\\" + client_config;
 
     std::string ssr_win_dir = "tools\\clients\\";
     std::string ssr_win_path = ssr_win_dir + "shadowsocksr-win.exe";
     std::string ss_win_dir = "tools\\clients\\";
     std::string ss_win_path = ss_win_dir + "shadowsocks-win.exe";
 
-    std::string trojan_path = "tools\\clients\\trojan.exe -c config.json";
+    std::string trojan_path = "tools\\clients\\trojan.exe -c " + client_config;
 
     switch(client)
     {
@@ -243,7 +291,7 @@ int runClient(int client)
         else
         {
             writeLog(LOG_TYPE_INFO, "Starting up shadowsocksr-win...");
-            fileCopy("config.json", ssr_win_dir + "gui-config.json");
+            fileCopy(client_config, ssr_win_dir + "gui-config.json");
             runProgram(ssr_win_path, "", false);
         }
         break;
@@ -256,7 +304,7 @@ int runClient(int client)
         else
         {
             writeLog(LOG_TYPE_INFO, "Starting up shadowsocks-win...");
-            fileCopy("config.json", ss_win_dir + "gui-config.json");
+            fileCopy(client_config, ss_win_dir + "gui-config.json");
             runProgram(ss_win_path, ss_win_dir, false);
         }
         break;
@@ -266,12 +314,12 @@ int runClient(int client)
         break;
     }
 #else
-    std::string v2core_path = "tools/clients/v2ray -config config.json";
-    std::string ssr_libev_path = "tools/clients/ssr-local -u -c config.json";
-    std::string trojan_path = "tools/clients/trojan -c config.json";
+    std::string v2core_path = "tools/clients/v2ray -config " + client_config;
+    std::string ssr_libev_path = "tools/clients/ssr-local -u -c " + client_config;
+    std::string trojan_path = "tools/clients/trojan -c " + client_config;
 
     std::string ss_libev_dir = "tools/clients/";
-    std::string ss_libev_path = "./ss-local -u -c ../../config.json";
+    std::string ss_libev_path = "./ss-local -u -c ../../" + client_config;
 
     switch(client)
     {
@@ -403,6 +451,11 @@ void readConf(std::string path)
     ini.GetBoolIfExist("test_site_ping", test_site_ping);
     ini.GetBoolIfExist("test_upload", test_upload);
     ini.GetBoolIfExist("test_nat_type", test_nat_type);
+    ini.GetBoolIfExist("test_load", test_load);
+    ini.GetIfExist("load_test_target", load_test_config.target);
+    ini.GetIntIfExist("load_test_max_concurrency", load_test_config.max_concurrency);
+    ini.GetIntIfExist("load_test_step_time", load_test_config.step_time);
+    ini.GetBoolIfExist("test_page_load", test_page_load);
 #ifdef _WIN32
     if(ini.ItemExist("preferred_ss_client"))
     {
@@ -419,6 +472,70 @@ void readConf(std::string path)
 #endif // _WIN32
     ini.GetIfExist("override_conf_port", override_conf_port);
     ini.GetIntIfExist("thread_count", def_thread_count);
+    ini.GetIntIfExist("node_timeout", node_timeout);
+    ini.GetIntIfExist("socks_port", socksport);
+    ini.GetIntIfExist("process_pool", process_pool);
+    ini.GetIntIfExist("process_timeout", process_timeout);
+    if(ini.ItemExist("log_level"))
+    {
+        switch(hash_(ini.Get("log_level")))
+        {
+        case "fatal"_hash:
+            log_level = LOG_LEVEL_FATAL;
+            break;
+        case "error"_hash:
+            log_level = LOG_LEVEL_ERROR;
+            break;
+        case "warning"_hash:
+            log_level = LOG_LEVEL_WARNING;
+            break;
+        case "info"_hash:
+            log_level = LOG_LEVEL_INFO;
+            break;
+        case "debug"_hash:
+            log_level = LOG_LEVEL_DEBUG;
+            break;
+        default:
+            log_level = LOG_LEVEL_VERBOSE;
+        }
+    }
+    if(ini.ItemPrefixExist("log_rotate"))
+    {
+        int rotate_size = 0, rotate_interval = 0, keep_segments = 0;
+        bool compress = true;
+        ini.GetIntIfExist("log_rotate_size", rotate_size);
+        ini.GetIntIfExist("log_rotate_interval", rotate_interval);
+        ini.GetIntIfExist("log_keep_segments", keep_segments);
+        ini.GetBoolIfExist("log_compress", compress);
+        logSetRotation(rotate_size, rotate_interval, keep_segments, compress);
+    }
+    if(!trace_enabled)
+        ini.GetBoolIfExist("enable_trace", trace_enabled);
+    ini.GetBoolIfExist("save_history", save_history);
+    if(ini.ItemExist("history_regression_threshold"))
+        history_regression_threshold = ini.GetNumber<double>("history_regression_threshold");
+    ini.GetIntIfExist("result_cache_age", result_cache.max_age);
+    if(ini.ItemExist("result_cache_runs"))
+        result_cache.min_runs = ini.GetNumber<unsigned int>("result_cache_runs");
+    if(ini.ItemExist("result_cache_variation"))
+        result_cache.max_variation = ini.GetNumber<double>("result_cache_variation");
+    if(ini.ItemExist("socket_profile") && !socketProfilePreset(ini.Get("socket_profile"), socket_profile))
+        writeLog(LOG_TYPE_WARN, "Unknown socket profile '" + ini.Get("socket_profile") + "', using default.");
+    if(ini.ItemExist("socket_rcvbuf"))
+        socket_profile.rcvbuf = ini.GetNumber<int>("socket_rcvbuf") * 1024;
+    if(ini.ItemExist("socket_sndbuf"))
+        socket_profile.sndbuf = ini.GetNumber<int>("socket_sndbuf") * 1024;
+    ini.GetIfExist("socket_congestion", socket_profile.congestion);
+    ini.GetBoolIfExist("socket_nodelay", socket_profile.nodelay);
+    ini.GetBoolIfExist("socket_quickack", socket_profile.quickack);
+    ini.GetIfExist("cpu_affinity", cpu_affinity);
+    ini.GetIntIfExist("cpu_affinity_cores", cpu_affinity_cores);
+    ini.GetIfExist("cpu_affinity_interface", cpu_affinity_interface);
+    ini.GetBoolIfExist("tournament_mode", tournament_mode);
+    ini.GetIfExist("tournament_top", tournament_top);
+    ini.GetIfExist("tournament_score", tournament_score);
+    ini.GetIntIfExist("tournament_screen_time", tournament_screen_time);
+    ini.GetIfExist("test_profile", default_test_profile);
 
     ini.EnterSection("export");
     ini.GetBoolIfExist("export_with_maxspeed", export_with_maxspeed);
@@ -427,6 +544,7 @@ void readConf(std::string path)
     ini.GetBoolIfExist("single_test_force_export", single_test_force_export);
     ini.GetBoolIfExist("export_as_new_style", export_as_new_style);
     ini.GetIfExist("export_color_style", export_color_style);
+    ini.GetIfExist("result_format", result_format);
     if(ini.ItemExist("custom_color_groups"))
     {
         vChild = split(ini.Get("custom_color_groups"), "|");
@@ -466,10 +584,21 @@ void readConf(std::string path)
         for(auto &x : vArray)
         {
             vChild = split(x, "|");
-            if(vChild.size() == 2)
+            if(vChild.size() == 2 || vChild.size() == 3)
             {
                 link.url = vChild[0];
                 link.tag = vChild[1];
+                link.located = false;
+                if(vChild.size() == 3)
+                {
+                    string_array location = split(vChild[2], ",");
+                    link.located = location.size() == 2;
+                    if(link.located)
+                    {
+                        link.latitude = to_number<double>(trim(location[0]));
+                        link.longitude = to_number<double>(trim(location[1]));
+                    }
+                }
                 downloadFiles.push_back(link);
             }
         }
@@ -494,6 +623,11 @@ void readConf(std::string path)
             }
         }
     }
+    ini.GetBoolIfExist("mirror_download", mirror_download);
+    ini.GetIfExist("mirror_tag", mirror_tag);
+    ini.GetIfExist("mirror_select", mirror_select);
+    ini.GetIntIfExist("mirror_probe_count", mirror_probe_count);
+    ini.GetIntIfExist("mirror_probe_time", mirror_probe_time);
     if(export_color_style == "custom")
     {
         colorgroup.swap(custom_color_groups);
@@ -504,10 +638,109 @@ void readConf(std::string path)
     ini.GetBoolIfExist("webserver_mode", webserver_mode);
     ini.GetIfExist("listen_address", listen_address);
     ini.GetIntIfExist("listen_port", listen_port);
+
+    ini.EnterSection("cluster");
+    ini.GetBoolIfExist("worker_mode", worker_mode);
+    if(ini.ItemPrefixExist("worker_url") && cluster_config.workers.empty())
+        ini.GetAll("worker_url", cluster_config.workers);
+    ini.GetIntIfExist("worker_timeout", cluster_config.worker_timeout);
+
+    ini.EnterSection("daemon");
+    ini.GetBoolIfExist("daemon_mode", daemon_mode);
+    eraseElements(daemon_options.links);
+    if(ini.ItemPrefixExist("link"))
+        ini.GetAll("link", daemon_options.links);
+    ini.GetIntIfExist("interval", daemon_options.interval);
+    ini.GetIntIfExist("jitter", daemon_options.jitter);
+    ini.GetIntIfExist("rate_limit", daemon_options.rate_limit);
+    ini.GetIntIfExist("refresh_interval", daemon_options.refresh_interval);
+    ini.GetIntIfExist("history_size", daemon_options.history_size);
+    ini.GetIntIfExist("sweep_interval", daemon_options.sweep_interval);
+    ini.GetIntIfExist("sweep_tcping_count", daemon_options.sweep_tcping_count);
+    ini.GetIntIfExist("sweep_latency_change", daemon_options.sweep_latency_change);
+    ini.GetIntIfExist("sweep_latency_margin", daemon_options.sweep_latency_margin);
+    ini.GetBoolIfExist("sweep_exit_ip", daemon_options.sweep_exit_ip);
+
+    eraseElements(page_resources);
+    if(ini.SectionExist("page"))
+    {
+        ini.EnterSection("page");
+        ini.GetIntIfExist("host_connections", page_host_connections);
+        if(ini.ItemExist("manifest"))
+            pageManifestLoad(ini.Get("manifest"), page_resources);
+        else if(ini.ItemPrefixExist("resource"))
+        {
+            eraseElements(vArray);
+            ini.GetAll("resource", vArray);
+            strTemp.clear();
+            for(auto &x : vArray)
+                strTemp += x + "\n";
+            pageManifestParse(strTemp, page_resources);
+        }
+    }
+
+    //"standard" follows the [advanced] options, every [profile_<name>] section adjusts a preset or a copy of "standard"
+    testProfile standard;
+    standard.speedtest_mode = speedtest_mode;
+    standard.site_ping = test_site_ping;
+    standard.upload = test_upload;
+    standard.nat_type = test_nat_type;
+    standard.load_test = test_load;
+    standard.page_load = test_page_load;
+    standard.download_threads = def_thread_count;
+    standard.connect_timeout = connect_timeout;
+    standard.node_timeout = node_timeout;
+    eraseElements(test_profiles);
+    for(const char *name : {"standard", "quick", "deep"})
+        testProfilePreset(name, standard, test_profiles[name]);
+    for(std::string &x : ini.GetSections())
+    {
+        if(!startsWith(x, "profile_") || x.size() == 8)
+            continue;
+        std::string name = x.substr(8);
+        testProfile &profile = test_profiles[name];
+        if(!testProfilePreset(name, standard, profile))
+            profile.name = name;
+        ini.EnterSection(x);
+        testProfileRead(ini, profile);
+    }
 }
 
-void signalHandler(int signum)
+//copies a profile into the options singleTest() and the probes read
+bool selectTestProfile(const std::string &name)
 {
+    auto iter = test_profiles.find(name);
+    if(iter == test_profiles.end())
+    {
+        writeLog(LOG_TYPE_WARN, "Unknown test profile '" + name + "', keeping '" + test_profile.name + "'.");
+        return false;
+    }
+    test_profile = iter->second;
+    speedtest_mode = test_profile.speedtest_mode;
+    test_site_ping = test_profile.site_ping;
+    test_upload = test_profile.upload;
+    test_nat_type = test_profile.nat_type;
+    test_load = test_profile.load_test;
+    test_page_load = test_profile.page_load;
+    def_thread_count = test_profile.download_threads;
+    connect_timeout = test_profile.connect_timeout;
+    writeLog(LOG_TYPE_INFO, "Using test profile " + testProfileString(test_profile) + ".");
+    return true;
+}
+
+void exportTrace()
+{
+    traceExport(replace_all_distinct(logPath, ".log", ""));
+}
+
+//set by signalHandler, everything that allocates, locks or joins threads happens in exitWatcher instead
+static volatile sig_atomic_t exit_signal = 0;
+
+void exitWatcher()
+{
+    while(!exit_signal)
+        sleep(100);
+    int signum = exit_signal;
     std::cerr << "Interrupt signal (" << signum << ") received.\n";
 
 #ifdef __APPLE__
@@ -518,11 +751,17 @@ void signalHandler(int signum)
 #endif // __APPLE__
     killByHandle();
     writeLog(LOG_TYPE_INFO, "Received signal. Exit right now.");
+    if(trace_enabled)
+        exportTrace();
     logEOF();
-
     exit(signum);
 }
 
+void signalHandler(int signum)
+{
+    exit_signal = signum;
+}
+
 void chkArg(int argc, char* argv[])
 {
     for(int i = 0; i < argc; i++)
@@ -531,10 +770,30 @@ void chkArg(int argc, char* argv[])
             rpcmode = true;
         else if(!strcmp(argv[i], "/web"))
             webserver_mode = true;
+        else if(!strcmp(argv[i], "/daemon"))
+            daemon_mode = true;
+        else if(!strcmp(argv[i], "/worker"))
+            worker_mode = true;
+        else if(!strcmp(argv[i], "/workers") && argc > i + 1)
+            cluster_config.workers = split(argv[++i], ",");
+        else if(!strcmp(argv[i], "/trace"))
+            trace_enabled = true;
         else if(!strcmp(argv[i], "/u") && argc > i + 1)
             sub_url.assign(argv[++i]);
         else if(!strcmp(argv[i], "/g") && argc > i + 1)
             custom_group.assign(argv[++i]);
+        else if(!strcmp(argv[i], "/profile") && argc > i + 1)
+            arg_test_profile.assign(argv[++i]);
+        else if((!strcmp(argv[i], "/history") || !strcmp(argv[i], "/best") || !strcmp(argv[i], "/regress")) && argc > i + 1)
+        {
+            history_query.assign(argv[i] + 1);
+            history_query_arg.assign(argv[++i]);
+        }
+        else if((!strcmp(argv[i], "/tojson") || !strcmp(argv[i], "/toini")) && argc > i + 1)
+        {
+            convert_format.assign(argv[i] + 3);
+            convert_path.assign(argv[++i]);
+        }
     }
 }
 
@@ -553,32 +812,77 @@ void exportHTML()
 
 void saveResult(std::vector<nodeInfo> &nodes)
 {
-    INIReader ini;
-    std::string data;
-
-    ini.SetCurrentSection("Basic");
-    ini.Set("Tester", "Stair Speedtest Reborn " VERSION);
-    ini.Set("GenerationTime", getTime(3));
-
-    for(nodeInfo &x : nodes)
-    {
-        ini.SetCurrentSection(x.group + "^" + x.remarks);
-        ini.Set("AvgPing", x.avgPing);
-        ini.Set("PkLoss", x.pkLoss);
-        ini.Set("SitePing", x.sitePing);
-        ini.Set("AvgSpeed", x.avgSpeed);
-        ini.Set("MaxSpeed", x.maxSpeed);
-        ini.Set("ULSpeed", x.ulSpeed);
-        ini.SetNumber<unsigned long long>("UsedTraffic", x.totalRecvBytes);
-        ini.SetNumber<int>("GroupID", x.groupID);
-        ini.SetNumber<int>("ID", x.id);
-        ini.SetBool("Online", x.online);
-        ini.SetArray("RawPing", ",", x.rawPing);
-        ini.SetArray("RawSitePing", ",", x.rawSitePing);
-        ini.SetArray("RawSpeed", ",", x.rawSpeed);
-    }
-
-    ini.ToFile(resultPath);
+    if(result_format != "binary")
+        fileWrite(resultPath, resultNodesToINI(nodes, "Stair Speedtest Reborn " VERSION, getTime(3)), true);
+    if(result_format == "binary" || result_format == "both")
+        resultFileWrite(replace_all_distinct(resultPath, ".log", ".sst"), nodes, "Stair Speedtest Reborn " VERSION);
+    if(save_history)
+    {
+        historyAppend(nodes);
+        resultCacheStore(nodes, result_cache, speedtest_mode, testProfileString(test_profile));
+    }
+}
+
+int printConvertedResult()
+{
+    resultFileReader reader;
+    if(reader.open(convert_path) != 0)
+    {
+        std::cerr << "\"" << convert_path << "\" is not a valid binary result file." << std::endl;
+        return -1;
+    }
+    std::cout << (convert_format == "json" ? resultFileToJSON(reader) : resultFileToINI(reader)) << std::endl;
+    return 0;
+}
+
+void printHistoryQuery()
+{
+    if(history_query == "history")
+    {
+        std::vector<historyNode> matched;
+        historyFindNodes(history_query_arg, matched);
+        if(matched.empty())
+        {
+            std::cout << "No node in history matches \"" << history_query_arg << "\"." << std::endl;
+            return;
+        }
+        for(historyNode &x : matched)
+        {
+            std::vector<historyRecord> records;
+            historyNodeRecords(x.key, 0, 0, records);
+            std::cout << "[" << historyKeyString(x.key) << "] " << x.group << " - " << x.remarks << " (" << x.identity << ")" << std::endl;
+            for(historyRecord &y : records)
+            {
+                std::cout << "  " << historyTimeString(y.time) << "  Ping: " << y.avg_ping << "ms  Loss: " << y.pk_loss << "%  Site Ping: " << y.site_ping << "ms  Speed: " << speedCalc(y.avg_speed) << "  Max Speed: " << speedCalc(y.max_speed) << "  Upload: " << speedCalc(y.ul_speed) << ((y.flags & HISTORY_FLAG_ONLINE) ? "" : "  (offline)") << std::endl;
+            }
+        }
+    }
+    else if(history_query == "best")
+    {
+        std::vector<historySummary> summaries;
+        if(historyBestNodes(to_int(history_query_arg, 24), 20, summaries) != 0 || summaries.empty())
+        {
+            std::cout << "No results found in the last " << history_query_arg << " hour(s)." << std::endl;
+            return;
+        }
+        for(historySummary &x : summaries)
+        {
+            std::cout << "[" << historyKeyString(x.node.key) << "] " << x.node.group << " - " << x.node.remarks << "  Best Speed: " << speedCalc(x.best.avg_speed) << " @ " << historyTimeString(x.best.time) << "  Avg Speed: " << speedCalc(x.avg_speed) << "  Avg Ping: " << x.avg_ping << "ms  Online: " << x.online_runs << "/" << x.runs << std::endl;
+        }
+    }
+    else if(history_query == "regress")
+    {
+        std::vector<historyRegression> regressions;
+        if(historyRegressions(to_int(history_query_arg, 24), history_regression_threshold, regressions) != 0 || regressions.empty())
+        {
+            std::cout << "No regression found in the last " << history_query_arg << " hour(s)." << std::endl;
+            return;
+        }
+        for(historyRegression &x : regressions)
+        {
+            std::cout << "[" << historyKeyString(x.node.key) << "] " << x.node.group << " - " << x.node.remarks << "  Reason: " << x.reason << "  Speed: " << speedCalc(x.latest.avg_speed) << " (baseline " << speedCalc(x.baseline_speed) << ")  Ping: " << x.latest.avg_ping << "ms (baseline " << x.baseline_ping << "ms) @ " << historyTimeString(x.latest.time) << std::endl;
+        }
+    }
 }
 
 std::string removeEmoji(const std::string &orig_remark)
@@ -597,7 +901,26 @@ std::string removeEmoji(const std::string &orig_remark)
     return remark;
 }
 
-int singleTest(nodeInfo &node)
+//times one step of singleTest() into node.phaseDuration and traces it under the same name
+class nodePhaseScope
+{
+public:
+    nodePhaseScope(nodeInfo &node, int phase, const std::string &args = "") : _node(node), _phase(phase), _trace(node_phase_names[phase], node.id, args), _start(steady_clock::now()) {}
+    ~nodePhaseScope()
+    {
+        _node.phaseDuration[_phase] += duration_cast<milliseconds>(steady_clock::now() - _start).count();
+    }
+private:
+    nodeInfo &_node;
+    int _phase;
+    traceScope _trace;
+    time_point<steady_clock> _start;
+};
+
+#define PHASE_SCOPE(...) nodePhaseScope DO_CONCAT(__phase_scope_,__LINE__) (__VA_ARGS__)
+
+//a screen only runs TCP ping and a short single stream download, see tournamentTest()
+int singleTest(nodeInfo &node, bool screen = false)
 {
     node.remarks = trim(removeEmoji(node.remarks)); //remove all emojis
     int retVal = 0;
@@ -606,12 +929,15 @@ int singleTest(nodeInfo &node)
     node.ulTarget = def_upload_target; //for now only use default
     cur_node_id = node.id;
     std::string id = std::to_string(node.id + (rpcmode ? 0 : 1));
+    TRACE_SCOPE("node", node.id, node.group + " - " + node.remarks);
 
     writeLog(LOG_TYPE_INFO, "Received server. Group: " + node.group + " Name: " + node.remarks);
     defer(printMsg(SPEEDTEST_MESSAGE_GOTRESULT, rpcmode, node.avgSpeed, node.maxSpeed, node.ulSpeed, node.pkLoss, node.avgPing, node.sitePing, node.natType.get());)
     auto start = steady_clock::now();
-    if(node.proxyStr == "LOG") //import from result
+    if(node.proxyStr == "LOG" || node.cachedTime) //import from result or reused from the cache
     {
+        if(node.cachedTime)
+            writeLog(LOG_TYPE_INFO, "Reusing result tested at " + historyTimeString(node.cachedTime) + ".");
         if(!rpcmode)
             printMsg(SPEEDTEST_MESSAGE_GOTSERVER, rpcmode, id, node.group, node.remarks, std::to_string(node_count));
         printMsg(SPEEDTEST_MESSAGE_GOTPING, rpcmode, id, node.avgPing);
@@ -622,6 +948,17 @@ int singleTest(nodeInfo &node)
         return SPEEDTEST_ERROR_NONE;
     }
     defer(auto end = steady_clock::now(); auto lapse = duration_cast<seconds>(end - start); node.duration = lapse.count();)
+    std::fill(std::begin(node.phaseDuration), std::end(node.phaseDuration), 0);
+    affinityScope affinity(node.id); //download threads, GeoIP/NAT tasks and the client process all inherit this core set
+    deadlineScope deadline(test_profile.node_timeout);
+    //whatever is still running for this node is given up at the deadline, so the result output never waits on it
+    defer(
+        node.inboundGeoIP.get(deadlineCurrent(), geoIPInfo());
+        node.outboundGeoIP.get(deadlineCurrent(), geoIPInfo());
+        node.natType.get(deadlineCurrent(), "Unknown");
+        if(deadlineExpired())
+            writeLog(LOG_TYPE_WARN, "Node ran out of its " + std::to_string(test_profile.node_timeout) + "s budget, the remaining phases were cut short.");
+    )
 
     if(node.linkType == SPEEDTEST_MESSAGE_FOUNDSOCKS)
     {
@@ -634,8 +971,12 @@ int singleTest(nodeInfo &node)
     {
         testserver = socksaddr;
         testport = socksport;
-        writeLog(LOG_TYPE_INFO, "Writing config file...");
-        fileWrite("config.json", node.proxyStr, true);
+        {
+            PHASE_SCOPE(node, NODE_PHASE_CONFIG_WRITE);
+            writeLog(LOG_TYPE_INFO, "Writing config file...");
+            fileWrite(client_config, node.proxyStr, true);
+        }
+        PHASE_SCOPE(node, NODE_PHASE_CLIENT_SPAWN);
         if(node.linkType != -1 && avail_status[node.linkType] == 1)
             runClient(node.linkType);
     }
@@ -647,22 +988,28 @@ int singleTest(nodeInfo &node)
 
     if(!rpcmode)
         printMsg(SPEEDTEST_MESSAGE_GOTSERVER, rpcmode, id, node.group, node.remarks, std::to_string(node_count));
-    sleep(1000); /// wait for client startup
+    {
+        PHASE_SCOPE(node, NODE_PHASE_CLIENT_READY);
+        sleep(1000); /// wait for client startup
+    }
     writeLog(LOG_TYPE_INFO, "Now started fetching GeoIP info...");
     printMsg(SPEEDTEST_MESSAGE_STARTGEOIP, rpcmode, id);
-    node.inboundGeoIP.set(std::async(std::launch::async, [node](){ return getGeoIPInfo(node.server, ""); }));
-    node.outboundGeoIP.set(std::async(std::launch::async, [proxy](){ return getGeoIPInfo("", proxy); }));
-    if(test_nat_type)
+    node.inboundGeoIP.set(std::async(std::launch::async, [server = node.server, node_id = node.id, until = deadlineCurrent()](){ deadlineScope deadline(until); TRACE_SCOPE("geoip_inbound", node_id); return getGeoIPInfo(server, ""); }));
+    node.outboundGeoIP.set(std::async(std::launch::async, [proxy, node_id = node.id, until = deadlineCurrent()](){ deadlineScope deadline(until); TRACE_SCOPE("geoip_outbound", node_id); return getGeoIPInfo("", proxy); }));
+    if(test_nat_type && !screen)
     {
         printMsg(SPEEDTEST_MESSAGE_STARTNAT, rpcmode, id);
-        node.natType.set(std::async(std::launch::async, [testserver, testport, username, password](){ return get_nat_type_thru_socks5(testserver, testport, username, password); }));
+        node.natType.set(std::async(std::launch::async, [testserver, testport, username, password, node_id = node.id, until = deadlineCurrent()](){ deadlineScope deadline(until); TRACE_SCOPE("nat", node_id); return get_nat_type_thru_socks5(testserver, testport, username, password); }));
     }
 
     printMsg(SPEEDTEST_MESSAGE_STARTPING, rpcmode, id);
     if(speedtest_mode != "speedonly")
     {
         writeLog(LOG_TYPE_INFO, "Now performing TCP ping...");
-        retVal = tcping(node);
+        {
+            PHASE_SCOPE(node, NODE_PHASE_TCPING);
+            retVal = tcping(node);
+        }
         if(retVal == SPEEDTEST_ERROR_NORESOLVE)
         {
             writeLog(LOG_TYPE_ERROR, "Node address resolve error.");
@@ -684,9 +1031,14 @@ int singleTest(nodeInfo &node)
     printMsg(SPEEDTEST_MESSAGE_GOTPING, rpcmode, id, node.avgPing, node.pkLoss);
 
     getTestFile(node, proxy, downloadFiles, matchRules, def_test_file);
+    node.mirrorProbe.clear();
     if(!webserver_mode)
     {
-        geoIPInfo outbound = node.outboundGeoIP.get();
+        geoIPInfo outbound;
+        {
+            PHASE_SCOPE(node, NODE_PHASE_GEOIP_WAIT);
+            outbound = node.outboundGeoIP.get(deadlineCurrent(), geoIPInfo());
+        }
         if(outbound.organization.size())
         {
             writeLog(LOG_TYPE_INFO, "Got outbound ISP: " + outbound.organization + "  Country code: " + outbound.country_code);
@@ -694,12 +1046,16 @@ int singleTest(nodeInfo &node)
         }
         else
             printMsg(SPEEDTEST_ERROR_GEOIPERR, rpcmode, id);
-        if(test_nat_type)
-            printMsg(SPEEDTEST_MESSAGE_GOTNAT, rpcmode, id, node.natType.get());
+        if(test_nat_type && !screen)
+        {
+            PHASE_SCOPE(node, NODE_PHASE_NAT_WAIT);
+            printMsg(SPEEDTEST_MESSAGE_GOTNAT, rpcmode, id, node.natType.get(deadlineCurrent(), "Unknown"));
+        }
     }
 
-    if(test_site_ping)
+    if(test_site_ping && !screen)
     {
+        PHASE_SCOPE(node, NODE_PHASE_SITE_PING);
         printMsg(SPEEDTEST_MESSAGE_STARTGPING, rpcmode, id);
         writeLog(LOG_TYPE_INFO, "Now performing site ping...");
         //websitePing(node, "https://www.google.com/", testserver, testport, username, password);
@@ -712,47 +1068,237 @@ int singleTest(nodeInfo &node)
 
     printMsg(SPEEDTEST_MESSAGE_STARTSPEED, rpcmode, id);
     //node.total_recv_bytes = 1;
+    if(speedtest_mode != "pingonly" && mirror_select == "probe" && !screen)
+    {
+        PHASE_SCOPE(node, NODE_PHASE_MIRROR_PROBE);
+        selectTestFile(node, testserver, testport, username, password, downloadFiles, mirror_probe_count, mirror_probe_time);
+    }
+    if(mirror_download && !screen)
+        getTestMirrors(node, downloadFiles, mirror_tag);
     if(speedtest_mode != "pingonly")
     {
-        writeLog(LOG_TYPE_INFO, "Now performing file download speed test...");
-        perform_test(node, testserver, testport, username, password, def_thread_count);
+        PHASE_SCOPE(node, NODE_PHASE_DOWNLOAD, node.testFile);
+        int thread_count = screen ? 1 : def_thread_count, duration = screen ? tournament_screen_time : test_profile.download_time;
+        writeLog(LOG_TYPE_INFO, screen ? "Now performing screen download test..." : "Now performing file download speed test...");
+        perform_test(node, testserver, testport, username, password, thread_count, duration);
         logdata = std::accumulate(std::next(std::begin(node.rawSpeed)), std::end(node.rawSpeed), std::to_string(node.rawSpeed[0]), [](std::string a, int b){return std::move(a) + " " + std::to_string(b);});
         writeLog(LOG_TYPE_RAW, logdata);
-        if(node.totalRecvBytes == 0)
+        if(node.totalRecvBytes == 0 && screen)
+        {
+            writeLog(LOG_TYPE_ERROR, "Screen download returned no speed.");
+            printMsg(SPEEDTEST_ERROR_NOSPEED, rpcmode, id);
+            printMsg(SPEEDTEST_MESSAGE_GOTSPEED, rpcmode, id, node.avgSpeed, node.maxSpeed);
+            return SPEEDTEST_ERROR_NOSPEED;
+        }
+        if(node.totalRecvBytes == 0 && !deadlineExpired())
         {
             writeLog(LOG_TYPE_ERROR, "Speedtest returned no speed.");
             printMsg(SPEEDTEST_ERROR_RETEST, rpcmode, id);
-            perform_test(node, testserver, testport, username, password, def_thread_count);
+            perform_test(node, testserver, testport, username, password, thread_count, duration);
             logdata = std::accumulate(std::next(std::begin(node.rawSpeed)), std::end(node.rawSpeed), std::to_string(node.rawSpeed[0]), [](std::string a, int b){return std::move(a) + " " + std::to_string(b);});
             writeLog(LOG_TYPE_RAW, logdata);
-            if(node.totalRecvBytes == 0)
-            {
-                writeLog(LOG_TYPE_ERROR, "Speedtest returned no speed 2 times.");
-                printMsg(SPEEDTEST_ERROR_NOSPEED, rpcmode, id);
-                printMsg(SPEEDTEST_MESSAGE_GOTSPEED, rpcmode, id, node.avgSpeed, node.maxSpeed);
-                return SPEEDTEST_ERROR_NOSPEED;
-            }
+        }
+        //no time left for a retest is still no speed
+        if(node.totalRecvBytes == 0)
+        {
+            writeLog(LOG_TYPE_ERROR, "Speedtest returned no speed, giving up.");
+            printMsg(SPEEDTEST_ERROR_NOSPEED, rpcmode, id);
+            printMsg(SPEEDTEST_MESSAGE_GOTSPEED, rpcmode, id, node.avgSpeed, node.maxSpeed);
+            return SPEEDTEST_ERROR_NOSPEED;
         }
     }
     printMsg(SPEEDTEST_MESSAGE_GOTSPEED, rpcmode, id, node.avgSpeed, node.maxSpeed);
-    if(test_upload)
+    if(test_upload && !screen && !deadlineExpired())
     {
+        PHASE_SCOPE(node, NODE_PHASE_UPLOAD, node.ulTarget);
         writeLog(LOG_TYPE_INFO, "Now performing upload speed test...");
         printMsg(SPEEDTEST_MESSAGE_STARTUPD, rpcmode, id);
         upload_test(node, testserver, testport, username, password);
         printMsg(SPEEDTEST_MESSAGE_GOTUPD, rpcmode, id, node.ulSpeed);
     }
+    if(test_load && !screen && !deadlineExpired())
+    {
+        PHASE_SCOPE(node, NODE_PHASE_LOAD_TEST, load_test_config.target);
+        writeLog(LOG_TYPE_INFO, "Now performing load test...");
+        loadTestConfig config = load_test_config;
+        config.request_timeout = test_profile.socket_timeout;
+        loadTest(node, testserver, testport, username, password, config);
+        writeLog(LOG_TYPE_INFO, "Connection rate: " + node.connRate + "/s  Request rate: " + node.reqRate + "/s");
+    }
+    if(test_page_load && page_resources.size() && !screen && !deadlineExpired())
+    {
+        PHASE_SCOPE(node, NODE_PHASE_PAGE_LOAD, page_resources[0].url);
+        writeLog(LOG_TYPE_INFO, "Now performing page load simulation...");
+        pageLoadTest(node, proxy, page_resources, page_host_connections);
+        writeLog(LOG_TYPE_INFO, "Page load: " + (node.pageLoad == "N/A" ? node.pageLoad : node.pageLoad + "ms") + "  " + node.pageLoadPath);
+    }
     writeLog(LOG_TYPE_INFO, "Average speed: " + node.avgSpeed + "  Max speed: " + node.maxSpeed + "  Upload speed: " + node.ulSpeed + "  Traffic used in bytes: " + std::to_string(node.totalRecvBytes));
     node.online = true;
     sleep(300);
     return SPEEDTEST_ERROR_NONE;
 }
 
+//cheap check of the daemon between two full tests, exit_ip is only fetched when given
+int sweepTest(nodeInfo &node, int tcping_count, std::string *exit_ip)
+{
+    std::string testserver, username, password, proxy;
+    int testport, retVal;
+    cur_node_id = node.id;
+    TRACE_SCOPE("sweep", node.id, node.group + " - " + node.remarks);
+    testProfile saved = test_profile;
+    defer(test_profile = saved;)
+    test_profile.tcping_count = std::clamp(tcping_count, 1, 6);
+    test_profile.site_ping_count = test_profile.site_ping_fail_limit = 1;
+    deadlineScope deadline(test_profile.node_timeout);
+
+    writeLog(LOG_TYPE_INFO, "Sweeping server. Group: " + node.group + " Name: " + node.remarks);
+    retVal = tcping(node);
+    if(retVal == SPEEDTEST_ERROR_NORESOLVE)
+        return SPEEDTEST_ERROR_NORESOLVE;
+    if(node.pkLoss == "100.00%")
+        return SPEEDTEST_ERROR_NOCONNECTION;
+
+    if(node.linkType == SPEEDTEST_MESSAGE_FOUNDSOCKS)
+    {
+        testserver = node.server;
+        testport = node.port;
+        username = getUrlArg(node.proxyStr, "user");
+        password = getUrlArg(node.proxyStr, "pass");
+    }
+    else
+    {
+        testserver = socksaddr;
+        testport = socksport;
+        fileWrite(client_config, node.proxyStr, true);
+        if(node.linkType != -1 && avail_status[node.linkType] == 1)
+            runClient(node.linkType);
+    }
+#ifdef __APPLE__
+    defer(killClient(node.linkType);)
+#endif // __APPLE__
+    defer(killByHandle();)
+    proxy = buildSocks5ProxyString(testserver, testport, username, password);
+    sleep(1000); /// wait for client startup
+
+    sitePing(node, testserver, testport, username, password, "http://www.google.com");
+    if(exit_ip)
+        *exit_ip = getGeoIPInfo("", proxy).ip;
+    writeLog(LOG_TYPE_INFO, "Sweep result: TCP Ping: " + node.avgPing + "  Packet Loss: " + node.pkLoss + "  Site ping: " + node.sitePing + (exit_ip ? "  Exit address: " + *exit_ip : ""));
+    return SPEEDTEST_ERROR_NONE;
+}
+
+//every term is scaled to 0..1 against the screened nodes, so the weights alone decide how much each one counts
+static std::vector<double> tournamentScores(const std::vector<nodeInfo> &nodes, const std::string &weights)
+{
+    double weight_speed = 0.0, weight_ping = 0.0, weight_loss = 0.0, min_ping = 0.0;
+    unsigned long long max_traffic = 0;
+    for(std::string &x : split(weights, ","))
+    {
+        string_array term = split(x, ":");
+        double weight = term.size() == 2 ? to_number<double>(trim(term[1])) : 1.0;
+        switch(hash_(trim(term[0])))
+        {
+        case "speed"_hash:
+            weight_speed = weight;
+            break;
+        case "ping"_hash:
+            weight_ping = weight;
+            break;
+        case "loss"_hash:
+            weight_loss = weight;
+            break;
+        default:
+            writeLog(LOG_TYPE_WARN, "Unknown tournament score term '" + term[0] + "'.");
+        }
+    }
+    for(const nodeInfo &x : nodes)
+    {
+        double ping = to_number<double>(x.avgPing);
+        max_traffic = std::max(max_traffic, x.screenTraffic);
+        if(ping > 0.0 && (min_ping == 0.0 || ping < min_ping))
+            min_ping = ping;
+    }
+    std::vector<double> scores;
+    for(const nodeInfo &x : nodes)
+    {
+        double ping = to_number<double>(x.avgPing), loss = to_number<double>(replace_all_distinct(x.pkLoss, "%", ""));
+        double score = weight_speed * (max_traffic ? (double)x.screenTraffic / max_traffic : 0.0);
+        score += weight_ping * (ping > 0.0 ? min_ping / ping : 0.0);
+        score += weight_loss * (1.0 - loss / 100.0);
+        scores.push_back(score);
+    }
+    return scores;
+}
+
+//stage one screens every node, stage two runs the full test only on the best ranked ones
+void tournamentTest(std::vector<nodeInfo> &nodes)
+{
+    size_t finalists = 0;
+    if(endsWith(tournament_top, "%"))
+        finalists = ceil(nodes.size() * to_number<double>(tournament_top.substr(0, tournament_top.size() - 1)) / 100.0);
+    else
+        finalists = std::max(to_int(tournament_top, 0), 0);
+    finalists = std::min(finalists, nodes.size());
+
+    writeLog(LOG_TYPE_INFO, "Tournament stage 1: screening " + std::to_string(nodes.size()) + " node(s) with a " + std::to_string(tournament_screen_time) + "s single stream download.");
+    for(auto &x : nodes)
+    {
+        singleTest(x, true);
+        x.screenOnly = true;
+        x.screenSpeed = x.avgSpeed;
+        x.screenPing = x.avgPing;
+        x.screenTraffic = x.totalRecvBytes;
+    }
+
+    std::vector<double> scores = tournamentScores(nodes, tournament_score);
+    std::vector<size_t> order;
+    for(size_t i = 0; i < nodes.size(); i++)
+    {
+        nodes[i].screenScore = scores[i];
+        if(nodes[i].online)
+            order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return scores[a] > scores[b]; });
+    if(order.size() > finalists)
+        order.resize(finalists);
+
+    writeLog(LOG_TYPE_INFO, "Tournament stage 2: full test on " + std::to_string(order.size()) + " of " + std::to_string(nodes.size()) + " node(s).");
+    std::vector<nodeInfo> finalists_nodes;
+    for(size_t i : order)
+    {
+        nodeInfo &x = nodes[i];
+        writeLog(LOG_TYPE_INFO, "Finalist " + x.group + " - " + x.remarks + " score " + std::to_string(x.screenScore) + ".");
+        x.screenOnly = false;
+        finalists_nodes.push_back(x);
+    }
+    //the full tests go through the same dispatch as a batch without a tournament
+    if(cluster_config.workers.size())
+        clusterTest(finalists_nodes, cluster_config);
+    else if(process_pool > 0)
+        processPoolTest(finalists_nodes, process_pool, process_timeout);
+    else
+    {
+        for(nodeInfo &x : finalists_nodes)
+            singleTest(x);
+    }
+    //workers do not know about the screen, its results stay those of stage one
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        nodeInfo &x = nodes[order[i]], &y = finalists_nodes[i];
+        y.screenOnly = false;
+        y.screenSpeed = x.screenSpeed;
+        y.screenPing = x.screenPing;
+        y.screenTraffic = x.screenTraffic;
+        y.screenScore = x.screenScore;
+        x = std::move(y);
+    }
+}
+
 void batchTest(std::vector<nodeInfo> &nodes)
 {
     nodeInfo node;
     unsigned int onlines = 0;
-    long long tottraffic = 0;
+    long long tottraffic = 0, totphase[NODE_PHASE_COUNT] = {};
     cur_node_id = -1;
 
     writeLog(LOG_TYPE_INFO, "Total node(s) found: " + std::to_string(node_count));
@@ -772,23 +1318,62 @@ void batchTest(std::vector<nodeInfo> &nodes)
             for(nodeInfo &x : nodes)
                 printMsg(SPEEDTEST_MESSAGE_GOTSERVER, rpcmode, std::to_string(x.id), x.group, x.remarks);
         }
-        //then we start testing nodes
+        if(save_history) //stability is judged from the history store
+            resultCacheApply(nodes, result_cache, speedtest_mode, testProfileString(test_profile));
+        //then we start testing nodes, reused ones only print their result
         for(auto &x : nodes)
         {
             if(custom_group.size() != 0)
                 x.group = custom_group;
-            singleTest(x);
+            if(x.cachedTime || (!tournament_mode && cluster_config.workers.empty() && process_pool <= 0))
+                singleTest(x);
+        }
+        if(tournament_mode || cluster_config.workers.size() || process_pool > 0)
+        {
+            std::vector<nodeInfo> retest;
+            std::vector<size_t> retest_index;
+            for(size_t i = 0; i < nodes.size(); i++)
+            {
+                if(nodes[i].cachedTime)
+                    continue;
+                retest.push_back(nodes[i]);
+                retest_index.push_back(i);
+            }
+            if(tournament_mode)
+                tournamentTest(retest);
+            else if(cluster_config.workers.size())
+                clusterTest(retest, cluster_config);
+            else
+                processPoolTest(retest, process_pool, process_timeout);
+            for(size_t i = 0; i < retest.size(); i++)
+                nodes[retest_index[i]] = std::move(retest[i]);
+        }
+        for(auto &x : nodes)
+        {
             //writeResult(&x, export_with_maxspeed);
-            tottraffic += x.totalRecvBytes;
+            if(x.cachedTime)
+            {
+                if(x.online)
+                    onlines++;
+                continue;
+            }
+            tottraffic += x.totalRecvBytes + (x.screenOnly ? 0 : x.screenTraffic);
+            for(int i = 0; i < NODE_PHASE_COUNT; i++)
+                totphase[i] += x.phaseDuration[i];
             if(x.online)
                 onlines++;
         }
         //resultEOF(speedCalc(tottraffic * 1.0), onlines, nodes->size());
         writeLog(LOG_TYPE_INFO, "All nodes tested. Total/Online nodes: " + std::to_string(node_count) + "/" + std::to_string(onlines) + " Traffic used: " + speedCalc(tottraffic * 1.0));
+        std::string phasedata = "Time spent per phase:";
+        for(int i = 0; i < NODE_PHASE_COUNT; i++)
+            phasedata += std::string(" ") + node_phase_names[i] + "=" + std::to_string(totphase[i]) + "ms";
+        writeLog(LOG_TYPE_INFO, phasedata);
         //exportHTML();
         saveResult(nodes);
         if(webserver_mode || !multilink)
         {
+            TRACE_SCOPE("render");
             printMsg(SPEEDTEST_MESSAGE_PICSAVING, rpcmode);
             writeLog(LOG_TYPE_INFO, "Now exporting result...");
             pngpath = exportRender(resultPath, nodes, export_with_maxspeed, export_sort_method, export_color_style, export_as_new_style, test_nat_type);
@@ -893,7 +1478,7 @@ void addNodes(std::string link, bool multilink)
         break;
     case SPEEDTEST_MESSAGE_FOUNDLOCAL:
         printMsg(SPEEDTEST_MESSAGE_FOUNDLOCAL, rpcmode);
-        if(!rpcmode && !multilink && !sub_url.size())
+        if(!rpcmode && !multilink && !webserver_mode && !sub_url.size())
         {
             printMsg(SPEEDTEST_MESSAGE_GROUP, rpcmode);
             getline(std::cin, strInput);
@@ -906,7 +1491,7 @@ void addNodes(std::string link, bool multilink)
         writeLog(LOG_TYPE_INFO, "Parsing configuration file data...");
         printMsg(SPEEDTEST_MESSAGE_PARSING, rpcmode);
 
-        if(explodeLog(fileGet(link), nodes) == -1)
+        if(explodeResultFile(link, nodes) == -1 && explodeLog(fileGet(link), nodes) == -1)
         {
             if(explodeConf(link, override_conf_port, ss_libev, ssr_libev, nodes) == SPEEDTEST_ERROR_UNRECOGFILE)
             {
@@ -990,6 +1575,7 @@ void setcd(std::string &file)
     chdir(path.data());
 }
 
+#ifndef STAIRSPEEDTEST_BENCH
 int main(int argc, char* argv[])
 {
     std::vector<nodeInfo> nodes;
@@ -1009,6 +1595,26 @@ int main(int argc, char* argv[])
     makeDir("results");
     logInit(rpcmode);
     readConf("pref.ini");
+    if(!selectTestProfile(arg_test_profile.size() ? arg_test_profile : default_test_profile))
+        selectTestProfile("standard");
+    if(history_query.size())
+    {
+        printHistoryQuery();
+        logEOF();
+        return 0;
+    }
+    if(convert_format.size())
+    {
+        int retVal = printConvertedResult();
+        logEOF();
+        return retVal;
+    }
+    if(trace_enabled)
+    {
+        traceInit();
+        atexit(exportTrace);
+    }
+    affinityInit(cpu_affinity, cpu_affinity_cores, cpu_affinity_interface);
 #ifdef _WIN32
     //start up windows socket library first
     WSADATA wsd;
@@ -1028,6 +1634,7 @@ int main(int argc, char* argv[])
 #endif // _WIN32
     signal(SIGTERM, signalHandler);
     signal(SIGINT, signalHandler);
+    std::thread(exitWatcher).detach();
 
     if(!rpcmode)
         SetConsoleTitle("Stair Speedtest Reborn " VERSION);
@@ -1043,6 +1650,20 @@ int main(int argc, char* argv[])
     socksport = checkPort(socksport);
     writeLog(LOG_TYPE_INFO, "Using local port: " + std::to_string(socksport));
     writeLog(LOG_TYPE_INFO, "Init completed.");
+    if(worker_mode)
+        webserver_mode = true;
+    //the daemon runs behind the web server, addNodes() never asks for a group name while webserver_mode is set
+    if(daemon_mode)
+    {
+        if(sub_url.size())
+            daemon_options.links.push_back(sub_url);
+        webserver_mode = true;
+        if(daemonStart(daemon_options) != 0)
+        {
+            logEOF();
+            return -1;
+        }
+    }
     //intro message
     if(webserver_mode)
     {
@@ -1064,8 +1685,10 @@ int main(int argc, char* argv[])
         if(rpcmode)
         {
             string_array webargs = split(link, "^");
-            if(webargs.size() == 6)
+            if(webargs.size() == 6 || webargs.size() == 7)
             {
+                if(webargs.size() == 7) //profile first, the mode given next to it still applies
+                    selectTestProfile(webargs[6]);
                 link = webargs[0];
                 if(webargs[1] != "?empty?")
                     custom_group = webargs[1];
@@ -1104,6 +1727,7 @@ int main(int argc, char* argv[])
         {
             if(multilink_export_as_one_image)
             {
+                TRACE_SCOPE("render");
                 printMsg(SPEEDTEST_MESSAGE_PICSAVING, rpcmode);
                 writeLog(LOG_TYPE_INFO, "Now exporting result...");
                 curPNGPath = replace_all_distinct(resultPath, ".log", "") + "-multilink-all.png";
@@ -1125,6 +1749,7 @@ int main(int argc, char* argv[])
                         break;
                     if((nodes.size() == 1 && single_test_force_export) || nodes.size() > 1)
                     {
+                        TRACE_SCOPE("render");
                         printMsg(SPEEDTEST_MESSAGE_PICSAVINGMULTI, rpcmode, std::to_string(i + 1));
                         writeLog(LOG_TYPE_INFO, "Now exporting result for group " + std::to_string(i + 1) + "...");
                         curPNGPath = curPNGPathPrefix + "-multilink-group" + std::to_string(i + 1) + ".png";
@@ -1144,8 +1769,11 @@ int main(int argc, char* argv[])
         writeLog(LOG_TYPE_INFO, "Speedtest will now begin.");
         printMsg(SPEEDTEST_MESSAGE_BEGIN, rpcmode);
         singleTest(allNodes[0]);
+        if(save_history)
+            historyAppend(allNodes);
         if(single_test_force_export)
         {
+            TRACE_SCOPE("render");
             printMsg(SPEEDTEST_MESSAGE_PICSAVING, rpcmode);
             writeLog(LOG_TYPE_INFO, "Now exporting result...");
             curPNGPath = "results" PATH_SLASH + getTime(1) + ".png";
@@ -1162,6 +1790,8 @@ int main(int argc, char* argv[])
         writeLog(LOG_TYPE_ERROR, "No valid link found.");
         printMsg(SPEEDTEST_ERROR_NORECOGLINK, rpcmode);
     }
+    if(trace_enabled)
+        exportTrace();
     logEOF();
     printMsg(SPEEDTEST_MESSAGE_EOF, rpcmode);
     sleep(1);
@@ -1177,3 +1807,4 @@ int main(int argc, char* argv[])
 #endif // _WIN32
     return 0;
 }
+#endif // STAIRSPEEDTEST_BENCH
@@ -1,4 +1,5 @@
 #include <chrono>
+#include <random>
 #include <fstream>
 #include <thread>
 #include <sstream>
@@ -967,27 +968,95 @@ bool isIPv6(const std::string &address)
     return false;
 }
 
-std::string rand_str(const int len)
+//xoshiro256** with one state per thread, seeded through splitmix64
+struct rand_state
 {
-    std::string retData;
-    srand(time(NULL));
-    int cnt = 0;
-    while(cnt < len)
+    uint64_t s[4];
+
+    static inline uint64_t splitmix64(uint64_t &x)
     {
-        switch((rand() % 3))
-        {
-        case 1:
-            retData += ('A' + rand() % 26);
-            break;
-        case 2:
-            retData += ('a' + rand() % 26);
-            break;
-        default:
-            retData += ('0' + rand() % 10);
-            break;
-        }
-        cnt++;
+        uint64_t z = (x += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    static inline uint64_t rotl(uint64_t x, int k)
+    {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    rand_state()
+    {
+        std::random_device rd;
+        uint64_t seed = ((uint64_t)rd() << 32) ^ rd();
+        seed ^= std::chrono::steady_clock::now().time_since_epoch().count();
+        seed ^= std::hash<std::thread::id>()(std::this_thread::get_id());
+        for(uint64_t &x : s)
+            x = splitmix64(seed);
+    }
+
+    inline uint64_t next()
+    {
+        uint64_t result = rotl(s[1] * 5, 7) * 9, t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
     }
+};
+
+static inline rand_state &get_rand_state()
+{
+    static thread_local rand_state state;
+    return state;
+}
+
+uint64_t rand_u64()
+{
+    return get_rand_state().next();
+}
+
+void rand_fill(void *buf, size_t len)
+{
+    rand_state &state = get_rand_state();
+    unsigned char *data = static_cast<unsigned char*>(buf);
+    uint64_t value;
+    while(len >= sizeof(value))
+    {
+        value = state.next();
+        memcpy(data, &value, sizeof(value));
+        data += sizeof(value);
+        len -= sizeof(value);
+    }
+    if(len)
+    {
+        value = state.next();
+        memcpy(data, &value, len);
+    }
+}
+
+void rand_fill_str(char *buf, size_t len)
+{
+    rand_fill(buf, len);
+    //scale each byte into 0-61 instead of a modulo, then shift into 0-9A-Za-z with compares only so the loop gets vectorized
+    unsigned char *data = reinterpret_cast<unsigned char*>(buf);
+    for(size_t i = 0; i < len; i++)
+    {
+        unsigned char index = (data[i] * 62) >> 8;
+        data[i] = index + '0' + (index >= 10 ? 'A' - '0' - 10 : 0) + (index >= 36 ? 'a' - 'A' - 26 : 0);
+    }
+}
+
+std::string rand_str(const int len)
+{
+    if(len <= 0)
+        return std::string();
+    std::string retData(len, '\0');
+    rand_fill_str(&retData[0], len);
     return retData;
 }
 
@@ -62,6 +62,9 @@ std::string trim_quote(const std::string &str, bool before = true, bool after =
 void trim_self_of(std::string &str, char target, bool before = true, bool after = true);
 std::string getSystemProxy();
 std::string rand_str(const int len);
+uint64_t rand_u64();
+void rand_fill(void *buf, size_t len);
+void rand_fill_str(char *buf, size_t len);
 bool is_str_utf8(const std::string &data);
 std::string getFormData(const std::string &raw_data);
 
@@ -306,6 +309,17 @@ public:
         return _priv_inter_store;
     }
 
+    //gives up waiting at until, this and later calls return fallback then
+    T get(const std::chrono::steady_clock::time_point &until, const T &fallback)
+    {
+        if(_priv_set && !_priv_fetched && until != std::chrono::steady_clock::time_point::max() && _priv_inter_future.wait_until(until) != std::future_status::ready)
+        {
+            _priv_inter_store = fallback;
+            _priv_fetched = true;
+        }
+        return get();
+    }
+
     T&& move()
     {
         if(!_priv_set)
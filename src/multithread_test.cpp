@@ -15,17 +15,23 @@
 #include "socket.h"
 #include "logger.h"
 #include "printout.h"
+#include "printmsg.h"
 #include "webget.h"
 #include "nodeinfo.h"
+#include "trace.h"
+#include "profile.h"
+#include "deadline.h"
 
 using namespace std::chrono;
 
+extern bool rpcmode;
+extern socketProfile socket_profile;
+extern testProfile test_profile;
+
 std::queue<SOCKET> opened_socket;
 
 #define MAX_FILE_SIZE 512*1024*1024
-
-//for use of site ping
-const int times_to_ping = 10, fail_limit = 2;
+#define MIRROR_PROBE_RANGE 4*1024*1024
 
 //for use of multi-thread socket test
 typedef std::lock_guard<std::mutex> guarded_mutex;
@@ -33,6 +39,7 @@ std::mutex opened_socket_mutex;
 std::atomic_ullong received_bytes = 0;
 std::atomic_int launched = 0, still_running = 0;
 std::atomic_bool EXIT_FLAG = false;
+std::string stream_socket_options; //settings reported by the first stream of a test
 
 void push_socket(const SOCKET &s)
 {
@@ -40,6 +47,20 @@ void push_socket(const SOCKET &s)
     opened_socket.push(s);
 }
 
+static void apply_stream_profile(SOCKET s)
+{
+    std::string applied = applySocketProfile(s, socket_profile);
+    guarded_mutex guard(opened_socket_mutex);
+    if(stream_socket_options.empty())
+        stream_socket_options = applied;
+}
+
+static std::string get_stream_profile()
+{
+    guarded_mutex guard(opened_socket_mutex);
+    return stream_socket_options;
+}
+
 static inline void draw_progress_dl(int progress, int this_bytes)
 {
     std::cerr<<"\r[";
@@ -80,7 +101,7 @@ static inline void draw_progress_ul(int progress, int this_bytes)
     std::cerr<<" "<<speedCalc(this_bytes);
 }
 
-static inline void draw_progress_gping(int progress, int *values)
+static inline void draw_progress_gping(int progress, int *values, int times_to_ping)
 {
     std::cerr<<"\r[";
     for(int i = 0; i <= progress; i++)
@@ -106,7 +127,7 @@ static void SSL_Library_init()
     OpenSSL_add_all_algorithms();
 }
 
-int _thread_download(std::string host, int port, std::string uri, std::string localaddr, int localport, std::string username, std::string password, bool useTLS = false)
+int _thread_download(std::string host, int port, std::string uri, std::string localaddr, int localport, std::string username, std::string password, bool useTLS = false, std::atomic_ullong *mirror_bytes = nullptr)
 {
     launched++;
     still_running++;
@@ -124,7 +145,8 @@ int _thread_download(std::string host, int port, std::string uri, std::string lo
         return -1;
     push_socket(sHost);
     //defer(closesocket(sHost);) // close socket in main thread
-    setTimeout(sHost, 5000);
+    apply_stream_profile(sHost);
+    setTimeout(sHost, test_profile.socket_timeout);
     if(startConnect(sHost, localaddr, localport) == SOCKET_ERROR || connectSocks5(sHost, username, password) == -1 || connectThruSocks(sHost, host, port) == -1)
         return -1;
 
@@ -170,7 +192,11 @@ int _thread_download(std::string host, int port, std::string uri, std::string lo
                 }
                 if(cur_len == 0)
                     break;
+                if(socket_profile.quickack)
+                    socketQuickAck(sHost);
                 received_bytes += cur_len;
+                if(mirror_bytes)
+                    *mirror_bytes += cur_len;
                 if(EXIT_FLAG)
                     break;
             }
@@ -197,7 +223,11 @@ int _thread_download(std::string host, int port, std::string uri, std::string lo
             }
             if(cur_len == 0)
                 break;
+            if(socket_profile.quickack)
+                socketQuickAck(sHost);
             received_bytes += cur_len;
+            if(mirror_bytes)
+                *mirror_bytes += cur_len;
             if(EXIT_FLAG)
                 break;
         }
@@ -216,14 +246,16 @@ int _thread_upload(std::string host, int port, std::string uri, std::string loca
                           "Connection: close\r\n"
                           "Content-Length: 134217728\r\n"
                           "Host: " + host + "\r\n\r\n";
-    std::string post_data;
+    //payload is refilled before every write so that compressing middleboxes cannot skew the result
+    std::string post_data(16384, '\0');
 
     sHost = initSocket(getNetworkType(localaddr), SOCK_STREAM, IPPROTO_TCP);
     if(INVALID_SOCKET == sHost)
         return -1;
     push_socket(sHost);
     //defer(closesocket(sHost);) // close socket on main thread
-    setTimeout(sHost, 5000);
+    apply_stream_profile(sHost);
+    setTimeout(sHost, test_profile.socket_timeout);
     if(startConnect(sHost, localaddr, localport) == SOCKET_ERROR || connectSocks5(sHost, username, password) == -1 || connectThruSocks(sHost, host, port) == -1)
         return -1;
 
@@ -253,7 +285,7 @@ int _thread_upload(std::string host, int port, std::string uri, std::string loca
             SSL_write(ssl, request.data(), request.size());
             while(1)
             {
-                post_data = rand_str(128);
+                rand_fill_str(&post_data[0], post_data.size());
                 cur_len = SSL_write(ssl, post_data.data(), post_data.size());
                 if(cur_len == SOCKET_ERROR)
                 {
@@ -272,7 +304,7 @@ int _thread_upload(std::string host, int port, std::string uri, std::string loca
             return -1;
         while(1)
         {
-            post_data = rand_str(128);
+            rand_fill_str(&post_data[0], post_data.size());
             cur_len = Send(sHost, post_data.data(), post_data.size(), 0);
             if(cur_len == SOCKET_ERROR)
             {
@@ -296,18 +328,22 @@ struct thread_args
     std::string username;
     std::string password;
     bool useTLS = false;
+    int node_id = -1;
+    std::atomic_ullong *mirror_bytes = nullptr;
 };
 
 void* _thread_download_caller(void *arg)
 {
     thread_args *args = (thread_args*)arg;
-    _thread_download(args->host, args->port, args->uri, args->localaddr, args->localport, args->username, args->password, args->useTLS);
+    TRACE_SCOPE("download_stream", args->node_id);
+    _thread_download(args->host, args->port, args->uri, args->localaddr, args->localport, args->username, args->password, args->useTLS, args->mirror_bytes);
     return 0;
 }
 
 void* _thread_upload_caller(void *arg)
 {
     thread_args *args = (thread_args*)arg;
+    TRACE_SCOPE("upload_stream", args->node_id);
     _thread_upload(args->host, args->port, args->uri, args->localaddr, args->localport, args->username, args->password, args->useTLS);
     return 0;
 }
@@ -322,31 +358,50 @@ int _thread_upload_curl(nodeInfo *node, std::string url, std::string proxy)
     return 0;
 }
 
-int perform_test(nodeInfo &node, std::string localaddr, int localport, std::string username, std::string password, int thread_count)
+int perform_test(nodeInfo &node, std::string localaddr, int localport, std::string username, std::string password, int thread_count, int test_duration)
 {
     writeLog(LOG_TYPE_FILEDL, "Multi-thread download test started.");
     //prep up vars first
-    std::string host, uri, testfile = node.testFile;
-    int port = 0, i;
-    bool useTLS = false;
-
-    writeLog(LOG_TYPE_FILEDL, "Fetch target: " + testfile);
-    urlParse(testfile, host, uri, port, useTLS);
-    received_bytes = 0;
-    EXIT_FLAG = false;
-
-    if(useTLS)
+    //streams are spread over every mirror in turn, a single test file is just a list of one
+    std::vector<std::string> mirrors = node.testMirrors;
+    if(mirrors.empty())
+        mirrors.push_back(node.testFile);
+    if((int)mirrors.size() > thread_count)
     {
-        writeLog(LOG_TYPE_FILEDL, "Found HTTPS URL. Initializing OpenSSL library.");
-        SSL_Library_init();
+        writeLog(LOG_TYPE_FILEDL, "Only " + std::to_string(thread_count) + " of " + std::to_string(mirrors.size()) + " mirrors can be used with current thread count.");
+        mirrors.resize(thread_count);
     }
-    else
+    int i;
+    std::vector<thread_args> args(mirrors.size());
+    std::vector<std::atomic_ullong> mirror_bytes(mirrors.size());
+    for(size_t j = 0; j < mirrors.size(); j++)
     {
-        writeLog(LOG_TYPE_FILEDL, "Found HTTP URL.");
+        std::string testfile = mirrors[j];
+        thread_args &x = args[j];
+        writeLog(LOG_TYPE_FILEDL, "Fetch target: " + testfile);
+        urlParse(testfile, x.host, x.uri, x.port, x.useTLS);
+        x.localaddr = localaddr;
+        x.localport = localport;
+        x.username = username;
+        x.password = password;
+        x.node_id = node.id;
+        x.mirror_bytes = &mirror_bytes[j];
+        mirror_bytes[j] = 0;
+        if(x.useTLS)
+        {
+            writeLog(LOG_TYPE_FILEDL, "Found HTTPS URL. Initializing OpenSSL library.");
+            SSL_Library_init();
+        }
+        else
+        {
+            writeLog(LOG_TYPE_FILEDL, "Found HTTP URL.");
+        }
     }
+    received_bytes = 0;
+    EXIT_FLAG = false;
+    eraseElements(stream_socket_options);
 
     int running;
-    thread_args args = {host, port, uri, localaddr, localport, username, password, useTLS};
     //std::thread threads[thread_count];
     pthread_t threads[thread_count];
     launched = 0;
@@ -354,15 +409,16 @@ int perform_test(nodeInfo &node, std::string localaddr, int localport, std::stri
     {
         writeLog(LOG_TYPE_FILEDL, "Starting up thread #" + std::to_string(i + 1) + ".");
         //threads[i] = std::thread(_thread_download, host, port, uri, localaddr, localport, username, password, useTLS);
-        pthread_create(&threads[i], NULL, _thread_download_caller, &args);
+        pthread_create(&threads[i], NULL, _thread_download_caller, &args[i % args.size()]);
     }
-    while(!launched)
+    while(!launched && !deadlineExpired())
         sleep(20); //wait until any one of the threads start up
 
     writeLog(LOG_TYPE_FILEDL, "All threads launched. Start accumulating data.");
     auto start = steady_clock::now();
     unsigned long long transferred_bytes = 0, last_bytes = 0, this_bytes = 0, cur_recv_bytes = 0, max_speed = 0;
-    for(i = 1; i < 21; i++)
+    int samples = std::max(1, std::min(test_duration * 2, 20)); //one sample every 0.5s, rawSpeed holds at most 10s
+    for(i = 1; i <= samples; i++)
     {
         sleep(500); //accumulate data
         cur_recv_bytes = received_bytes;
@@ -379,10 +435,16 @@ int perform_test(nodeInfo &node, std::string localaddr, int localport, std::stri
             last_bytes = this_bytes;
         }
         running = still_running;
-        writeLog(LOG_TYPE_FILEDL, "Running threads: " + std::to_string(running) + ", total received bytes: " + std::to_string(transferred_bytes) \
-                 + ", current received bytes: " + std::to_string(this_bytes) + ".");
+        writeLog(LOG_TYPE_FILEDL, [&]{ return "Running threads: " + std::to_string(running) + ", total received bytes: " + std::to_string(transferred_bytes) \
+                 + ", current received bytes: " + std::to_string(this_bytes) + "."; }, LOG_LEVEL_VERBOSE);
+        printMsg(SPEEDTEST_MESSAGE_GOTSAMPLE, rpcmode, std::to_string(node.id), "download", std::to_string(i - 1), std::to_string(this_bytes));
         if(!running)
             break;
+        if(deadlineExpired())
+        {
+            writeLog(LOG_TYPE_FILEDL, "Node deadline reached. Stop now.");
+            break;
+        }
         draw_progress_dl(i, this_bytes);
     }
     std::cerr<<std::endl;
@@ -408,6 +470,22 @@ int perform_test(nodeInfo &node, std::string localaddr, int localport, std::stri
     }
     //writeLog(LOG_TYPE_FILEDL, "Downloaded " + std::to_string(received_bytes) + " bytes in " + std::to_string(deltatime) + " milliseconds.");
     writeLog(LOG_TYPE_FILEDL, "Downloaded " + std::to_string(cur_recv_bytes) + " bytes in " + std::to_string(deltatime) + " milliseconds.");
+    std::string applied = get_stream_profile();
+    if(applied.size())
+    {
+        node.socketOptions = applied;
+        writeLog(LOG_TYPE_FILEDL, "Stream socket options: " + applied);
+    }
+    if(node.testMirrors.size())
+    {
+        node.testMirrors = mirrors;
+        node.mirrorSpeed.resize(mirrors.size());
+        for(size_t j = 0; j < mirrors.size(); j++)
+        {
+            node.mirrorSpeed[j] = mirror_bytes[j] * 1000 / deltatime;
+            writeLog(LOG_TYPE_FILEDL, "Mirror " + mirrors[j] + " : " + speedCalc(node.mirrorSpeed[j]) + "/s");
+        }
+    }
     for(int i = 0; i < thread_count; i++)
     {
         /*
@@ -441,6 +519,7 @@ int upload_test(nodeInfo &node, std::string localaddr, int localport, std::strin
     urlParse(testfile, host, uri, port, useTLS);
     received_bytes = 0;
     EXIT_FLAG = false;
+    eraseElements(stream_socket_options);
 
     if(useTLS)
     {
@@ -454,7 +533,7 @@ int upload_test(nodeInfo &node, std::string localaddr, int localport, std::strin
 
     //std::thread workers[2];
     pthread_t workers[2];
-    thread_args args = {host, port, uri, localaddr, localport, username, password, useTLS};
+    thread_args args = {host, port, uri, localaddr, localport, username, password, useTLS, node.id};
     launched = 0;
     for(i = 0; i < 1; i++)
     {
@@ -462,7 +541,7 @@ int upload_test(nodeInfo &node, std::string localaddr, int localport, std::strin
         //workers[i] = std::thread(_thread_upload, host, port, uri, localaddr, localport, username, password, useTLS);
         pthread_create(&workers[i], NULL, _thread_upload_caller, &args);
     }
-    while(!launched)
+    while(!launched && !deadlineExpired())
         sleep(20); //wait until worker thread starts up
 
     writeLog(LOG_TYPE_FILEUL, "Worker threads launched. Start accumulating data.");
@@ -476,10 +555,16 @@ int upload_test(nodeInfo &node, std::string localaddr, int localport, std::strin
         transferred_bytes = cur_sent_bytes;
         sleep(1); //slow down to prevent some problem
         running = still_running;
-        writeLog(LOG_TYPE_FILEUL, "Running worker threads: " + std::to_string(running) + ", total sent bytes: " + std::to_string(transferred_bytes) \
-                 + ", current sent bytes: " + std::to_string(this_bytes) + ".");
+        writeLog(LOG_TYPE_FILEUL, [&]{ return "Running worker threads: " + std::to_string(running) + ", total sent bytes: " + std::to_string(transferred_bytes) \
+                 + ", current sent bytes: " + std::to_string(this_bytes) + "."; }, LOG_LEVEL_VERBOSE);
+        printMsg(SPEEDTEST_MESSAGE_GOTSAMPLE, rpcmode, std::to_string(node.id), "upload", std::to_string(i - 1), std::to_string(this_bytes));
         if(!running)
             break;
+        if(deadlineExpired())
+        {
+            writeLog(LOG_TYPE_FILEUL, "Node deadline reached. Stop now.");
+            break;
+        }
         draw_progress_ul(i, this_bytes);
     }
     std::cerr<<std::endl;
@@ -502,6 +587,13 @@ int upload_test(nodeInfo &node, std::string localaddr, int localport, std::strin
         node.ulSpeed = "N/A";
     }
     writeLog(LOG_TYPE_FILEUL, "Uploaded " + std::to_string(this_bytes) + " bytes in " + std::to_string(deltatime) + " milliseconds.");
+    std::string applied = get_stream_profile();
+    if(applied.size())
+    {
+        if(node.socketOptions.empty())
+            node.socketOptions = applied;
+        writeLog(LOG_TYPE_FILEUL, "Stream socket options: " + applied);
+    }
     node.totalRecvBytes += this_bytes;
     /*
     for(auto &x : workers)
@@ -533,7 +625,7 @@ int upload_test_curl(nodeInfo &node, std::string localaddr, int localport, std::
     writeLog(LOG_TYPE_FILEUL, "Starting up worker thread.");
     launched = 0;
     std::thread worker = std::thread(_thread_upload_curl, &node, url, proxy);
-    while(!launched)
+    while(!launched && !deadlineExpired())
         sleep(20); //wait until worker thread starts up
 
     writeLog(LOG_TYPE_FILEUL, "Worker thread launched. Wait for it to exit.");
@@ -541,7 +633,7 @@ int upload_test_curl(nodeInfo &node, std::string localaddr, int localport, std::
     while(true)
     {
         sleep(200);
-        if(!still_running)
+        if(!still_running || deadlineExpired())
             break;
         draw_progress_icon(progress);
         progress++;
@@ -565,6 +657,7 @@ int sitePing(nodeInfo &node, std::string localaddr, int localport, std::string u
     SOCKET sHost;
     std::string host, uri;
     int port = 0, rawSitePing[10] = {};
+    int times_to_ping = test_profile.site_ping_count, fail_limit = test_profile.site_ping_fail_limit;
     bool useTLS = false;
     urlParse(target, host, uri, port, useTLS);
     std::string request = "GET " + uri + " HTTP/1.1\r\n"
@@ -584,8 +677,13 @@ int sitePing(nodeInfo &node, std::string localaddr, int localport, std::string u
             writeLog(LOG_TYPE_GPING, "Fail limit exceeded. Stop now.");
             break;
         }
+        if(deadlineExpired())
+        {
+            writeLog(LOG_TYPE_GPING, "Node deadline reached. Stop now.");
+            break;
+        }
         defer(loopcounter++;)
-        defer(draw_progress_gping(loopcounter, rawSitePing);)
+        defer(draw_progress_gping(loopcounter, rawSitePing, times_to_ping);)
         time_point<steady_clock> start = steady_clock::now(), end;
         milliseconds lapse;
         int deltatime = 0;
@@ -596,15 +694,16 @@ int sitePing(nodeInfo &node, std::string localaddr, int localport, std::string u
             if(failed)
             {
                 failcounter++;
-                writeLog(LOG_TYPE_GPING, "Accessing '" + target + "' - Fail - time=" + std::to_string(deltatime) + "ms");
+                writeLog(LOG_TYPE_GPING, [&]{ return "Accessing '" + target + "' - Fail - time=" + std::to_string(deltatime) + "ms"; }, LOG_LEVEL_VERBOSE);
             }
             else
             {
                 succeedcounter++;
                 rawSitePing[loopcounter] = deltatime;
                 totduration += deltatime;
-                writeLog(LOG_TYPE_GPING, "Accessing '" + target + "' - Success - time=" + std::to_string(deltatime) + "ms");
+                writeLog(LOG_TYPE_GPING, [&]{ return "Accessing '" + target + "' - Success - time=" + std::to_string(deltatime) + "ms"; }, LOG_LEVEL_VERBOSE);
             }
+            printMsg(SPEEDTEST_MESSAGE_GOTPROBE, rpcmode, std::to_string(node.id), "site", std::to_string(loopcounter), failed ? "false" : "true", std::to_string(deltatime));
         )
         sHost = initSocket(getNetworkType(localaddr), SOCK_STREAM, IPPROTO_TCP);
         if(INVALID_SOCKET == sHost)
@@ -618,7 +717,7 @@ int sitePing(nodeInfo &node, std::string localaddr, int localport, std::string u
             writeLog(LOG_TYPE_GPING, "ERROR: Connect to SOCKS5 server " + localaddr + ":" + std::to_string(localport) + " failed.");
             continue;
         }
-        setTimeout(sHost, 5000);
+        setTimeout(sHost, test_profile.socket_timeout);
         if(connectSocks5(sHost, username, password) == -1)
         {
             writeLog(LOG_TYPE_GPING, "ERROR: SOCKS5 server authentication failed.");
@@ -677,3 +776,87 @@ int sitePing(nodeInfo &node, std::string localaddr, int localport, std::string u
     writeLog(LOG_TYPE_GPING, "Website ping completed. Leaving.");
     return SPEEDTEST_MESSAGE_GOTGPING;
 }
+
+int mirrorProbe(const std::string &url, std::string localaddr, int localport, std::string username, std::string password, int burst_time, int &ttfb, unsigned long long &speed)
+{
+    char bufRecv[BUF_SIZE];
+    int cur_len;
+    SOCKET sHost;
+    std::string host, uri, target = url;
+    int port = 0;
+    bool useTLS = false;
+    ttfb = -1;
+    speed = 0;
+    urlParse(target, host, uri, port, useTLS);
+    std::string request = "GET " + uri + " HTTP/1.1\r\n"
+                          "Host: " + host + "\r\n"
+                          "Range: bytes=0-" + std::to_string(MIRROR_PROBE_RANGE - 1) + "\r\n"
+                          "Connection: close\r\n"
+                          "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/72.0.3626.121 Safari/537.36\r\n\r\n";
+
+    sHost = initSocket(getNetworkType(localaddr), SOCK_STREAM, IPPROTO_TCP);
+    if(INVALID_SOCKET == sHost)
+        return -1;
+    defer(closesocket(sHost);)
+    setTimeout(sHost, test_profile.socket_timeout);
+    if(startConnect(sHost, localaddr, localport) == SOCKET_ERROR || connectSocks5(sHost, username, password) == -1 || connectThruSocks(sHost, host, port) == -1)
+    {
+        writeLog(LOG_TYPE_RULES, "Mirror probe: connect to " + host + ":" + std::to_string(port) + " through SOCKS5 server failed.");
+        return -1;
+    }
+
+    SSL_CTX *ctx = NULL;
+    SSL *ssl = NULL;
+    defer(if(ssl) SSL_free(ssl); if(ctx) SSL_CTX_free(ctx);)
+    if(useTLS)
+    {
+        ctx = SSL_CTX_new(TLS_client_method());
+        if(ctx == NULL)
+        {
+            writeLog(LOG_TYPE_RULES, "OpenSSL: " + std::string(ERR_error_string(ERR_get_error(), NULL)));
+            return -1;
+        }
+        ssl = SSL_new(ctx);
+        SSL_set_fd(ssl, sHost);
+        SSL_set_tlsext_host_name(ssl, host.data());
+        if(SSL_connect(ssl) != 1)
+        {
+            writeLog(LOG_TYPE_RULES, "Mirror probe: TLS handshake with " + host + ":" + std::to_string(port) + " failed.");
+            return -1;
+        }
+    }
+    auto send_all = [&]() { return useTLS ? SSL_write(ssl, request.data(), request.size()) : Send(sHost, request.data(), request.size(), 0); };
+    auto recv_some = [&]() { return useTLS ? SSL_read(ssl, bufRecv, BUF_SIZE - 1) : Recv(sHost, bufRecv, BUF_SIZE - 1, 0); };
+
+    time_point<steady_clock> start = steady_clock::now(), first;
+    if(send_all() <= 0)
+        return -1;
+    cur_len = recv_some();
+    if(cur_len <= 0)
+        return -1;
+    first = steady_clock::now();
+    ttfb = duration_cast<milliseconds>(first - start).count();
+    //only a successful response counts, a mirror answering 404 must not win by being fast
+    std::string status(bufRecv, std::min(cur_len, 12));
+    if(status.size() < 12 || !startsWith(status, "HTTP/1.") || (status.substr(9, 3) != "200" && status.substr(9, 3) != "206"))
+    {
+        writeLog(LOG_TYPE_RULES, "Mirror probe: '" + url + "' answered '" + status + "'.");
+        ttfb = -1;
+        return -1;
+    }
+
+    //the first read carries the headers, the burst is timed from there
+    setTimeout(sHost, burst_time);
+    unsigned long long received = 0;
+    int elapsed = 0;
+    while(received < MIRROR_PROBE_RANGE && elapsed < burst_time)
+    {
+        cur_len = recv_some();
+        if(cur_len <= 0)
+            break;
+        received += cur_len;
+        elapsed = duration_cast<milliseconds>(steady_clock::now() - first).count();
+    }
+    speed = received * 1000 / (elapsed + 1);
+    return 0;
+}
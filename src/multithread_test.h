@@ -6,9 +6,10 @@
 #include "misc.h"
 #include "nodeinfo.h"
 
-int perform_test(nodeInfo &node, std::string localaddr, int localport, std::string username, std::string password, int thread_count);
+int perform_test(nodeInfo &node, std::string localaddr, int localport, std::string username, std::string password, int thread_count, int test_duration = 10);
 int upload_test(nodeInfo &node, std::string localaddr, int localport, std::string username, std::string password);
 int upload_test_curl(nodeInfo &node, std::string localaddr, int localport, std::string username, std::string password);
 int sitePing(nodeInfo &node, std::string localaddr, int localport, std::string username, std::string password, std::string target);
+int mirrorProbe(const std::string &url, std::string localaddr, int localport, std::string username, std::string password, int burst_time, int &ttfb, unsigned long long &speed);
 
 #endif // MULTITHREAD_TEST_H_INCLUDED
@@ -7,6 +7,26 @@
 #include "geoip.h"
 #include "misc.h"
 
+//steps of singleTest(), each one is timed into nodeInfo::phaseDuration
+enum
+{
+    NODE_PHASE_CONFIG_WRITE,
+    NODE_PHASE_CLIENT_SPAWN,
+    NODE_PHASE_CLIENT_READY,
+    NODE_PHASE_TCPING,
+    NODE_PHASE_GEOIP_WAIT,
+    NODE_PHASE_SITE_PING,
+    NODE_PHASE_DOWNLOAD,
+    NODE_PHASE_UPLOAD,
+    NODE_PHASE_NAT_WAIT,
+    NODE_PHASE_MIRROR_PROBE,
+    NODE_PHASE_LOAD_TEST,
+    NODE_PHASE_PAGE_LOAD,
+    NODE_PHASE_COUNT
+};
+
+static const char *const node_phase_names[NODE_PHASE_COUNT] = {"config_write", "client_spawn", "client_ready", "tcping", "geoip_wait", "site_ping", "download", "upload", "nat_wait", "mirror_probe", "load_test", "page_load"};
+
 struct nodeInfo
 {
     int linkType = -1;
@@ -21,6 +41,7 @@ struct nodeInfo
     unsigned long long rawSpeed[20] = {};
     unsigned long long totalRecvBytes = 0;
     int duration = 0;
+    int phaseDuration[NODE_PHASE_COUNT] = {}; //milliseconds
     std::string avgSpeed = "N/A";
     std::string maxSpeed = "N/A";
     std::string ulSpeed = "N/A";
@@ -33,7 +54,22 @@ struct nodeInfo
     FutureHelper<geoIPInfo> inboundGeoIP;
     FutureHelper<geoIPInfo> outboundGeoIP;
     std::string testFile;
+    std::vector<std::string> testMirrors; //every URL the download streams are spread across, empty for testFile alone
+    std::vector<unsigned long long> mirrorSpeed; //bytes per second, same order as testMirrors
+    std::string mirrorProbe; //probe results of the candidates when the test file was picked by mirror_select
+    bool screenOnly = false; //tournament mode: only the screen stage was run on this node
+    std::string screenSpeed = "N/A";
+    std::string screenPing = "0.00";
+    unsigned long long screenTraffic = 0;
+    double screenScore = 0.0;
+    long long cachedTime = 0; //unix time of the earlier run whose result was reused, 0 when tested in this run
+    std::string connRate = "N/A"; //new connections per second at the knee of the load test
+    std::string reqRate = "N/A"; //keep-alive requests per second at the knee of the load test
+    std::string loadTest; //knee, stop reason and errors of both load test modes
+    std::string pageLoad = "N/A"; //milliseconds until the last resource of the simulated page was done
+    std::string pageLoadPath; //resource counts and the critical path of the page load
     std::string ulTarget;
+    std::string socketOptions; //as reported by the kernel for the first test stream
     FutureHelper<std::string> natType {"Unknown"};
 };
 
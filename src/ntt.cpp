@@ -1,9 +1,9 @@
 #include <iostream>
 #include <string>
-#include <random>
 
 #include "socket.h"
 #include "misc.h"
+#include "deadline.h"
 #include "logger.h"
 
 //Stun message types
@@ -107,16 +107,12 @@ std::tuple<uint16_t, uint16_t> socks5_init_udp(SOCKET s, SOCKET udp_s, const std
 
 std::string random_string(string_size length)
 {
-    const std::string CHARACTERS = "0123456789ABCDEF";
+    const char CHARACTERS[] = "0123456789ABCDEF";
 
-    std::random_device random_device;
-    std::mt19937 generator(random_device());
-    std::uniform_int_distribution<> distribution(0, CHARACTERS.size() - 1);
-
-    std::string random_string;
-
-    while(length--)
-        random_string += CHARACTERS[distribution(generator)];
+    std::string random_string(length, '\0');
+    rand_fill(&random_string[0], length);
+    for(char &x : random_string)
+        x = CHARACTERS[x & 15];
 
     return random_string;
 }
@@ -172,7 +168,7 @@ STUN_RESPONSE get_stun_response_thru_socks5(SOCKET udp_s, const std::string &ser
     bool passed = false;
 
     std::string msg_type, recv_trans_id, attrs;
-    while(fail_count < max_fails)
+    while(fail_count < max_fails && !deadlineExpired())
     {
         if((sent_len = socks5_send_udp_data(udp_s, server, udp_port, target_server, target_port, message)) < 0)
         {
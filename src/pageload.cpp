@@ -0,0 +1,338 @@
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+
+#include <curl/curl.h>
+
+#include "pageload.h"
+#include "deadline.h"
+#include "logger.h"
+#include "misc.h"
+#include "webget.h"
+
+using namespace std::chrono;
+
+//variables from webget
+extern std::string user_agent_str;
+
+struct pageTransfer
+{
+    CURL *handle = nullptr;
+    size_t index = 0;
+    time_point<steady_clock> ready; //parent done, the browser would now request it
+    time_point<steady_clock> added; //given to curl once its host had a free connection
+    unsigned long long bytes = 0;
+};
+
+//requests a host has in flight, limited to the connections per host until it turns out to multiplex
+struct pageHost
+{
+    int active = 0;
+    bool multiplex = false;
+};
+
+static size_t pageWriter(char *data, size_t size, size_t nmemb, void *userp)
+{
+    static_cast<pageTransfer*>(userp)->bytes += size * nmemb;
+    return size * nmemb;
+}
+
+//last path segment without the query, the host when there is none
+static std::string pageResourceName(const std::string &url)
+{
+    std::string name = url.substr(0, url.find_first_of("?#"));
+    std::string::size_type pos = name.find("://");
+    if(pos != name.npos)
+        name.erase(0, pos + 3);
+    if(name.size() && name.back() == '/')
+        name.pop_back();
+    pos = name.rfind('/');
+    return pos == name.npos ? name : name.substr(pos + 1);
+}
+
+int pageManifestParse(const std::string &content, std::vector<pageResource> &resources)
+{
+    eraseElements(resources);
+    for(std::string &line : split(replace_all_distinct(content, "\r\n", "\n"), "\n"))
+    {
+        line = trim(line);
+        if(line.empty() || line[0] == '#' || line[0] == ';')
+            continue;
+        pageResource resource;
+        std::string::size_type pos = line.rfind('|');
+        resource.url = line.substr(0, pos);
+        resource.parent = resources.empty() ? -1 : 0;
+        if(pos != line.npos && resources.size())
+            resource.parent = to_int(trim(line.substr(pos + 1)), 0);
+        if(!isLink(resource.url) || resource.parent >= (int)resources.size() || (resources.size() && resource.parent < 0))
+        {
+            writeLog(LOG_TYPE_WARN, "Page manifest: ignoring line '" + line + "', it needs a URL and the line of an earlier resource.");
+            continue;
+        }
+        resources.push_back(resource);
+    }
+    return resources.empty() ? -1 : 0;
+}
+
+int pageManifestLoad(const std::string &source, std::vector<pageResource> &resources)
+{
+    std::string content = isLink(source) ? webGet(source) : fileGet(source);
+    if(content.empty() || pageManifestParse(content, resources) != 0)
+    {
+        writeLog(LOG_TYPE_ERROR, "Cannot load page manifest from '" + source + "'.");
+        return -1;
+    }
+    writeLog(LOG_TYPE_INFO, "Loaded page manifest with " + std::to_string(resources.size()) + " resource(s) from '" + source + "'.");
+    return 0;
+}
+
+//scheme, host and port, what a browser keeps its connections per
+static std::string pageHostKey(const std::string &url)
+{
+    std::string::size_type pos = url.find("://");
+    pos = url.find_first_of("/?#", pos == url.npos ? 0 : pos + 3);
+    return url.substr(0, pos);
+}
+
+static void pageStart(CURLM *multi, std::vector<pageTransfer> &transfers, const std::vector<pageResource> &resources, const std::string &proxy, size_t index)
+{
+    pageTransfer &transfer = transfers[index];
+    CURL *handle = curl_easy_init();
+    if(!handle)
+        return;
+    transfer.handle = handle;
+    transfer.index = index;
+    transfer.added = steady_clock::now();
+    curl_easy_setopt(handle, CURLOPT_URL, resources[index].url.data());
+    curl_easy_setopt(handle, CURLOPT_PROXY, proxy.data());
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(handle, CURLOPT_MAXREDIRS, 5L);
+    curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, 0L);
+    curl_easy_setopt(handle, CURLOPT_SSL_VERIFYHOST, 0L);
+    curl_easy_setopt(handle, CURLOPT_TIMEOUT_MS, (long)deadlineRemaining(15000));
+    curl_easy_setopt(handle, CURLOPT_USERAGENT, user_agent_str.data());
+    curl_easy_setopt(handle, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(handle, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L); //like a browser, wait for a connection that can multiplex instead of opening another one
+    curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, pageWriter);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer);
+    curl_easy_setopt(handle, CURLOPT_PRIVATE, &transfer);
+    curl_multi_add_handle(multi, handle);
+}
+
+static void pageFinish(pageTransfer &transfer, CURLcode code, pageLoadResult &result, time_point<steady_clock> start, const std::string &url)
+{
+    pageResourceTiming &timing = result.timings[transfer.index];
+    curl_off_t queue = 0, connect = 0, appconnect = 0, pretransfer = 0, starttransfer = 0, total = 0;
+    long status = 0, version = 0;
+    curl_easy_getinfo(transfer.handle, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(transfer.handle, CURLINFO_HTTP_VERSION, &version);
+#if LIBCURL_VERSION_NUM >= 0x080600
+    //a multiplexing host takes every request at once, curl may still hold some back until the connection is up
+    curl_easy_getinfo(transfer.handle, CURLINFO_QUEUE_TIME_T, &queue);
+#endif // LIBCURL_VERSION_NUM
+    curl_easy_getinfo(transfer.handle, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(transfer.handle, CURLINFO_APPCONNECT_TIME_T, &appconnect);
+    curl_easy_getinfo(transfer.handle, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(transfer.handle, CURLINFO_STARTTRANSFER_TIME_T, &starttransfer);
+    curl_easy_getinfo(transfer.handle, CURLINFO_TOTAL_TIME_T, &total);
+    //curl times are in microseconds since the handle was added and include its own queue, the wait for a free
+    //connection of the host before that is measured here
+    timing.start = duration_cast<milliseconds>(transfer.ready - start).count();
+    timing.end = duration_cast<milliseconds>(steady_clock::now() - start).count();
+    timing.queue = (duration_cast<microseconds>(transfer.added - transfer.ready).count() + queue) / 1000;
+    timing.connect = std::max<curl_off_t>(connect - queue, 0) / 1000;
+    timing.tls = std::max<curl_off_t>(appconnect - connect, 0) / 1000;
+    timing.wait = std::max<curl_off_t>(starttransfer - pretransfer, 0) / 1000;
+    timing.receive = std::max<curl_off_t>(total - starttransfer, 0) / 1000;
+    timing.bytes = transfer.bytes;
+    switch(version)
+    {
+    case CURL_HTTP_VERSION_2_0:
+        timing.http_version = 2;
+        break;
+    case CURL_HTTP_VERSION_3:
+        timing.http_version = 3;
+        break;
+    default:
+        timing.http_version = 1;
+    }
+    timing.ok = code == CURLE_OK && status < 400;
+    if(!timing.ok)
+        writeLog(LOG_TYPE_WARN, "Page load: '" + url + "' failed: " + (code != CURLE_OK ? std::string(curl_easy_strerror(code)) : "HTTP " + std::to_string(status)) + ".");
+    writeLog(LOG_TYPE_PAGE, [&]{ return "Page load: '" + url + "' done at " + std::to_string(timing.end) + "ms, queue " + std::to_string(timing.queue) + "ms, connect " + std::to_string(timing.connect) +
+                                         "ms, tls " + std::to_string(timing.tls) + "ms, wait " + std::to_string(timing.wait) + "ms, receive " + std::to_string(timing.receive) + "ms, HTTP/" + std::to_string(timing.http_version); }, LOG_LEVEL_VERBOSE);
+}
+
+int pageLoadRun(const std::vector<pageResource> &resources, const std::string &proxy, int host_connections, pageLoadResult &result)
+{
+    result = pageLoadResult();
+    if(resources.empty() || resources[0].parent != -1)
+        return -1;
+    host_connections = std::max(host_connections, 1);
+    //a browser lets the proxy resolve host names
+    std::string proxy_remote = startsWith(proxy, "socks5://") ? "socks5h://" + proxy.substr(9) : proxy;
+    std::vector<pageTransfer> transfers(resources.size());
+    std::vector<std::vector<size_t>> children(resources.size());
+    std::vector<std::string> host_keys(resources.size());
+    std::map<std::string, pageHost> hosts;
+    for(size_t i = 0; i < resources.size(); i++)
+    {
+        host_keys[i] = pageHostKey(resources[i].url);
+        if(i)
+            children[resources[i].parent].push_back(i);
+    }
+    result.timings.resize(resources.size());
+
+    CURLM *multi = curl_multi_init();
+    if(!multi)
+        return -1;
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)host_connections);
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    defer(
+        for(pageTransfer &x : transfers)
+        {
+            if(!x.handle)
+                continue;
+            curl_multi_remove_handle(multi, x.handle);
+            curl_easy_cleanup(x.handle);
+        }
+        curl_multi_cleanup(multi);
+    )
+
+    //resources whose parent is done, in the order the browser found them, waiting for a connection of their host
+    std::deque<size_t> ready;
+    size_t pending = 0;
+    auto start = steady_clock::now();
+    auto admit = [&]()
+    {
+        for(auto iter = ready.begin(); iter != ready.end();)
+        {
+            pageHost &host = hosts[host_keys[*iter]];
+            if(!host.multiplex && host.active >= host_connections)
+            {
+                iter++;
+                continue;
+            }
+            result.timings[*iter].started = true;
+            pageStart(multi, transfers, resources, proxy_remote, *iter);
+            if(transfers[*iter].handle)
+            {
+                host.active++;
+                pending++;
+            }
+            iter = ready.erase(iter);
+        }
+    };
+    transfers[0].ready = start;
+    ready.push_back(0);
+    admit();
+    while(pending)
+    {
+        int running = 0, left = 0;
+        curl_multi_perform(multi, &running);
+        CURLMsg *msg;
+        while((msg = curl_multi_info_read(multi, &left)))
+        {
+            if(msg->msg != CURLMSG_DONE)
+                continue;
+            pageTransfer *transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&transfer));
+            pageFinish(*transfer, msg->data.result, result, start, resources[transfer->index].url);
+            pending--;
+            pageHost &host = hosts[host_keys[transfer->index]];
+            host.active--;
+            if(result.timings[transfer->index].http_version >= 2)
+                host.multiplex = true;
+            //what a failed resource would have referenced is never discovered
+            if(!result.timings[transfer->index].ok)
+                continue;
+            auto now = steady_clock::now();
+            for(size_t x : children[transfer->index])
+            {
+                transfers[x].ready = now;
+                ready.push_back(x);
+            }
+        }
+        admit();
+        if(!pending)
+            break;
+        if(deadlineExpired())
+        {
+            writeLog(LOG_TYPE_WARN, "Page load: node deadline reached with " + std::to_string(pending + ready.size()) + " resource(s) still loading.");
+            break;
+        }
+        curl_multi_poll(multi, NULL, 0, 100, NULL);
+    }
+
+    int last = -1;
+    for(size_t i = 0; i < resources.size(); i++)
+    {
+        const pageResourceTiming &x = result.timings[i];
+        if(!x.ok)
+        {
+            result.failed++;
+            continue;
+        }
+        if(last < 0 || x.end > result.timings[last].end)
+            last = i;
+    }
+    if(last < 0)
+        return -1;
+    result.total = result.timings[last].end;
+    for(int x = last; x >= 0; x = resources[x].parent)
+        result.critical_path.insert(result.critical_path.begin(), x);
+    //a page with holes loads faster than the real one would, the caller must not take its total as the load time
+    return result.failed ? -2 : 0;
+}
+
+std::string pageLoadString(const std::vector<pageResource> &resources, const pageLoadResult &result)
+{
+    unsigned int multiplexed = 0;
+    for(const pageResourceTiming &x : result.timings)
+    {
+        if(x.ok && x.http_version >= 2)
+            multiplexed++;
+    }
+    std::string data = std::to_string(resources.size()) + " resources, " + std::to_string(result.failed) + " failed, " + std::to_string(multiplexed) + " over HTTP/2 or later, critical path: ";
+    for(size_t i = 0; i < result.critical_path.size(); i++)
+    {
+        int index = result.critical_path[i];
+        const pageResourceTiming &x = result.timings[index];
+        data += (i ? " > " : "") + pageResourceName(resources[index].url) + " " + std::to_string(x.end - x.start) + "ms (queue " + std::to_string(x.queue) + ", connect " + std::to_string(x.connect) +
+                ", tls " + std::to_string(x.tls) + ", wait " + std::to_string(x.wait) + ", receive " + std::to_string(x.receive) + ")";
+    }
+    return data;
+}
+
+int pageLoadTest(nodeInfo &node, const std::string &proxy, const std::vector<pageResource> &resources, int host_connections)
+{
+    pageLoadResult result;
+    node.pageLoad = "N/A";
+    node.pageLoadPath.clear();
+    if(resources.empty())
+        return -1;
+    writeLog(LOG_TYPE_PAGE, "Page load simulation started. Document: '" + resources[0].url + "' with " + std::to_string(resources.size() - 1) + " subresource(s). Proxy: '" + proxy + "' .");
+    switch(pageLoadRun(resources, proxy, host_connections, result))
+    {
+    case 0:
+        break;
+    case -2:
+        node.pageLoadPath = "incomplete: " + pageLoadString(resources, result);
+        writeLog(LOG_TYPE_PAGE, "Page load simulation incomplete, " + node.pageLoadPath);
+        return -1;
+    default:
+        node.pageLoadPath = "document failed";
+        writeLog(LOG_TYPE_PAGE, "Page load simulation failed, the document could not be loaded.");
+        return -1;
+    }
+    node.pageLoad = std::to_string(result.total);
+    node.pageLoadPath = pageLoadString(resources, result);
+    writeLog(LOG_TYPE_PAGE, "Page load: " + node.pageLoad + "ms, " + node.pageLoadPath);
+    return 0;
+}
@@ -0,0 +1,57 @@
+#ifndef PAGELOAD_H_INCLUDED
+#define PAGELOAD_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "nodeinfo.h"
+
+/*
+Web page load simulation. A manifest lists one HTML document and the subresources it pulls in, on any number
+of hosts. The document is fetched first and every other resource starts as soon as the one referencing it is
+done, all through the node on one curl multi handle with a browser's limit of connections per host and HTTP/2
+over TLS where the server offers it. The result is the time until the last resource is done and the chain of
+resources that decided it, each split into queueing, connect, TLS, waiting and receiving.
+
+Manifest lines are "url" or "url|parent", parent being the 0-based line of the resource that references it.
+The first line is the document, every other line defaults to parent 0. Lines starting with "#" or ";" are
+ignored.
+*/
+
+struct pageResource
+{
+    std::string url;
+    int parent = -1; //-1 only for the document
+};
+
+struct pageResourceTiming
+{
+    bool started = false;
+    bool ok = false;
+    int http_version = 0; //1, 2 or 3
+    int start = 0; //milliseconds since the page load started, taken when the parent was done
+    int end = 0;
+    int queue = 0; //milliseconds waiting for a free connection of the host
+    int connect = 0; //through the node, 0 on a reused connection
+    int tls = 0;
+    int wait = 0; //request sent until the first response byte
+    int receive = 0;
+    unsigned long long bytes = 0;
+};
+
+struct pageLoadResult
+{
+    int total = 0; //milliseconds until the last resource was done
+    unsigned int failed = 0; //including resources never started because their parent failed
+    std::vector<pageResourceTiming> timings; //same order as the manifest
+    std::vector<int> critical_path; //from the document to the resource done last
+};
+
+int pageManifestParse(const std::string &content, std::vector<pageResource> &resources);
+int pageManifestLoad(const std::string &source, std::vector<pageResource> &resources); //file path or URL
+//0 when every resource loaded, -2 when some failed or the deadline cut the run, -1 when the document failed
+int pageLoadRun(const std::vector<pageResource> &resources, const std::string &proxy, int host_connections, pageLoadResult &result);
+std::string pageLoadString(const std::vector<pageResource> &resources, const pageLoadResult &result);
+int pageLoadTest(nodeInfo &node, const std::string &proxy, const std::vector<pageResource> &resources, int host_connections);
+
+#endif // PAGELOAD_H_INCLUDED
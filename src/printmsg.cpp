@@ -2,10 +2,17 @@
 #include <fstream>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <chrono>
 
 #include "printout.h"
+#include "printmsg.h"
 #include "version.h"
 
+//batched RPC events are flushed once this many bytes or milliseconds have piled up
+#define RPC_BATCH_SIZE 4096
+#define RPC_BATCH_INTERVAL 200
+
 //define print-out messages
 struct LOOKUP_ITEM
 {
@@ -34,7 +41,7 @@ LOOKUP_ITEM SPEEDTEST_MESSAGES[] =
     {SPEEDTEST_MESSAGE_STARTSPEED, "Now performing Speed Test...\n"},
     {SPEEDTEST_MESSAGE_STARTUPD, "Now performing Upload Test...\n"},
     {SPEEDTEST_MESSAGE_GOTRESULT, "Result: DL.Speed: ?0? Max.Speed: ?1? UL.Speed: ?2? Pk.Loss: ?3? Avg.Ping: ?4? Google Ping: ?5? NAT Type: ?6?\n"},
-    {SPEEDTEST_MESSAGE_TRAFFIC, "Traffic used: ?traffic?\n"},
+    {SPEEDTEST_MESSAGE_TRAFFIC, "Traffic used: ?0?\n"},
     {SPEEDTEST_MESSAGE_PICSAVING, "Now exporting picture...\n"},
     {SPEEDTEST_MESSAGE_PICSAVINGMULTI, "Now exporting picture for group ?0?...\n"},
     {SPEEDTEST_MESSAGE_PICSAVED, "Result picture saved to \"?0?\".\n"},
@@ -69,7 +76,7 @@ LOOKUP_ITEM SPEEDTEST_MESSAGES_RPC[] =
     {SPEEDTEST_MESSAGE_FOUNDSSR, "{\"info\":\"foundssr\"}\n"},
     {SPEEDTEST_MESSAGE_FOUNDTROJAN, "{\"info\":\"foundtrojan\"}\n"},
     {SPEEDTEST_MESSAGE_FOUNDSOCKS, "{\"info\":\"foundsocks\"}\n"},
-    {SPEEDTEST_MESSAGE_FOUNDNETCH, "\"info\":\"foundnetch\"}\n"},
+    {SPEEDTEST_MESSAGE_FOUNDNETCH, "{\"info\":\"foundnetch\"}\n"},
     {SPEEDTEST_MESSAGE_FOUNDSUB, "{\"info\":\"foundsub\"}\n"},
     {SPEEDTEST_MESSAGE_FOUNDLOCAL, "{\"info\":\"foundlocal\"}\n"},
     {SPEEDTEST_MESSAGE_FOUNDUPD, "{\"info\":\"foundupd\"}\n"},
@@ -86,7 +93,7 @@ LOOKUP_ITEM SPEEDTEST_MESSAGES_RPC[] =
     {SPEEDTEST_MESSAGE_GOTUPD, "{\"info\":\"gotupd\",\"id\":?0?,\"ulspeed\":\"?1?\"}\n"},
     {SPEEDTEST_MESSAGE_STARTGPING, "{\"info\":\"startgping\",\"id\":?0?}\n"},
     {SPEEDTEST_MESSAGE_GOTGPING, "{\"info\":\"gotgping\",\"id\":?0?,\"ping\":\"?1?\"}\n"},
-    {SPEEDTEST_MESSAGE_TRAFFIC, "(\"info\":\"traffic\",\"size\":\"?0?\"}\n"},
+    {SPEEDTEST_MESSAGE_TRAFFIC, "{\"info\":\"traffic\",\"size\":\"?0?\"}\n"},
     {SPEEDTEST_MESSAGE_PICSAVING, "{\"info\":\"picsaving\"}\n"},
     {SPEEDTEST_MESSAGE_PICSAVED, "{\"info\":\"picsaved\",\"path\":\"?0?\"}\n"},
     {SPEEDTEST_MESSAGE_PICSAVEDMULTI, "{\"info\":\"picsaved\",\"path\":\"?0?\"}\n"},
@@ -94,6 +101,8 @@ LOOKUP_ITEM SPEEDTEST_MESSAGES_RPC[] =
     {SPEEDTEST_MESSAGE_PARSING, "{\"info\":\"parsing\"}\n"},
     {SPEEDTEST_MESSAGE_BEGIN, "{\"info\":\"begintest\"}\n"},
     {SPEEDTEST_MESSAGE_PICDATA, "{\"info\":\"picdata\",\"data\":\"?0?\"}\n"},
+    {SPEEDTEST_MESSAGE_GOTSAMPLE, "{\"info\":\"sample\",\"id\":?0?,\"phase\":\"?1?\",\"index\":?2?,\"bytes\":?3?}\n"},
+    {SPEEDTEST_MESSAGE_GOTPROBE, "{\"info\":\"probe\",\"id\":?0?,\"type\":\"?1?\",\"index\":?2?,\"ok\":?3?,\"time\":?4?}\n"},
     {SPEEDTEST_ERROR_UNDEFINED, "{\"info\":\"error\",\"reason\":\"undef\"}\n"},
     {SPEEDTEST_ERROR_WSAERR, "{\"info\":\"error\",\"reason\":\"wsaerr\"}\n"},
     {SPEEDTEST_ERROR_SOCKETERR, "{\"info\":\"error\",\"reason\":\"socketerr\"}\n"},
@@ -109,24 +118,144 @@ LOOKUP_ITEM SPEEDTEST_MESSAGES_RPC[] =
     {SPEEDTEST_ERROR_GEOIPERR, "{\"info\":\"error\",\"reason\":\"geoiperr\",\"id\":?0?}\n"}
 };
 
-std::string lookUp(int index, LOOKUP_ITEM *items)
+//messages are indexed by their ID so that every lookup is a single array access
+static std::vector<std::string> buildLookUpTable(const LOOKUP_ITEM *items, size_t count)
 {
-    int i = 0;
-    while (0 <= items[i].index)
+    std::vector<std::string> table;
+    for(size_t i = 0; i < count; i++)
     {
-        if (items[i].index == index)
-            return items[i].info;
-        i++;
+        size_t pos = items[i].index - SPEEDTEST_ERROR_UNDEFINED;
+        if(table.size() <= pos)
+            table.resize(pos + 1);
+        table[pos] = items[i].info;
     }
-    return std::string("");
+    return table;
 }
 
-std::string lookUp(int index, bool rpcmode)
+const std::string &lookUp(int index, bool rpcmode)
 {
-    if(rpcmode)
-        return lookUp(index, SPEEDTEST_MESSAGES_RPC);
-    else
-        return lookUp(index, SPEEDTEST_MESSAGES);
+    static const std::vector<std::string> text_table = buildLookUpTable(SPEEDTEST_MESSAGES, sizeof(SPEEDTEST_MESSAGES) / sizeof(LOOKUP_ITEM));
+    static const std::vector<std::string> rpc_table = buildLookUpTable(SPEEDTEST_MESSAGES_RPC, sizeof(SPEEDTEST_MESSAGES_RPC) / sizeof(LOOKUP_ITEM));
+    static const std::string empty;
+    const std::vector<std::string> &table = rpcmode ? rpc_table : text_table;
+    size_t pos = index - SPEEDTEST_ERROR_UNDEFINED;
+    return pos < table.size() ? table[pos] : empty;
+}
+
+static void escapeJSON(const std::string &str, std::string &dest)
+{
+    static const char hex[] = "0123456789abcdef";
+    for(unsigned char x : str)
+    {
+        switch(x)
+        {
+        case '"':
+            dest += "\\\"";
+            break;
+        case '\\':
+            dest += "\\\\";
+            break;
+        case '\n':
+            dest += "\\n";
+            break;
+        case '\r':
+            dest += "\\r";
+            break;
+        case '\t':
+            dest += "\\t";
+            break;
+        default:
+            if(x < 0x20)
+            {
+                dest += "\\u00";
+                dest += hex[x >> 4];
+                dest += hex[x & 15];
+            }
+            else
+                dest += x;
+        }
+    }
+}
+
+struct rpc_output
+{
+    std::mutex lock;
+    std::string pending;
+    unsigned long long seq = 0;
+    std::chrono::steady_clock::time_point last_flush = std::chrono::steady_clock::now();
+
+    void flush()
+    {
+        if(pending.empty())
+            return;
+        std::cout.write(pending.data(), pending.size());
+        std::cout.clear();
+        std::cout.flush();
+        pending.clear();
+        last_flush = std::chrono::steady_clock::now();
+    }
+
+    ~rpc_output()
+    {
+        flush();
+    }
+};
+
+static rpc_output rpc_out;
+
+//samples and probes may come in bursts, they are sent in batches while everything else goes out at once
+static inline bool isBatchedMsg(int index)
+{
+    return index == SPEEDTEST_MESSAGE_GOTSAMPLE || index == SPEEDTEST_MESSAGE_GOTPROBE;
+}
+
+void printMsgOut(int index, bool rpcmode, const std::vector<std::string> &args)
+{
+    const std::string &format = lookUp(index, rpcmode);
+    if(format.empty())
+        return;
+
+    std::string printout;
+    printout.reserve(format.size() + 64);
+    for(string_size i = 0; i < format.size(); i++)
+    {
+        if(format[i] == '?')
+        {
+            string_size end = format.find('?', i + 1);
+            if(end != format.npos && end > i + 1 && format.find_first_not_of("0123456789", i + 1) == end)
+            {
+                size_t arg_index = std::stoul(format.substr(i + 1, end - i - 1));
+                if(arg_index < args.size())
+                {
+                    if(rpcmode)
+                        escapeJSON(args[arg_index], printout);
+                    else
+                        printout += args[arg_index];
+                    i = end;
+                    continue;
+                }
+            }
+        }
+        printout += format[i];
+    }
+
+    if(!rpcmode)
+    {
+        std::cout<<printout;
+        std::cout.clear();
+        std::cout.flush();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(rpc_out.lock);
+    if(printout[0] == '{')
+    {
+        long long now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+        printout.replace(0, 1, "{\"seq\":" + std::to_string(++rpc_out.seq) + ",\"ts\":" + std::to_string(now) + ",");
+    }
+    rpc_out.pending += printout;
+    if(!isBatchedMsg(index) || rpc_out.pending.size() >= RPC_BATCH_SIZE || std::chrono::steady_clock::now() - rpc_out.last_flush >= std::chrono::milliseconds(RPC_BATCH_INTERVAL))
+        rpc_out.flush();
 }
 
 /*
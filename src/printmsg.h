@@ -9,21 +9,16 @@
 #include "misc.h"
 #include "nodeinfo.h"
 
-std::string lookUp(int index, bool rpcmode);
+const std::string &lookUp(int index, bool rpcmode);
+void printMsgOut(int index, bool rpcmode, const std::vector<std::string> &args);
 
+/**
+*  @brief Print a message with ?N? placeholders replaced by the given arguments.
+*  In RPC mode every message is one NDJSON line with "seq" and "ts" fields, and arguments are JSON-escaped.
+*/
 template <typename... Ts> void printMsg(int index, bool rpcmode, Ts&&... args)
 {
-    const std::vector<std::string> args_vec = {args...};
-    std::string printout = lookUp(index, rpcmode);
-    if(printout.size() == 0)
-        return;
-    for(size_t i = 0; i < args_vec.size(); i++)
-        printout = replace_all_distinct(printout, "?" + std::to_string(i) + "?", args_vec[i]);
-    if(rpcmode)
-        printout = replace_all_distinct(printout, "\\", "\\\\");
-    std::cout<<printout;
-    std::cout.clear();
-    std::cout.flush();
+    printMsgOut(index, rpcmode, {args...});
 }
 
 /*
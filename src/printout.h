@@ -60,7 +60,9 @@ enum
     SPEEDTEST_MESSAGE_FOUNDHTTP,
     SPEEDTEST_MESSAGE_STARTNAT,
     SPEEDTEST_MESSAGE_GOTNAT,
-    SPEEDTEST_MESSAGE_EOF
+    SPEEDTEST_MESSAGE_EOF,
+    SPEEDTEST_MESSAGE_GOTSAMPLE,
+    SPEEDTEST_MESSAGE_GOTPROBE
 };
 
 #define SS_DEFAULT_GROUP "SSProvider"
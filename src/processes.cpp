@@ -16,6 +16,9 @@
 //#include <spawn.h>
 #include <sys/wait.h>
 #endif // _WIN32
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif // __linux__
 
 #include "processes.h"
 
@@ -123,10 +126,13 @@ bool runProgram(std::string command, std::string runpath, bool wait)
     posix_spawn_file_actions_addclose(&file_actions, STDERR_FILENO);
     posix_spawn(&hProc, "/bin/sh", &file_actions, NULL, const_cast<char* const*>(cargs), NULL);
     */
-    command = command + " > /dev/null 2>&1";
+    command = "exec " + command + " > /dev/null 2>&1"; //the client replaces the shell, so signals and the death signal reach it
     //pPipe = popen(command.data(), "r");
     HANDLE pid;
     int status;
+#ifdef __linux__
+    pid_t parent = getpid();
+#endif // __linux__
     switch(pid = fork())
     {
     case -1: /// error
@@ -134,6 +140,11 @@ bool runProgram(std::string command, std::string runpath, bool wait)
     case 0: /// child
     {
         setpgid(0, 0);
+#ifdef __linux__
+        prctl(PR_SET_PDEATHSIG, SIGKILL); //never outlive the process that started it, even when that one is killed
+        if(getppid() != parent)
+            _exit(0);
+#endif // __linux__
         char curdir[1024] = {};
         getcwd(curdir, 1023);
         chdir(runpath.data());
@@ -0,0 +1,360 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <ctime>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+
+#ifdef __linux__
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif // __linux__
+
+#include "procpool.h"
+#include "affinity.h"
+#include "logger.h"
+#include "misc.h"
+#include "printout.h"
+#include "printmsg.h"
+#include "resultfile.h"
+#include "socket.h"
+#include "speedtestutil.h"
+
+//variables from main
+extern int socksport;
+extern std::string client_config;
+extern bool rpcmode;
+extern unsigned int node_count;
+
+//functions from main
+int singleTest(nodeInfo &node, bool screen);
+
+#ifdef __linux__
+
+static void poolPrintResult(nodeInfo &node)
+{
+    std::string id = std::to_string(node.id + (rpcmode ? 0 : 1));
+    if(!rpcmode)
+        printMsg(SPEEDTEST_MESSAGE_GOTSERVER, rpcmode, id, node.group, node.remarks, std::to_string(node_count));
+    printMsg(SPEEDTEST_MESSAGE_GOTPING, rpcmode, id, node.avgPing);
+    printMsg(SPEEDTEST_MESSAGE_GOTGPING, rpcmode, id, node.sitePing);
+    printMsg(SPEEDTEST_MESSAGE_GOTSPEED, rpcmode, id, node.avgSpeed);
+    printMsg(SPEEDTEST_MESSAGE_GOTUPD, rpcmode, id, node.ulSpeed);
+    printMsg(SPEEDTEST_MESSAGE_GOTRESULT, rpcmode, node.avgSpeed, node.maxSpeed, node.ulSpeed, node.pkLoss, node.avgPing, node.sitePing, node.natType.get());
+}
+
+struct poolWorker
+{
+    int slot = 0;
+    int port = 0; //local port of the client started by this child
+    pid_t pid = -1;
+    int fd = -1;
+    long index = -1; //node being tested, -1 when idle
+    time_t started = 0;
+    std::string buffer;
+    unsigned int tested = 0, replaced = 0;
+    bool send_failed = false; //the last job never reached the child
+};
+
+//request: uint32 node index, reply: uint32 node index + uint32 length + result file with that one node
+static bool poolWriteAll(int fd, const void *data, size_t len)
+{
+    const char *ptr = static_cast<const char*>(data);
+    while(len)
+    {
+        ssize_t ret = write(fd, ptr, len);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return false;
+        ptr += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+static bool poolReadAll(int fd, void *data, size_t len)
+{
+    char *ptr = static_cast<char*>(data);
+    while(len)
+    {
+        ssize_t ret = read(fd, ptr, len);
+        if(ret < 0 && errno == EINTR)
+            continue;
+        if(ret <= 0)
+            return false;
+        ptr += ret;
+        len -= ret;
+    }
+    return true;
+}
+
+[[noreturn]] static void poolChildRoutine(std::vector<nodeInfo> &nodes, poolWorker &worker)
+{
+    logAfterFork();
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGHUP, SIG_DFL);
+    signal(SIGQUIT, SIG_DFL);
+    //results go back to the parent, console messages would only be printed twice
+    int devnull = open("/dev/null", O_WRONLY);
+    if(devnull >= 0)
+    {
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        close(devnull);
+    }
+    int parent_port = socksport;
+    socksport = worker.port;
+    client_config = "config_" + std::to_string(worker.slot) + ".json";
+    //the slot table is copied from the parent with every slot free, which would put all workers on slot 0
+    affinityKeepSlot(worker.slot);
+
+    uint32_t index, header[2];
+    while(poolReadAll(worker.fd, &index, sizeof(index)) && index < nodes.size())
+    {
+        nodeInfo &node = nodes[index];
+        node.proxyStr = rebindLocalPort(node.proxyStr, parent_port, worker.port);
+        singleTest(node, false);
+        std::vector<nodeInfo> result = {node};
+        std::string data = resultFileBuild(result, "");
+        header[0] = index;
+        header[1] = data.size();
+        if(!poolWriteAll(worker.fd, header, sizeof(header)) || !poolWriteAll(worker.fd, data.data(), data.size()))
+            break;
+    }
+    remove(client_config.data());
+    _exit(0);
+}
+
+static bool poolSpawn(std::vector<nodeInfo> &nodes, std::vector<poolWorker> &workers, poolWorker &worker)
+{
+    int sv[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+    {
+        writeLog(LOG_TYPE_ERROR, "Process pool: cannot create socket pair for slot " + std::to_string(worker.slot) + ".");
+        return false;
+    }
+    pid_t pid = fork();
+    if(pid < 0)
+    {
+        writeLog(LOG_TYPE_ERROR, "Process pool: cannot fork slot " + std::to_string(worker.slot) + ".");
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+    if(pid == 0)
+    {
+        //other children must see EOF as soon as the parent closes their end
+        for(poolWorker &x : workers)
+        {
+            if(x.fd >= 0)
+                close(x.fd);
+        }
+        close(sv[0]);
+        worker.fd = sv[1];
+        poolChildRoutine(nodes, worker);
+    }
+    close(sv[1]);
+    worker.pid = pid;
+    worker.fd = sv[0];
+    worker.index = -1;
+    worker.buffer.clear();
+    return true;
+}
+
+//the client of a killed child goes with it, see runProgram()
+static void poolKill(poolWorker &worker)
+{
+    if(worker.fd >= 0)
+        close(worker.fd);
+    if(worker.pid > 0)
+    {
+        kill(worker.pid, SIGKILL);
+        waitpid(worker.pid, NULL, 0);
+    }
+    worker.fd = -1;
+    worker.pid = -1;
+}
+
+static void poolReplace(std::vector<nodeInfo> &nodes, std::vector<poolWorker> &workers, poolWorker &worker)
+{
+    poolKill(worker);
+    worker.index = -1;
+    worker.replaced++;
+    poolSpawn(nodes, workers, worker);
+}
+
+//only for a node the child really had under test
+static void poolFail(std::vector<nodeInfo> &nodes, std::vector<poolWorker> &workers, poolWorker &worker, const std::string &reason)
+{
+    nodeInfo &node = nodes[worker.index];
+    writeLog(LOG_TYPE_ERROR, "Process pool: slot " + std::to_string(worker.slot) + " " + reason + " while testing " + node.group + " - " + node.remarks + ", replacing it.");
+    node.online = false;
+    poolPrintResult(node);
+    poolReplace(nodes, workers, worker);
+}
+
+//returns true when the node of this worker is finished
+static bool poolReceive(std::vector<nodeInfo> &nodes, poolWorker &worker)
+{
+    uint32_t header[2];
+    if(worker.buffer.size() < sizeof(header))
+        return false;
+    memcpy(header, worker.buffer.data(), sizeof(header));
+    if(worker.buffer.size() < sizeof(header) + header[1])
+        return false;
+    std::string data = worker.buffer.substr(sizeof(header), header[1]);
+    worker.buffer.erase(0, sizeof(header) + header[1]);
+
+    nodeInfo &node = nodes[worker.index];
+    resultFileReader reader;
+    std::vector<nodeInfo> results;
+    if(header[0] != worker.index || reader.load(data) != 0 || resultFileLoad(reader, results) != 0 || results.size() != 1)
+    {
+        writeLog(LOG_TYPE_ERROR, "Process pool: slot " + std::to_string(worker.slot) + " sent an unreadable result for " + node.group + " - " + node.remarks + ".");
+        node.online = false;
+    }
+    else
+    {
+        //identity stays the parent's, everything measured comes from the child, GeoIP included
+        nodeInfo &result = results[0];
+        result.linkType = node.linkType;
+        result.id = node.id;
+        result.groupID = node.groupID;
+        result.server = node.server;
+        result.port = node.port;
+        result.proxyStr = node.proxyStr;
+        node = result;
+    }
+    poolPrintResult(node);
+    worker.index = -1;
+    worker.tested++;
+    worker.send_failed = false;
+    return true;
+}
+
+int processPoolTest(std::vector<nodeInfo> &nodes, int workers, int timeout)
+{
+    std::vector<poolWorker> pool(std::min<size_t>(workers, nodes.size()));
+    std::deque<size_t> pending;
+    size_t finished = 0;
+    int port = socksport;
+    timeout = std::max(timeout, 10);
+    for(size_t i = 0; i < nodes.size(); i++)
+        pending.push_back(i);
+    for(size_t i = 0; i < pool.size(); i++)
+    {
+        port = checkPort(port + 1);
+        pool[i].slot = i;
+        pool[i].port = port;
+        if(!poolSpawn(nodes, pool, pool[i]))
+            break;
+    }
+    writeLog(LOG_TYPE_INFO, "Process pool: testing " + std::to_string(nodes.size()) + " node(s) in " + std::to_string(pool.size()) + " process(es).");
+
+    std::vector<pollfd> fds;
+    std::vector<poolWorker*> polled;
+    while(finished < nodes.size())
+    {
+        for(poolWorker &x : pool)
+        {
+            if(x.fd < 0 || x.index >= 0 || pending.empty())
+                continue;
+            uint32_t index = pending.front();
+            x.index = index;
+            x.started = time(NULL);
+            pending.pop_front();
+            if(!poolWriteAll(x.fd, &index, sizeof(index)))
+            {
+                //the node was never tested, it goes back to the queue
+                pending.push_front(index);
+                if(x.send_failed)
+                {
+                    writeLog(LOG_TYPE_ERROR, "Process pool: slot " + std::to_string(x.slot) + " stopped again before taking a node, giving it up.");
+                    poolKill(x);
+                    x.index = -1;
+                    continue;
+                }
+                writeLog(LOG_TYPE_ERROR, "Process pool: slot " + std::to_string(x.slot) + " stopped before taking a node, replacing it.");
+                x.send_failed = true;
+                poolReplace(nodes, pool, x);
+            }
+        }
+        fds.clear();
+        polled.clear();
+        for(poolWorker &x : pool)
+        {
+            if(x.fd < 0 || x.index < 0)
+                continue;
+            fds.push_back({x.fd, POLLIN, 0});
+            polled.push_back(&x);
+        }
+        if(fds.empty())
+            break;
+        if(poll(fds.data(), fds.size(), 1000) < 0 && errno != EINTR)
+            break;
+
+        time_t now = time(NULL);
+        for(size_t i = 0; i < fds.size(); i++)
+        {
+            poolWorker &x = *polled[i];
+            if(fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                char buffer[16384];
+                ssize_t len = read(x.fd, buffer, sizeof(buffer));
+                if(len < 0 && errno == EINTR)
+                    continue;
+                if(len <= 0)
+                {
+                    poolFail(nodes, pool, x, "exited");
+                    finished++;
+                    continue;
+                }
+                x.buffer.append(buffer, len);
+                if(poolReceive(nodes, x))
+                    finished++;
+            }
+            else if(now - x.started > timeout)
+            {
+                poolFail(nodes, pool, x, "made no progress for " + std::to_string(timeout) + "s");
+                finished++;
+            }
+        }
+    }
+
+    //children leave when their socket is closed
+    for(poolWorker &x : pool)
+    {
+        writeLog(LOG_TYPE_INFO, "Process pool: slot " + std::to_string(x.slot) + " tested " + std::to_string(x.tested) + " node(s), replaced " + std::to_string(x.replaced) + " time(s).");
+        if(x.fd >= 0)
+            close(x.fd);
+    }
+    if(pending.size())
+    {
+        writeLog(LOG_TYPE_WARN, "Process pool: no process left, testing the remaining " + std::to_string(pending.size()) + " node(s) here.");
+        for(size_t x : pending)
+            singleTest(nodes[x], false);
+    }
+    return 0;
+}
+
+#else
+
+int processPoolTest(std::vector<nodeInfo> &nodes, int workers, int timeout)
+{
+    writeLog(LOG_TYPE_WARN, "Process pool is only available on Linux, testing in this process.");
+    for(nodeInfo &x : nodes)
+        singleTest(x, false);
+    return 0;
+}
+
+#endif // __linux__
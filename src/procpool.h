@@ -0,0 +1,18 @@
+#ifndef PROCPOOL_H_INCLUDED
+#define PROCPOOL_H_INCLUDED
+
+#include <vector>
+
+#include "nodeinfo.h"
+
+/*
+Process pool: nodes are tested in pre-forked child processes, so a client or library crash only loses the node
+being tested. Children inherit the node list and receive node indices over a socket pair, each one tests through
+its own local port and config file and answers with the node as a binary result file. A child that dies or stays
+on one node for longer than the timeout is killed together with its client, the node is left untested and a new
+child takes the slot. Only available on Linux, elsewhere the nodes are tested in this process.
+*/
+
+int processPoolTest(std::vector<nodeInfo> &nodes, int workers, int timeout);
+
+#endif // PROCPOOL_H_INCLUDED
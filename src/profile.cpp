@@ -0,0 +1,88 @@
+#include <string>
+#include <algorithm>
+
+#include "profile.h"
+#include "ini_reader.h"
+
+//"standard" is whatever the classic options in pref.ini describe, "quick" and "deep" replace every option of it
+bool testProfilePreset(const std::string &name, const testProfile &standard, testProfile &profile)
+{
+    profile = standard;
+    profile.name = name;
+    if(name == "standard")
+        return true;
+    if(name == "quick") //enough to sort out dead and slow nodes of a large subscription
+    {
+        profile.speedtest_mode = "all";
+        profile.site_ping = false;
+        profile.upload = false;
+        profile.nat_type = false;
+        profile.load_test = false;
+        profile.page_load = false;
+        profile.tcping_count = 3;
+        profile.site_ping_count = 3;
+        profile.site_ping_fail_limit = 1;
+        profile.download_time = 3;
+        profile.download_threads = 2;
+        profile.connect_timeout = 2000;
+        profile.socket_timeout = 3000;
+        profile.node_timeout = 20;
+        return true;
+    }
+    if(name == "deep")
+    {
+        profile.speedtest_mode = "all";
+        profile.site_ping = true;
+        profile.upload = true;
+        profile.nat_type = true;
+        profile.load_test = true;
+        profile.page_load = true;
+        profile.tcping_count = 6;
+        profile.site_ping_count = 10;
+        profile.site_ping_fail_limit = 4;
+        profile.download_time = 10;
+        profile.download_threads = 8;
+        profile.connect_timeout = 5000;
+        profile.socket_timeout = 10000;
+        profile.node_timeout = 120;
+        return true;
+    }
+    profile.name = "standard";
+    return false;
+}
+
+//reads the options of the current section over the given profile, the result arrays limit the counts
+void testProfileRead(INIReader &ini, testProfile &profile)
+{
+    ini.GetIfExist("speedtest_mode", profile.speedtest_mode);
+    ini.GetBoolIfExist("test_site_ping", profile.site_ping);
+    ini.GetBoolIfExist("test_upload", profile.upload);
+    ini.GetBoolIfExist("test_nat_type", profile.nat_type);
+    ini.GetBoolIfExist("test_load", profile.load_test);
+    ini.GetBoolIfExist("test_page_load", profile.page_load);
+    ini.GetIntIfExist("tcping_count", profile.tcping_count);
+    ini.GetIntIfExist("site_ping_count", profile.site_ping_count);
+    ini.GetIntIfExist("site_ping_fail_limit", profile.site_ping_fail_limit);
+    ini.GetIntIfExist("download_time", profile.download_time);
+    ini.GetIntIfExist("thread_count", profile.download_threads);
+    ini.GetIntIfExist("connect_timeout", profile.connect_timeout);
+    ini.GetIntIfExist("socket_timeout", profile.socket_timeout);
+    ini.GetIntIfExist("node_timeout", profile.node_timeout);
+    profile.tcping_count = std::clamp(profile.tcping_count, 1, 6);
+    profile.site_ping_count = std::clamp(profile.site_ping_count, 1, 10);
+    profile.site_ping_fail_limit = std::max(profile.site_ping_fail_limit, 1);
+    profile.download_time = std::clamp(profile.download_time, 1, 10);
+    profile.download_threads = std::max(profile.download_threads, 1);
+    profile.connect_timeout = std::max(profile.connect_timeout, 100);
+    profile.socket_timeout = std::max(profile.socket_timeout, 100);
+    profile.node_timeout = std::max(profile.node_timeout, 0);
+}
+
+std::string testProfileString(const testProfile &profile)
+{
+    return profile.name + ": mode=" + profile.speedtest_mode + " site_ping=" + (profile.site_ping ? "true" : "false") + " upload=" + (profile.upload ? "true" : "false") +
+           " nat_type=" + (profile.nat_type ? "true" : "false") + " load_test=" + (profile.load_test ? "true" : "false") +
+           " page_load=" + (profile.page_load ? "true" : "false") + " tcping_count=" + std::to_string(profile.tcping_count) + " site_ping_count=" + std::to_string(profile.site_ping_count) +
+           " download_time=" + std::to_string(profile.download_time) + "s threads=" + std::to_string(profile.download_threads) +
+           " connect_timeout=" + std::to_string(profile.connect_timeout) + "ms socket_timeout=" + std::to_string(profile.socket_timeout) + "ms node_timeout=" + std::to_string(profile.node_timeout) + "s";
+}
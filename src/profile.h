@@ -0,0 +1,32 @@
+#ifndef PROFILE_H_INCLUDED
+#define PROFILE_H_INCLUDED
+
+#include <string>
+
+#include "ini_reader.h"
+
+//how long and how thoroughly every node is tested, selected by name
+struct testProfile
+{
+    std::string name = "standard";
+    std::string speedtest_mode = "all";
+    bool site_ping = true;
+    bool upload = false;
+    bool nat_type = true;
+    bool load_test = false;
+    bool page_load = false;
+    int tcping_count = 6; //at most 6
+    int site_ping_count = 10; //at most 10
+    int site_ping_fail_limit = 2;
+    int download_time = 10; //seconds, at most 10
+    int download_threads = 4;
+    int connect_timeout = 3000; //milliseconds
+    int socket_timeout = 5000; //milliseconds
+    int node_timeout = 60; //seconds for everything done on one node, 0 for no limit
+};
+
+bool testProfilePreset(const std::string &name, const testProfile &standard, testProfile &profile);
+void testProfileRead(INIReader &ini, testProfile &profile);
+std::string testProfileString(const testProfile &profile);
+
+#endif // PROFILE_H_INCLUDED
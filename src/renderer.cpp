@@ -281,6 +281,13 @@ void loadDefaultColor(std::string type)
     }
 }
 
+//rows of a tournament that only went through the screen stage and rows reused from an earlier run are marked, the footer explains the marks
+static inline std::string rowRemarks(const nodeInfo &node)
+{
+    std::string remarks = node.screenOnly ? node.remarks + " *" : node.remarks;
+    return node.cachedTime ? remarks + " +" : remarks;
+}
+
 #ifndef _FAST_RENDER
 
 std::string exportRender(std::string resultpath, std::vector<nodeInfo> &nodes, bool export_with_maxSpeed, std::string export_sort_method, std::string export_color_style, bool export_as_new_style, bool export_nat_type)
@@ -354,7 +361,7 @@ std::string exportRender(std::string resultpath, std::vector<nodeInfo> &nodes, b
     nodes.insert(nodes.begin(), node);
 
     //calculate the width of all columns
-    int group_width = 0, remarks_width = 0, pkLoss_width = 0, avgPing_width = 0, avgSpeed_width = 0, sitePing_width = 0, maxSpeed_width = 0, nattype_width = 0, onlines = 0, final_width = 0, test_duration = 0;
+    int group_width = 0, remarks_width = 0, pkLoss_width = 0, avgPing_width = 0, avgSpeed_width = 0, sitePing_width = 0, maxSpeed_width = 0, nattype_width = 0, onlines = 0, final_width = 0, test_duration = 0, screened = 0, reused = 0;
     std::vector<int> group_widths, remarks_widths, pkLoss_widths, avgPing_widths, avgSpeed_widths, sitePing_widths, maxSpeed_widths, nattype_widths;
     long long total_traffic = 0;
     std::string longest_group, longest_remarks;
@@ -372,9 +379,9 @@ std::string exportRender(std::string resultpath, std::vector<nodeInfo> &nodes, b
             longest_group = nodes[i].group;
             longest_group_len = getTextLength(longest_group);
         }
-        if(getTextLength(nodes[i].remarks) > longest_remarks_len)
+        if(getTextLength(rowRemarks(nodes[i])) > longest_remarks_len)
         {
-            longest_remarks = nodes[i].remarks;
+            longest_remarks = rowRemarks(nodes[i]);
             longest_remarks_len = getTextLength(longest_remarks);
         }
         if(i == 0)
@@ -413,10 +420,17 @@ std::string exportRender(std::string resultpath, std::vector<nodeInfo> &nodes, b
         if(export_nat_type)
             nattype_width = std::max(nattype_widths[i] + center_align_offset, nattype_width);
 
-        total_traffic += nodes[i].totalRecvBytes;
-        test_duration += nodes[i].duration;
+        if(!nodes[i].cachedTime)
+        {
+            total_traffic += nodes[i].totalRecvBytes + (nodes[i].screenOnly ? 0 : nodes[i].screenTraffic);
+            test_duration += nodes[i].duration;
+        }
         if(nodes[i].online)
             onlines++;
+        if(nodes[i].screenOnly)
+            screened++;
+        if(nodes[i].cachedTime)
+            reused++;
     }
     //only calculate the width of the group/remark title line
     remarks_widths.push_back(getWidth(&png, font, fontsize, node.remarks));
@@ -449,6 +463,10 @@ std::string exportRender(std::string resultpath, std::vector<nodeInfo> &nodes, b
             traffic += "Time used : " + secondToString(test_duration) + ". ";
         traffic += "Working Node(s) : [" + std::to_string(onlines) + "/" + std::to_string(node_count) + "]";
     }
+    if(screened)
+        traffic += ". * Screen test only";
+    if(reused)
+        traffic += ". + Reused from an earlier run";
 
     final_width = total_width;
     final_width = std::max(getWidth(&png, font, fontsize, gentime) + center_align_offset, final_width);
@@ -500,7 +518,7 @@ std::string exportRender(std::string resultpath, std::vector<nodeInfo> &nodes, b
         //remarks
         //don't align remarks except title
         if(i > 0)
-            plot_text_utf8(&png, font, fontsize, this_x_offset, this_y_offset, 0.0, nodes[i].remarks, text_red, text_green, text_blue);
+            plot_text_utf8(&png, font, fontsize, this_x_offset, this_y_offset, 0.0, rowRemarks(nodes[i]), text_red, text_green, text_blue);
         else
             plot_text_utf8(&png, font, fontsize, this_x_offset + calcCenterOffset(remarks_widths[i], remarks_width), this_y_offset, 0.0, nodes[i].remarks, text_red, text_green, text_blue);
         j++;
@@ -628,7 +646,7 @@ std::string exportRender(std::string resultpath, vector<nodeInfo> nodes, bool ex
     nodes.insert(nodes.begin(), node);
 
     //calculate the width of all columns
-    int group_width = 0, remarks_width = 0, pkLoss_width = 0, avgPing_width = 0, avgSpeed_width = 0, /* sitePing_width = 0, */maxSpeed_width = 0, onlines = 0, final_width = 0;
+    int group_width = 0, remarks_width = 0, pkLoss_width = 0, avgPing_width = 0, avgSpeed_width = 0, /* sitePing_width = 0, */maxSpeed_width = 0, onlines = 0, final_width = 0, screened = 0, reused = 0;
     std::string longest_group, longest_remarks, longest_pkLoss, longest_avgPing, longest_avgSpeed, /*longest_sitePing,*/longest_maxSpeed;
     long long total_traffic = 0;
     for(int i = 0; i <= node_count; i++)
@@ -636,8 +654,8 @@ std::string exportRender(std::string resultpath, vector<nodeInfo> nodes, bool ex
         //find the longest string
         if(getTextLength(nodes[i].group) > getTextLength(longest_group))
             longest_group = nodes[i].group;
-        if(getTextLength(nodes[i].remarks) > getTextLength(longest_remarks))
-            longest_remarks = nodes[i].remarks;
+        if(getTextLength(rowRemarks(nodes[i])) > getTextLength(longest_remarks))
+            longest_remarks = rowRemarks(nodes[i]);
         if(getTextLength(nodes[i].pkLoss) > getTextLength(longest_pkLoss))
             longest_pkLoss = nodes[i].pkLoss;
         if(getTextLength(nodes[i].avgPing) > getTextLength(longest_avgPing))
@@ -649,9 +667,14 @@ std::string exportRender(std::string resultpath, vector<nodeInfo> nodes, bool ex
             if(getTextLength(nodes[i].maxSpeed) > getTextLength(longest_maxSpeed))
                 longest_maxSpeed = nodes[i].maxSpeed;
         }
-        total_traffic += nodes[i].totalRecvBytes;
+        if(!nodes[i].cachedTime)
+            total_traffic += nodes[i].totalRecvBytes + (nodes[i].screenOnly ? 0 : nodes[i].screenTraffic);
         if(nodes[i].online)
             onlines++;
+        if(nodes[i].screenOnly)
+            screened++;
+        if(nodes[i].cachedTime)
+            reused++;
     }
     //calculate the width of the longest string
     group_width = getWidth(&png, font, fontsize, longest_group) + center_align_offset;
@@ -671,6 +694,10 @@ std::string exportRender(std::string resultpath, vector<nodeInfo> nodes, bool ex
     //generating information
     std::string gentime = "Generated at "+getTime(3);
     std::string traffic = "Traffic used : "+speedCalc((double)total_traffic)+". Working Node(s) : ["+std::to_string(onlines)+"/"+std::to_string(node_count)+"]";
+    if(screened)
+        traffic += ". * Screen test only";
+    if(reused)
+        traffic += ". + Reused from an earlier run";
     std::string about = "By Stair Speedtest Reborn " VERSION ".";
 
     final_width = max(getWidth(&png, font, fontsize, gentime) + center_align_offset, total_width);
@@ -709,7 +736,7 @@ std::string exportRender(std::string resultpath, vector<nodeInfo> nodes, bool ex
         png.line(line_offset, line_index * height_line + 1, line_offset, (line_index + 1) * height_line, border_red, border_green, border_blue);//right side
         this_x_offset += width_all[j];
         //remarks
-        plot_text_utf8(&png, font, fontsize, this_x_offset, this_y_offset, 0.0, nodes[i].remarks, text_red, text_green, text_blue);
+        plot_text_utf8(&png, font, fontsize, this_x_offset, this_y_offset, 0.0, rowRemarks(nodes[i]), text_red, text_green, text_blue);
         j++;
         line_offset += width_all[j];
         png.line(line_offset, line_index * height_line + 1, line_offset, (line_index + 1) * height_line, border_red, border_green, border_blue);//right side
@@ -0,0 +1,214 @@
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <mutex>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+#include "resultcache.h"
+#include "history.h"
+#include "logger.h"
+#include "misc.h"
+#include "resultfile.h"
+
+#define RESULTCACHE_DIR "history"
+#define RESULTCACHE_PATH RESULTCACHE_DIR PATH_SLASH "cache.dat"
+
+/*
+Cache file layout, all values in host byte order:
+    magic, version, entry count
+    entries, one per cached node
+    a binary result file with the cached nodes, in entry order
+*/
+
+struct resultCacheEntry
+{
+    uint64_t key = 0; //historyNodeKey()
+    int64_t time = 0; //unix time of the run
+    uint64_t setup = 0; //resultCacheSetup() of the run, since version 2
+};
+
+static const char resultcache_magic[8] = {'S', 'S', 'T', 'C', 'A', 'C', 'H', '\0'};
+static const uint32_t resultcache_version = 2;
+static const size_t resultcache_header_size = 16;
+
+static_assert(sizeof(resultCacheEntry) == 24, "cache entry layout changed, bump resultcache_version");
+
+typedef std::lock_guard<std::mutex> guarded_mutex;
+static std::mutex resultcache_mutex;
+
+static int resultCacheLoad(std::vector<resultCacheEntry> &entries, std::vector<nodeInfo> &nodes)
+{
+    std::string data = fileGet(RESULTCACHE_PATH);
+    if(data.empty())
+        return -1;
+    uint32_t version = 0, count = 0;
+    if(data.size() >= resultcache_header_size)
+    {
+        memcpy(&version, data.data() + 8, sizeof(version));
+        memcpy(&count, data.data() + 12, sizeof(count));
+    }
+    if(data.size() < resultcache_header_size + count * sizeof(resultCacheEntry) || memcmp(data.data(), resultcache_magic, sizeof(resultcache_magic)) != 0 || version != resultcache_version)
+    {
+        writeLog(LOG_TYPE_WARN, "Result cache has an unknown format. Ignoring.");
+        return -1;
+    }
+    entries.resize(count);
+    memcpy(entries.data(), data.data() + resultcache_header_size, count * sizeof(resultCacheEntry));
+
+    resultFileReader reader;
+    if(reader.load(data.substr(resultcache_header_size + count * sizeof(resultCacheEntry))) != 0 || resultFileLoad(reader, nodes) != 0 || nodes.size() != count)
+    {
+        writeLog(LOG_TYPE_WARN, "Result cache is damaged. Ignoring.");
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t resultCacheSetup(const std::string &mode, const std::string &profile)
+{
+    return hash_(mode + "|" + profile);
+}
+
+//standard deviation over mean, values that are all zero were never measured and count as unstable
+static double resultCacheVariation(const std::vector<double> &values)
+{
+    double mean = std::accumulate(values.begin(), values.end(), 0.0) / values.size(), sum = 0.0;
+    if(mean <= 0.0)
+        return HUGE_VAL;
+    for(double x : values)
+        sum += (x - mean) * (x - mean);
+    return std::sqrt(sum / values.size()) / mean;
+}
+
+//ping-only runs record no speed, so only their pings are compared
+static bool resultCacheStable(uint64_t key, int64_t cached_time, bool check_speed, const resultCacheConfig &config)
+{
+    std::vector<historyRecord> records;
+    size_t runs = std::max(config.min_runs, 1u);
+    if(historyNodeRecords(key, 0, 0, records) != 0 || records.size() < runs)
+        return false;
+    if(records.back().time > cached_time) //tested since, the cached result is not the latest one
+        return false;
+    records.erase(records.begin(), records.end() - runs);
+
+    std::vector<double> speeds, pings;
+    for(historyRecord &x : records)
+    {
+        if(!(x.flags & HISTORY_FLAG_ONLINE))
+            continue;
+        speeds.push_back(x.avg_speed);
+        pings.push_back(x.avg_ping);
+    }
+    if(speeds.empty()) //offline every time
+        return true;
+    if(speeds.size() != records.size())
+        return false;
+    return (!check_speed || resultCacheVariation(speeds) <= config.max_variation) && resultCacheVariation(pings) <= config.max_variation;
+}
+
+int resultCacheApply(std::vector<nodeInfo> &nodes, const resultCacheConfig &config, const std::string &mode, const std::string &profile)
+{
+    if(config.max_age <= 0)
+        return 0;
+    guarded_mutex guard(resultcache_mutex);
+    std::vector<resultCacheEntry> entries;
+    std::vector<nodeInfo> cached;
+    if(resultCacheLoad(entries, cached) != 0)
+        return 0;
+    std::unordered_map<uint64_t, size_t> index;
+    for(size_t i = 0; i < entries.size(); i++)
+        index[entries[i].key] = i;
+
+    time_t now = time(NULL);
+    uint64_t setup = resultCacheSetup(mode, profile);
+    int reused = 0;
+    for(nodeInfo &x : nodes)
+    {
+        if(x.proxyStr == "LOG")
+            continue;
+        uint64_t key = historyNodeKey(x);
+        auto iter = index.find(key);
+        if(iter == index.end())
+            continue;
+        const resultCacheEntry &entry = entries[iter->second];
+        if(entry.setup != setup || now - entry.time > config.max_age || !resultCacheStable(key, entry.time, mode != "pingonly", config))
+            continue;
+        //identity comes from the current subscription, everything measured from the cached run, GeoIP included
+        nodeInfo result = cached[iter->second];
+        result.linkType = x.linkType;
+        result.id = x.id;
+        result.groupID = x.groupID;
+        result.group = x.group;
+        result.remarks = x.remarks;
+        result.server = x.server;
+        result.port = x.port;
+        result.proxyStr = x.proxyStr;
+        result.cachedTime = entry.time;
+        x = result;
+        reused++;
+    }
+    writeLog(LOG_TYPE_INFO, "Result cache: reusing " + std::to_string(reused) + " of " + std::to_string(nodes.size()) + " node(s).");
+    return reused;
+}
+
+int resultCacheStore(std::vector<nodeInfo> &nodes, const resultCacheConfig &config, const std::string &mode, const std::string &profile)
+{
+    if(config.max_age <= 0)
+        return 0;
+    guarded_mutex guard(resultcache_mutex);
+    std::vector<resultCacheEntry> entries, saved_entries;
+    std::vector<nodeInfo> cached, saved;
+    std::unordered_map<uint64_t, size_t> index;
+    time_t now = time(NULL);
+    resultCacheLoad(entries, cached);
+
+    for(nodeInfo &x : nodes)
+    {
+        if(x.proxyStr == "LOG" || x.cachedTime) //nothing new to store
+            continue;
+        if(x.screenOnly) //not a full result
+            continue;
+        resultCacheEntry entry;
+        entry.key = historyNodeKey(x);
+        entry.time = now;
+        entry.setup = resultCacheSetup(mode, profile);
+        auto iter = index.find(entry.key);
+        if(iter != index.end())
+        {
+            saved_entries[iter->second] = entry;
+            saved[iter->second] = x;
+            continue;
+        }
+        index[entry.key] = saved.size();
+        saved_entries.push_back(entry);
+        saved.push_back(x);
+    }
+    //keep what is still fresh of the older entries
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        if(now - entries[i].time > config.max_age || index.count(entries[i].key))
+            continue;
+        index[entries[i].key] = saved.size();
+        saved_entries.push_back(entries[i]);
+        saved.push_back(std::move(cached[i]));
+    }
+
+    std::string data(resultcache_header_size, '\0');
+    uint32_t count = saved.size();
+    memcpy(&data[0], resultcache_magic, sizeof(resultcache_magic));
+    memcpy(&data[8], &resultcache_version, sizeof(resultcache_version));
+    memcpy(&data[12], &count, sizeof(count));
+    data.append(reinterpret_cast<const char*>(saved_entries.data()), count * sizeof(resultCacheEntry));
+    data += resultFileBuild(saved, "");
+    makeDir(RESULTCACHE_DIR);
+    if(fileWrite(RESULTCACHE_PATH, data, true) != 0)
+    {
+        writeLog(LOG_TYPE_ERROR, "Cannot write result cache.");
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef RESULTCACHE_H_INCLUDED
+#define RESULTCACHE_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "nodeinfo.h"
+
+/*
+Result cache: the latest full result of every node, keyed by the same endpoint identity as the history store.
+A node is not tested again while its cached result is younger than max_age and its last runs in the history
+store agree with each other: all offline, or all online with speed and ping varying by no more than
+max_variation (standard deviation over mean). Reused nodes carry the time of the run they come from.
+A result is only reused by a run with the same speedtest mode and test profile, and screen-only results of a
+tournament are never cached.
+*/
+
+struct resultCacheConfig
+{
+    int max_age = 0; //seconds, 0 disables the cache
+    unsigned int min_runs = 3; //history runs needed to judge stability
+    double max_variation = 0.2;
+};
+
+//mode is the speedtest mode, profile the testProfileString() of the test profile in use
+int resultCacheApply(std::vector<nodeInfo> &nodes, const resultCacheConfig &config, const std::string &mode, const std::string &profile);
+int resultCacheStore(std::vector<nodeInfo> &nodes, const resultCacheConfig &config, const std::string &mode, const std::string &profile);
+
+#endif // RESULTCACHE_H_INCLUDED
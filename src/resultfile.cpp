@@ -0,0 +1,573 @@
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include <ctime>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif // _WIN32
+
+#include <rapidjson/writer.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "resultfile.h"
+#include "ini_reader.h"
+#include "logger.h"
+#include "misc.h"
+
+static const char resultfile_magic[8] = {'S', 'S', 'T', 'R', 'E', 'S', 'U', 'L'};
+static const uint32_t resultfile_version = 1;
+
+static_assert(sizeof(resultFileHeader) == 80, "result file header layout changed");
+static_assert(sizeof(resultFileRecord) == 264, "result file record layout changed, bump resultfile_version");
+
+static std::string joinMirrors(const std::vector<std::string> &mirrors)
+{
+    std::string result;
+    for(const std::string &x : mirrors)
+        result += (result.empty() ? "" : "|") + x;
+    return result;
+}
+
+//every field in declaration order, so that workers and cached runs keep the location of a node
+static std::string joinGeoIP(const geoIPInfo &info)
+{
+    const std::string *fields[] = {&info.ip, &info.country_code, &info.country, &info.region_code, &info.region, &info.city, &info.postal_code,
+                                   &info.continent_code, &info.latitude, &info.longitude, &info.organization, &info.asn, &info.timezone};
+    std::string result;
+    bool empty = true;
+    for(const std::string *x : fields)
+    {
+        empty = empty && x->empty();
+        result += (x == fields[0] ? "" : "\n") + *x;
+    }
+    return empty ? std::string() : result;
+}
+
+static geoIPInfo splitGeoIP(std::string_view data)
+{
+    geoIPInfo info;
+    std::string *fields[] = {&info.ip, &info.country_code, &info.country, &info.region_code, &info.region, &info.city, &info.postal_code,
+                             &info.continent_code, &info.latitude, &info.longitude, &info.organization, &info.asn, &info.timezone};
+    for(std::string *x : fields)
+    {
+        if(data.empty())
+            break;
+        std::string_view::size_type pos = data.find('\n');
+        x->assign(data.substr(0, pos));
+        data.remove_prefix(pos == data.npos ? data.size() : pos + 1);
+    }
+    return info;
+}
+
+static inline uint64_t resultFileAlign(uint64_t offset)
+{
+    return (offset + 7) & ~7ULL;
+}
+
+resultFileReader::~resultFileReader()
+{
+    close();
+}
+
+int resultFileReader::open(const std::string &path)
+{
+    close();
+#ifdef _WIN32
+    _buffer = fileGet(path);
+    _data = _buffer.data();
+    _size = _buffer.size();
+#else
+    int fd = ::open(path.data(), O_RDONLY);
+    if(fd < 0)
+        return -1;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(resultFileHeader))
+    {
+        ::close(fd);
+        return -1;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(addr == MAP_FAILED)
+        return -1;
+    _data = static_cast<const char*>(addr);
+    _size = st.st_size;
+    _mapped = true;
+#endif // _WIN32
+    if(validate() != 0)
+    {
+        close();
+        return -1;
+    }
+    return 0;
+}
+
+int resultFileReader::load(std::string data)
+{
+    close();
+    _buffer = std::move(data);
+    _data = _buffer.data();
+    _size = _buffer.size();
+    if(validate() != 0)
+    {
+        close();
+        return -1;
+    }
+    return 0;
+}
+
+void resultFileReader::close()
+{
+#ifndef _WIN32
+    if(_mapped && _data)
+        munmap(const_cast<char*>(_data), _size);
+#endif // _WIN32
+    _mapped = false;
+    _data = nullptr;
+    _size = 0;
+    eraseElements(_buffer);
+    _header = nullptr;
+    _records = _series = _strings = nullptr;
+}
+
+int resultFileReader::validate()
+{
+    if(_size < sizeof(resultFileHeader))
+        return -1;
+    const resultFileHeader *header = reinterpret_cast<const resultFileHeader*>(_data);
+    if(memcmp(header->magic, resultfile_magic, sizeof(resultfile_magic)) != 0)
+        return -1;
+    if(header->version != resultfile_version)
+    {
+        writeLog(LOG_TYPE_ERROR, "Result file version " + std::to_string(header->version) + " is not supported.");
+        return -1;
+    }
+    if(header->header_size != sizeof(resultFileHeader) || header->record_size != sizeof(resultFileRecord))
+        return -1;
+    if(header->records_offset % 8 != 0 || header->series_offset % 8 != 0)
+        return -1;
+    if(header->records_offset + (uint64_t)header->node_count * header->record_size > _size)
+        return -1;
+    if(header->series_offset + header->series_size > _size || header->strings_offset + header->strings_size > _size)
+        return -1;
+    _header = header;
+    _records = _data + header->records_offset;
+    _series = _data + header->series_offset;
+    _strings = _data + header->strings_offset;
+
+    //check every reference once so that accessors can stay unchecked
+    auto string_ok = [header](const resultFileString &str) { return (uint64_t)str.offset + str.length <= header->strings_size; };
+    auto series_ok = [header](const resultFileSeries &series, size_t elem_size) { return (uint64_t)series.offset + (uint64_t)series.count * elem_size <= header->series_size && series.offset % elem_size == 0; };
+    if(!string_ok(header->tester))
+        return -1;
+    for(uint32_t i = 0; i < header->node_count; i++)
+    {
+        resultFileRecord x = record(i);
+        if(!string_ok(x.group) || !string_ok(x.remarks) || !string_ok(x.avg_ping) || !string_ok(x.pk_loss) || !string_ok(x.site_ping) ||
+                !string_ok(x.avg_speed) || !string_ok(x.max_speed) || !string_ok(x.ul_speed) || !string_ok(x.nat_type) || !string_ok(x.socket_options) ||
+                !string_ok(x.test_mirrors) || !string_ok(x.test_file) || !string_ok(x.mirror_probe) ||
+                !string_ok(x.screen_speed) || !string_ok(x.screen_ping) || !string_ok(x.conn_rate) || !string_ok(x.req_rate) || !string_ok(x.load_test) ||
+                !string_ok(x.page_load) || !string_ok(x.page_load_path) || !string_ok(x.inbound_geoip) || !string_ok(x.outbound_geoip))
+            return -1;
+        if(!series_ok(x.raw_ping, sizeof(int32_t)) || !series_ok(x.raw_site_ping, sizeof(int32_t)) || !series_ok(x.raw_speed, sizeof(uint64_t)) ||
+                !series_ok(x.phase_duration, sizeof(int32_t)) || !series_ok(x.mirror_speed, sizeof(uint64_t)))
+            return -1;
+    }
+    return 0;
+}
+
+resultFileRecord resultFileReader::record(uint32_t index) const
+{
+    resultFileRecord result;
+    memcpy(static_cast<void*>(&result), _records + (uint64_t)index * sizeof(result), sizeof(result));
+    return result;
+}
+
+bool isResultFile(const std::string &path)
+{
+    char magic[sizeof(resultfile_magic)] = {};
+    FILE *fp = fopen(path.data(), "rb");
+    if(!fp)
+        return false;
+    size_t len = fread(magic, 1, sizeof(magic), fp);
+    fclose(fp);
+    return len == sizeof(magic) && memcmp(magic, resultfile_magic, sizeof(magic)) == 0;
+}
+
+std::string resultFileBuild(std::vector<nodeInfo> &nodes, const std::string &tester)
+{
+    std::string strings, series;
+    std::vector<resultFileRecord> records(nodes.size());
+    std::unordered_map<std::string, resultFileString> string_index;
+
+    auto add_string = [&](const std::string &str)
+    {
+        auto iter = string_index.find(str);
+        if(iter != string_index.end())
+            return iter->second;
+        resultFileString ref;
+        ref.offset = strings.size();
+        ref.length = str.size();
+        strings += str;
+        string_index.emplace(str, ref);
+        return ref;
+    };
+    auto add_series = [&](const void *data, uint32_t count, size_t elem_size)
+    {
+        resultFileSeries ref;
+        ref.offset = series.size();
+        ref.count = count;
+        series.append(reinterpret_cast<const char*>(data), count * elem_size);
+        return ref;
+    };
+
+    for(size_t i = 0; i < nodes.size(); i++)
+    {
+        nodeInfo &x = nodes[i];
+        resultFileRecord &record = records[i];
+        memset(static_cast<void*>(&record), 0, sizeof(record));
+        record.group = add_string(x.group);
+        record.remarks = add_string(x.remarks);
+        record.avg_ping = add_string(x.avgPing);
+        record.pk_loss = add_string(x.pkLoss);
+        record.site_ping = add_string(x.sitePing);
+        record.avg_speed = add_string(x.avgSpeed);
+        record.max_speed = add_string(x.maxSpeed);
+        record.ul_speed = add_string(x.ulSpeed);
+        record.nat_type = add_string(x.natType.get());
+        record.socket_options = add_string(x.socketOptions);
+        record.test_mirrors = add_string(joinMirrors(x.testMirrors));
+        record.test_file = add_string(x.testFile);
+        record.mirror_probe = add_string(x.mirrorProbe);
+        record.screen_speed = add_string(x.screenSpeed);
+        record.screen_ping = add_string(x.screenPing);
+        record.screen_traffic = x.screenTraffic;
+        record.screen_score = x.screenScore;
+        record.cached_time = x.cachedTime;
+        record.conn_rate = add_string(x.connRate);
+        record.req_rate = add_string(x.reqRate);
+        record.load_test = add_string(x.loadTest);
+        record.page_load = add_string(x.pageLoad);
+        record.page_load_path = add_string(x.pageLoadPath);
+        record.inbound_geoip = add_string(joinGeoIP(x.inboundGeoIP.get()));
+        record.outbound_geoip = add_string(joinGeoIP(x.outboundGeoIP.get()));
+        record.traffic = x.totalRecvBytes;
+        record.id = x.id;
+        record.group_id = x.groupID;
+        record.link_type = x.linkType;
+        record.duration = x.duration;
+        record.flags = (x.online ? RESULTFILE_FLAG_ONLINE : 0) | (x.screenOnly ? RESULTFILE_FLAG_SCREEN_ONLY : 0);
+        //64-bit series first so that every one of them stays aligned
+        record.raw_speed = add_series(x.rawSpeed, sizeof(x.rawSpeed) / sizeof(x.rawSpeed[0]), sizeof(x.rawSpeed[0]));
+        record.mirror_speed = add_series(x.mirrorSpeed.data(), x.mirrorSpeed.size(), sizeof(uint64_t));
+        record.raw_ping = add_series(x.rawPing, sizeof(x.rawPing) / sizeof(x.rawPing[0]), sizeof(int32_t));
+        record.raw_site_ping = add_series(x.rawSitePing, sizeof(x.rawSitePing) / sizeof(x.rawSitePing[0]), sizeof(int32_t));
+        record.phase_duration = add_series(x.phaseDuration, NODE_PHASE_COUNT, sizeof(int32_t));
+        series.resize(resultFileAlign(series.size()));
+    }
+
+    resultFileHeader header;
+    memset(static_cast<void*>(&header), 0, sizeof(header));
+    memcpy(header.magic, resultfile_magic, sizeof(resultfile_magic));
+    header.version = resultfile_version;
+    header.header_size = sizeof(resultFileHeader);
+    header.record_size = sizeof(resultFileRecord);
+    header.node_count = records.size();
+    header.generation_time = time(NULL);
+    header.tester = add_string(tester);
+    header.records_offset = resultFileAlign(sizeof(resultFileHeader));
+    header.series_offset = resultFileAlign(header.records_offset + records.size() * sizeof(resultFileRecord));
+    header.series_size = series.size();
+    header.strings_offset = resultFileAlign(header.series_offset + series.size());
+    header.strings_size = strings.size();
+
+    std::string content;
+    content.reserve(header.strings_offset + strings.size());
+    content.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    content.resize(header.records_offset);
+    content.append(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(resultFileRecord));
+    content.resize(header.series_offset);
+    content.append(series);
+    content.resize(header.strings_offset);
+    content.append(strings);
+    return content;
+}
+
+int resultFileWrite(const std::string &path, std::vector<nodeInfo> &nodes, const std::string &tester)
+{
+    return fileWrite(path, resultFileBuild(nodes, tester), true);
+}
+
+int resultFileLoad(const resultFileReader &reader, std::vector<nodeInfo> &nodes)
+{
+    if(!reader.valid())
+        return -1;
+    nodeInfo node;
+    node.proxyStr = "LOG";
+    nodes.reserve(nodes.size() + reader.size());
+    for(uint32_t i = 0; i < reader.size(); i++)
+    {
+        resultFileRecord record = reader.record(i);
+        const uint64_t *speeds;
+        node.group = reader.string(record.group);
+        node.remarks = reader.string(record.remarks);
+        node.avgPing = reader.string(record.avg_ping);
+        node.pkLoss = reader.string(record.pk_loss);
+        node.sitePing = reader.string(record.site_ping);
+        node.avgSpeed = reader.string(record.avg_speed);
+        node.maxSpeed = reader.string(record.max_speed);
+        node.ulSpeed = reader.string(record.ul_speed);
+        node.natType.set(std::string(reader.string(record.nat_type)));
+        node.socketOptions = reader.string(record.socket_options);
+        std::string_view mirrors = reader.string(record.test_mirrors);
+        node.testMirrors = mirrors.size() ? split(std::string(mirrors), "|") : std::vector<std::string>();
+        speeds = reader.speedSeries(record.mirror_speed);
+        node.mirrorSpeed.assign(speeds, speeds + record.mirror_speed.count);
+        node.testFile = reader.string(record.test_file);
+        node.mirrorProbe = reader.string(record.mirror_probe);
+        node.screenOnly = record.flags & RESULTFILE_FLAG_SCREEN_ONLY;
+        node.screenSpeed = reader.string(record.screen_speed);
+        node.screenPing = reader.string(record.screen_ping);
+        node.screenTraffic = record.screen_traffic;
+        node.screenScore = record.screen_score;
+        node.cachedTime = record.cached_time;
+        node.connRate = reader.string(record.conn_rate);
+        node.reqRate = reader.string(record.req_rate);
+        node.loadTest = reader.string(record.load_test);
+        node.pageLoad = reader.string(record.page_load);
+        node.pageLoadPath = reader.string(record.page_load_path);
+        node.inboundGeoIP.set(splitGeoIP(reader.string(record.inbound_geoip)));
+        node.outboundGeoIP.set(splitGeoIP(reader.string(record.outbound_geoip)));
+        node.totalRecvBytes = record.traffic;
+        node.id = record.id;
+        node.groupID = record.group_id;
+        node.linkType = record.link_type;
+        node.duration = record.duration;
+        node.online = record.flags & RESULTFILE_FLAG_ONLINE;
+        speeds = reader.speedSeries(record.raw_speed);
+        for(uint32_t j = 0; j < record.raw_speed.count && j < sizeof(node.rawSpeed) / sizeof(node.rawSpeed[0]); j++)
+            node.rawSpeed[j] = speeds[j];
+        const int32_t *pings = reader.pingSeries(record.raw_ping);
+        for(uint32_t j = 0; j < record.raw_ping.count && j < sizeof(node.rawPing) / sizeof(node.rawPing[0]); j++)
+            node.rawPing[j] = pings[j];
+        pings = reader.pingSeries(record.raw_site_ping);
+        for(uint32_t j = 0; j < record.raw_site_ping.count && j < sizeof(node.rawSitePing) / sizeof(node.rawSitePing[0]); j++)
+            node.rawSitePing[j] = pings[j];
+        const int32_t *phases = reader.pingSeries(record.phase_duration);
+        for(uint32_t j = 0; j < NODE_PHASE_COUNT; j++)
+            node.phaseDuration[j] = j < record.phase_duration.count ? phases[j] : 0;
+        nodes.push_back(node);
+    }
+    return 0;
+}
+
+std::string resultNodesToINI(std::vector<nodeInfo> &nodes, const std::string &tester, const std::string &generation_time)
+{
+    INIReader ini;
+
+    ini.SetCurrentSection("Basic");
+    ini.Set("Tester", tester);
+    ini.Set("GenerationTime", generation_time);
+
+    for(nodeInfo &x : nodes)
+    {
+        ini.SetCurrentSection(x.group + "^" + x.remarks);
+        ini.Set("AvgPing", x.avgPing);
+        ini.Set("PkLoss", x.pkLoss);
+        ini.Set("SitePing", x.sitePing);
+        ini.Set("AvgSpeed", x.avgSpeed);
+        ini.Set("MaxSpeed", x.maxSpeed);
+        ini.Set("ULSpeed", x.ulSpeed);
+        ini.SetNumber<unsigned long long>("UsedTraffic", x.totalRecvBytes);
+        ini.SetNumber<int>("GroupID", x.groupID);
+        ini.SetNumber<int>("ID", x.id);
+        ini.SetBool("Online", x.online);
+        ini.SetArray("RawPing", ",", x.rawPing);
+        ini.SetArray("RawSitePing", ",", x.rawSitePing);
+        ini.SetArray("RawSpeed", ",", x.rawSpeed);
+        ini.SetArray("PhaseDuration", ",", x.phaseDuration);
+        ini.Set("SocketOptions", x.socketOptions);
+        ini.Set("TestFile", x.testFile);
+        ini.SetBool("ScreenOnly", x.screenOnly);
+        ini.Set("ScreenSpeed", x.screenSpeed);
+        ini.Set("ScreenPing", x.screenPing);
+        ini.SetNumber<unsigned long long>("ScreenTraffic", x.screenTraffic);
+        ini.SetNumber<double>("ScreenScore", x.screenScore);
+        if(x.mirrorProbe.size())
+            ini.Set("MirrorProbe", x.mirrorProbe);
+        if(x.cachedTime)
+            ini.SetNumber<long long>("CachedTime", x.cachedTime);
+        if(x.loadTest.size())
+        {
+            ini.Set("ConnRate", x.connRate);
+            ini.Set("ReqRate", x.reqRate);
+            ini.Set("LoadTest", x.loadTest);
+        }
+        if(x.pageLoadPath.size())
+        {
+            ini.Set("PageLoad", x.pageLoad);
+            ini.Set("PageLoadPath", x.pageLoadPath);
+        }
+        if(x.testMirrors.size())
+        {
+            ini.Set("TestMirrors", joinMirrors(x.testMirrors));
+            ini.SetArray("MirrorSpeed", ",", x.mirrorSpeed);
+        }
+    }
+    return ini.ToString();
+}
+
+std::string resultNodesToJSON(std::vector<nodeInfo> &nodes, const std::string &tester, const std::string &generation_time)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    writer.StartObject();
+    writer.Key("tester");
+    writer.String(tester.data());
+    writer.Key("generationTime");
+    writer.String(generation_time.data());
+    writer.Key("nodes");
+    writer.StartArray();
+    for(nodeInfo &x : nodes)
+    {
+        writer.StartObject();
+        writer.Key("id");
+        writer.Int(x.id);
+        writer.Key("groupID");
+        writer.Int(x.groupID);
+        writer.Key("group");
+        writer.String(x.group.data());
+        writer.Key("remarks");
+        writer.String(x.remarks.data());
+        writer.Key("online");
+        writer.Bool(x.online);
+        writer.Key("avgPing");
+        writer.String(x.avgPing.data());
+        writer.Key("pkLoss");
+        writer.String(x.pkLoss.data());
+        writer.Key("sitePing");
+        writer.String(x.sitePing.data());
+        writer.Key("avgSpeed");
+        writer.String(x.avgSpeed.data());
+        writer.Key("maxSpeed");
+        writer.String(x.maxSpeed.data());
+        writer.Key("ulSpeed");
+        writer.String(x.ulSpeed.data());
+        writer.Key("natType");
+        writer.String(x.natType.get().data());
+        writer.Key("usedTraffic");
+        writer.Uint64(x.totalRecvBytes);
+        writer.Key("duration");
+        writer.Int(x.duration);
+        writer.Key("rawPing");
+        writer.StartArray();
+        for(int y : x.rawPing)
+            writer.Int(y);
+        writer.EndArray();
+        writer.Key("rawSitePing");
+        writer.StartArray();
+        for(int y : x.rawSitePing)
+            writer.Int(y);
+        writer.EndArray();
+        writer.Key("rawSpeed");
+        writer.StartArray();
+        for(unsigned long long y : x.rawSpeed)
+            writer.Uint64(y);
+        writer.EndArray();
+        writer.Key("socketOptions");
+        writer.String(x.socketOptions.data());
+        writer.Key("phaseDuration");
+        writer.StartObject();
+        for(int i = 0; i < NODE_PHASE_COUNT; i++)
+        {
+            writer.Key(node_phase_names[i]);
+            writer.Int(x.phaseDuration[i]);
+        }
+        writer.EndObject();
+        writer.Key("testFile");
+        writer.String(x.testFile.data());
+        writer.Key("screenOnly");
+        writer.Bool(x.screenOnly);
+        writer.Key("cachedTime");
+        writer.Int64(x.cachedTime);
+        writer.Key("screenSpeed");
+        writer.String(x.screenSpeed.data());
+        writer.Key("screenPing");
+        writer.String(x.screenPing.data());
+        writer.Key("screenTraffic");
+        writer.Uint64(x.screenTraffic);
+        writer.Key("screenScore");
+        writer.Double(x.screenScore);
+        writer.Key("mirrorProbe");
+        writer.String(x.mirrorProbe.data());
+        writer.Key("connRate");
+        writer.String(x.connRate.data());
+        writer.Key("reqRate");
+        writer.String(x.reqRate.data());
+        writer.Key("loadTest");
+        writer.String(x.loadTest.data());
+        writer.Key("pageLoad");
+        writer.String(x.pageLoad.data());
+        writer.Key("pageLoadPath");
+        writer.String(x.pageLoadPath.data());
+        writer.Key("mirrors");
+        writer.StartArray();
+        for(size_t i = 0; i < x.testMirrors.size(); i++)
+        {
+            writer.StartObject();
+            writer.Key("url");
+            writer.String(x.testMirrors[i].data());
+            writer.Key("speed");
+            writer.Uint64(i < x.mirrorSpeed.size() ? x.mirrorSpeed[i] : 0);
+            writer.EndObject();
+        }
+        writer.EndArray();
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return sb.GetString();
+}
+
+static std::string resultFileTime(const resultFileReader &reader)
+{
+    char buf[32] = {};
+    time_t lt = reader.header().generation_time;
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", localtime(&lt));
+    return std::string(buf);
+}
+
+std::string resultFileToINI(const resultFileReader &reader)
+{
+    std::vector<nodeInfo> nodes;
+    if(resultFileLoad(reader, nodes) != 0)
+        return std::string();
+    return resultNodesToINI(nodes, std::string(reader.string(reader.header().tester)), resultFileTime(reader));
+}
+
+std::string resultFileToJSON(const resultFileReader &reader)
+{
+    std::vector<nodeInfo> nodes;
+    if(resultFileLoad(reader, nodes) != 0)
+        return std::string();
+    return resultNodesToJSON(nodes, std::string(reader.string(reader.header().tester)), resultFileTime(reader));
+}
+
+int explodeResultFile(const std::string &path, std::vector<nodeInfo> &nodes)
+{
+    if(!isResultFile(path))
+        return -1;
+    resultFileReader reader;
+    if(reader.open(path) != 0)
+    {
+        writeLog(LOG_TYPE_ERROR, "Invalid binary result file: " + path);
+        return -1;
+    }
+    return resultFileLoad(reader, nodes);
+}
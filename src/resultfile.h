@@ -0,0 +1,136 @@
+#ifndef RESULTFILE_H_INCLUDED
+#define RESULTFILE_H_INCLUDED
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include "nodeinfo.h"
+
+/*
+Binary result layout, all values in host byte order:
+    header
+    records, one fixed-size resultFileRecord per node
+    series, raw speed/ping arrays referenced by the records
+    string table, referenced by the header and the records
+*/
+
+enum
+{
+    RESULTFILE_FLAG_ONLINE = 1,
+    RESULTFILE_FLAG_SCREEN_ONLY = 2
+};
+
+struct resultFileString
+{
+    uint32_t offset = 0;
+    uint32_t length = 0;
+};
+
+struct resultFileSeries
+{
+    uint32_t offset = 0; //in bytes from the start of series block
+    uint32_t count = 0;
+};
+
+struct resultFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint32_t node_count;
+    int64_t generation_time;
+    uint64_t records_offset;
+    uint64_t series_offset;
+    uint64_t series_size;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    resultFileString tester;
+};
+
+struct resultFileRecord
+{
+    resultFileString group;
+    resultFileString remarks;
+    resultFileString avg_ping;
+    resultFileString pk_loss;
+    resultFileString site_ping;
+    resultFileString avg_speed;
+    resultFileString max_speed;
+    resultFileString ul_speed;
+    resultFileString nat_type;
+    resultFileString socket_options;
+    resultFileString test_mirrors; //URLs joined with "|"
+    resultFileString test_file;
+    resultFileString mirror_probe;
+    resultFileString screen_speed;
+    resultFileString screen_ping;
+    resultFileString conn_rate;
+    resultFileString req_rate;
+    resultFileString load_test;
+    resultFileString page_load;
+    resultFileString page_load_path;
+    resultFileString inbound_geoip; //geoIPInfo fields joined with "\n", empty when never fetched
+    resultFileString outbound_geoip;
+    resultFileSeries raw_ping; //int32_t
+    resultFileSeries raw_site_ping; //int32_t
+    resultFileSeries raw_speed; //uint64_t
+    resultFileSeries mirror_speed; //uint64_t, same order as test_mirrors
+    resultFileSeries phase_duration; //int32_t milliseconds, indexed by NODE_PHASE_*
+    uint64_t traffic;
+    uint64_t screen_traffic;
+    double screen_score;
+    int32_t id;
+    int32_t group_id;
+    int32_t link_type;
+    int32_t duration;
+    uint32_t flags;
+    uint32_t cached_time; //unix time of the reused run, 0 when tested in this run
+};
+
+class resultFileReader
+{
+public:
+    resultFileReader() = default;
+    resultFileReader(const resultFileReader&) = delete;
+    resultFileReader& operator=(const resultFileReader&) = delete;
+    ~resultFileReader();
+
+    int open(const std::string &path);
+    int load(std::string data); //takes a copy of a whole file
+    void close();
+    bool valid() const { return _header != nullptr; }
+
+    uint32_t size() const { return _header ? _header->node_count : 0; }
+    const resultFileHeader &header() const { return *_header; }
+    resultFileRecord record(uint32_t index) const;
+    std::string_view string(const resultFileString &str) const { return std::string_view(_strings + str.offset, str.length); }
+    const int32_t *pingSeries(const resultFileSeries &series) const { return reinterpret_cast<const int32_t*>(_series + series.offset); }
+    const uint64_t *speedSeries(const resultFileSeries &series) const { return reinterpret_cast<const uint64_t*>(_series + series.offset); }
+
+private:
+    int validate();
+
+    const char *_data = nullptr;
+    size_t _size = 0;
+    bool _mapped = false;
+    std::string _buffer;
+    const resultFileHeader *_header = nullptr;
+    const char *_records = nullptr;
+    const char *_series = nullptr;
+    const char *_strings = nullptr;
+};
+
+bool isResultFile(const std::string &path);
+std::string resultFileBuild(std::vector<nodeInfo> &nodes, const std::string &tester);
+int resultFileWrite(const std::string &path, std::vector<nodeInfo> &nodes, const std::string &tester);
+int resultFileLoad(const resultFileReader &reader, std::vector<nodeInfo> &nodes);
+std::string resultNodesToINI(std::vector<nodeInfo> &nodes, const std::string &tester, const std::string &generation_time);
+std::string resultNodesToJSON(std::vector<nodeInfo> &nodes, const std::string &tester, const std::string &generation_time);
+std::string resultFileToINI(const resultFileReader &reader);
+std::string resultFileToJSON(const resultFileReader &reader);
+int explodeResultFile(const std::string &path, std::vector<nodeInfo> &nodes);
+
+#endif // RESULTFILE_H_INCLUDED
@@ -1,18 +1,23 @@
 #include <string>
 #include <future>
 #include <thread>
+#include <cmath>
+#include <algorithm>
 
 #include "rulematch.h"
 #include "geoip.h"
 #include "misc.h"
 #include "logger.h"
 #include "nodeinfo.h"
+#include "multithread_test.h"
+#include "trace.h"
+#include "deadline.h"
 
 void getTestFile(nodeInfo &node, const std::string &proxy, const std::vector<downloadLink> &downloadFiles, const std::vector<linkMatchRule> &matchRules, const std::string &defaultTestFile)
 {
     writeLog(LOG_TYPE_RULES, "Rule match started.");
     std::string def_test_file = defaultTestFile;
-    geoIPInfo outbound = node.outboundGeoIP.get();
+    geoIPInfo outbound = node.outboundGeoIP.get(deadlineCurrent(), geoIPInfo());
 
     //scan the URLs first to find the default one
     writeLog(LOG_TYPE_RULES, "Searching default rule.");
@@ -106,3 +111,126 @@ void getTestFile(nodeInfo &node, const std::string &proxy, const std::vector<dow
     }
     writeLog(LOG_TYPE_RULES, "Node  " + node.group + " - " + node.remarks + "  uses test file '" + node.testFile +"'.");
 }
+
+void getTestMirrors(nodeInfo &node, const std::vector<downloadLink> &downloadFiles, const std::string &tag)
+{
+    eraseElements(node.testMirrors);
+    eraseElements(node.mirrorSpeed);
+    std::string mirror_tag = tag;
+    if(mirror_tag.empty()) //use the tag of the matched test file
+    {
+        auto iter = std::find_if(downloadFiles.begin(), downloadFiles.end(), [&](auto &x){ return x.url == node.testFile; });
+        if(iter == downloadFiles.end())
+        {
+            writeLog(LOG_TYPE_RULES, "Test file '" + node.testFile + "' has no tag, mirror download disabled for this node.");
+            return;
+        }
+        mirror_tag = iter->tag;
+    }
+    for(const downloadLink &x : downloadFiles)
+        if(x.tag == mirror_tag && std::find(node.testMirrors.begin(), node.testMirrors.end(), x.url) == node.testMirrors.end())
+            node.testMirrors.push_back(x.url);
+    if(node.testMirrors.size() < 2)
+    {
+        eraseElements(node.testMirrors);
+        return;
+    }
+    writeLog(LOG_TYPE_RULES, "Node  " + node.group + " - " + node.remarks + "  downloads from " + std::to_string(node.testMirrors.size()) + " mirrors tagged '" + mirror_tag + "'.");
+}
+
+//great-circle distance in kilometers
+static double geoDistance(double lat1, double lon1, double lat2, double lon2)
+{
+    const double rad = M_PI / 180.0;
+    double dlat = (lat2 - lat1) * rad, dlon = (lon2 - lon1) * rad;
+    double a = sin(dlat / 2) * sin(dlat / 2) + cos(lat1 * rad) * cos(lat2 * rad) * sin(dlon / 2) * sin(dlon / 2);
+    return 6371.0 * 2 * atan2(sqrt(a), sqrt(1 - a));
+}
+
+struct mirrorCandidate
+{
+    std::string url;
+    double distance = -1.0; //-1 when either end has no location
+    int ttfb = -1;
+    unsigned long long speed = 0;
+    int band = 0; //speed in steps of 5% of the fastest mirror
+};
+
+void selectTestFile(nodeInfo &node, const std::string &localaddr, int localport, const std::string &username, const std::string &password, const std::vector<downloadLink> &downloadFiles, int probe_count, int probe_time)
+{
+    writeLog(LOG_TYPE_RULES, "Mirror selection started.");
+    std::vector<mirrorCandidate> candidates;
+    geoIPInfo outbound = node.outboundGeoIP.get(deadlineCurrent(), geoIPInfo());
+    bool outbound_located = outbound.latitude.size() && outbound.longitude.size();
+    double latitude = to_number<double>(outbound.latitude), longitude = to_number<double>(outbound.longitude);
+
+    //the file picked by the rules always competes, it is kept out of the cut below
+    mirrorCandidate rule_file {node.testFile};
+    for(const downloadLink &x : downloadFiles)
+    {
+        mirrorCandidate *target = &rule_file;
+        if(x.url != rule_file.url)
+        {
+            auto iter = std::find_if(candidates.begin(), candidates.end(), [&](auto &y){ return y.url == x.url; });
+            if(iter == candidates.end())
+                iter = candidates.insert(candidates.end(), mirrorCandidate{x.url});
+            target = &*iter;
+        }
+        if(x.located && outbound_located)
+            target->distance = geoDistance(latitude, longitude, x.latitude, x.longitude);
+    }
+    //nearest first, mirrors without a location keep their config order behind them
+    std::stable_sort(candidates.begin(), candidates.end(), [](auto &a, auto &b){ return a.distance >= 0 && (b.distance < 0 || a.distance < b.distance); });
+    if(probe_count > 0 && (int)candidates.size() > probe_count - 1)
+        candidates.resize(std::max(probe_count - 1, 0));
+    candidates.push_back(rule_file);
+
+    std::vector<std::future<int>> probes;
+    for(mirrorCandidate &x : candidates)
+        probes.push_back(std::async(std::launch::async, [&x, &localaddr, localport, &username, &password, probe_time, node_id = node.id, until = deadlineCurrent()]()
+        {
+            deadlineScope deadline(until);
+            TRACE_SCOPE("mirror_probe", node_id, x.url);
+            return mirrorProbe(x.url, localaddr, localport, username, password, probe_time, x.ttfb, x.speed);
+        }));
+    unsigned long long max_speed = 0;
+    for(size_t i = 0; i < candidates.size(); i++)
+    {
+        if(probes[i].get() != 0)
+            continue;
+        max_speed = std::max(max_speed, candidates[i].speed);
+    }
+
+    //ranked by burst throughput, then first byte time, then distance
+    //a short burst is noisy, so speeds within the same 5% band count as equal
+    auto better = [](const mirrorCandidate &a, const mirrorCandidate &b)
+    {
+        if(a.band != b.band)
+            return a.band > b.band;
+        if(a.ttfb != b.ttfb)
+            return a.ttfb < b.ttfb;
+        return a.distance >= 0 && (b.distance < 0 || a.distance < b.distance);
+    };
+    mirrorCandidate *best = nullptr;
+    node.mirrorProbe.clear();
+    for(mirrorCandidate &x : candidates)
+    {
+        if(x.ttfb >= 0)
+        {
+            x.band = max_speed ? x.speed * 20 / max_speed : 0;
+            if(!best || better(x, *best))
+                best = &x;
+        }
+        std::string distance = x.distance < 0 ? "N/A" : std::to_string((int)x.distance) + "km";
+        std::string result = x.ttfb < 0 ? x.url + " failed distance=" + distance : x.url + " ttfb=" + std::to_string(x.ttfb) + "ms speed=" + speedCalc(x.speed) + "/s distance=" + distance;
+        writeLog(LOG_TYPE_RULES, "Mirror " + result);
+        node.mirrorProbe += (node.mirrorProbe.empty() ? "" : "; ") + result;
+    }
+    if(!best)
+    {
+        writeLog(LOG_TYPE_RULES, "No mirror answered the probe, keeping test file '" + node.testFile + "'.");
+        return;
+    }
+    node.testFile = best->url;
+    writeLog(LOG_TYPE_RULES, "Node  " + node.group + " - " + node.remarks + "  uses fastest mirror '" + node.testFile + "'.");
+}
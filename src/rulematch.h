@@ -8,6 +8,9 @@ struct downloadLink
 {
     std::string url;
     std::string tag;
+    bool located = false; //server location was given in the config
+    double latitude = 0.0;
+    double longitude = 0.0;
 };
 
 struct linkMatchRule
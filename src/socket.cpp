@@ -8,8 +8,13 @@
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
+#ifndef _WIN32
+#include <netinet/tcp.h>
+#endif // _WIN32
+
 #include "socket.h"
 #include "misc.h"
+#include "deadline.h"
 
 using namespace std::chrono;
 
@@ -73,6 +78,76 @@ SOCKET initSocket(int af, int type, int protocol)
     return s;
 }
 
+bool socketProfilePreset(const std::string &name, socketProfile &profile)
+{
+    profile = socketProfile();
+    profile.name = name;
+    if(name == "default")
+        return true;
+    if(name == "throughput") //large windows for high bandwidth-delay paths
+    {
+        profile.rcvbuf = profile.sndbuf = 4 * 1024 * 1024;
+        profile.congestion = "bbr";
+        profile.quickack = true;
+        return true;
+    }
+    if(name == "latency")
+    {
+        profile.nodelay = true;
+        profile.quickack = true;
+        return true;
+    }
+    profile.name = "default";
+    return false;
+}
+
+//must be called before connecting so that the window scale covers the requested buffer, returns the settings the kernel reports back
+std::string applySocketProfile(SOCKET s, const socketProfile &profile)
+{
+    int one = 1, value = 0;
+    socklen_t len = sizeof(value);
+    std::string applied = "profile=" + profile.name;
+    if(profile.rcvbuf > 0)
+        setsockopt(s, SOL_SOCKET, SO_RCVBUF, (char *)&profile.rcvbuf, sizeof(int));
+    if(profile.sndbuf > 0)
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, (char *)&profile.sndbuf, sizeof(int));
+    if(profile.nodelay)
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char *)&one, sizeof(int));
+#ifdef TCP_CONGESTION
+    if(profile.congestion.size())
+        setsockopt(s, IPPROTO_TCP, TCP_CONGESTION, profile.congestion.data(), profile.congestion.size());
+#endif // TCP_CONGESTION
+    if(profile.quickack)
+        socketQuickAck(s);
+
+    if(getsockopt(s, SOL_SOCKET, SO_RCVBUF, (char *)&value, &len) == 0)
+        applied += " rcvbuf=" + std::to_string(value);
+    len = sizeof(value);
+    if(getsockopt(s, SOL_SOCKET, SO_SNDBUF, (char *)&value, &len) == 0)
+        applied += " sndbuf=" + std::to_string(value);
+    len = sizeof(value);
+    if(getsockopt(s, IPPROTO_TCP, TCP_NODELAY, (char *)&value, &len) == 0)
+        applied += std::string(" nodelay=") + (value ? "1" : "0");
+#ifdef TCP_QUICKACK
+    applied += std::string(" quickack=") + (profile.quickack ? "1" : "0");
+#endif // TCP_QUICKACK
+#ifdef TCP_CONGESTION
+    char congestion[16] = {};
+    len = sizeof(congestion) - 1;
+    if(getsockopt(s, IPPROTO_TCP, TCP_CONGESTION, congestion, &len) == 0)
+        applied += " congestion=" + std::string(congestion);
+#endif // TCP_CONGESTION
+    return applied;
+}
+
+void socketQuickAck(SOCKET s)
+{
+#ifdef TCP_QUICKACK
+    int one = 1;
+    setsockopt(s, IPPROTO_TCP, TCP_QUICKACK, (char *)&one, sizeof(int));
+#endif // TCP_QUICKACK
+}
+
 int Send(SOCKET sHost, const char* data, int len, int flags)
 {
 #ifdef _WIN32
@@ -127,6 +202,7 @@ int socks5_do_auth_userpass(SOCKET sHost, std::string user, std::string pass)
 int setTimeout(SOCKET s, int timeout)
 {
     int ret = -1;
+    timeout = deadlineRemaining(timeout);
 #ifdef _WIN32
     ret = setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, (char*)&timeout, sizeof(int));
     ret = setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(int));
@@ -163,8 +239,9 @@ int connect_adv(SOCKET sockfd, const struct sockaddr* addr, int addrsize)
         return -1;
     if(connect(sockfd, addr, addrsize) == -1)
     {
-        tm.tv_sec = connect_timeout / 1000;
-        tm.tv_usec = (connect_timeout % 1000) * 1000;
+        int timeout = deadlineRemaining(connect_timeout);
+        tm.tv_sec = timeout / 1000;
+        tm.tv_usec = (timeout % 1000) * 1000;
         FD_ZERO(&set);
         FD_SET(sockfd, &set);
         if(select(sockfd + 1, NULL, &set, NULL, &tm) > 0)
@@ -220,7 +297,7 @@ int simpleSend(std::string addr, int port, std::string data)
         return SOCKET_ERROR;
     if(startConnect(sHost, addr, port) != 0)
         return SOCKET_ERROR;
-    setTimeout(sHost, 3000);
+    setTimeout(sHost, connect_timeout);
     unsigned int retVal = send_simple(sHost, data);
     if(retVal == data.size())
     {
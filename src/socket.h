@@ -45,8 +45,22 @@ typedef sockaddr *LPSOCKADDR;
 
 #define BUF_SIZE 1024
 
+//options applied to download/upload test streams, zero or empty values keep the system default
+struct socketProfile
+{
+    std::string name = "default";
+    int rcvbuf = 0; //bytes
+    int sndbuf = 0;
+    std::string congestion; //TCP_CONGESTION algorithm, Linux only
+    bool nodelay = false;
+    bool quickack = false; //Linux only, has to be re-armed after every receive
+};
+
 SOCKET initSocket(int af, int type, int protocol);
 int getNetworkType(std::string addr);
+bool socketProfilePreset(const std::string &name, socketProfile &profile);
+std::string applySocketProfile(SOCKET s, const socketProfile &profile);
+void socketQuickAck(SOCKET s);
 int Send(SOCKET sHost, const char* data, int len, int flags);
 int Recv(SOCKET sHost, char* data, int len, int flags);
 int socks5_do_auth_userpass(SOCKET sHost, std::string user, std::string pass);
@@ -57,6 +71,7 @@ int simpleSend(std::string addr, int port, std::string data);
 int send_simple(SOCKET sHost, std::string data);
 std::string hostnameToIPAddr(std::string host);
 int connectSocks5(SOCKET sHost, std::string username, std::string password);
+int putSocksAddress(char **p, const std::string &host, const uint16_t dest_port);
 int connectThruSocks(SOCKET sHost, std::string host, int port);
 int connectThruHTTP(SOCKET sHost, std::string username, std::string password, std::string dsthost, int dstport);
 int checkPort(int startport);
@@ -33,5 +33,6 @@ bool getSubInfoFromHeader(const std::string &header, std::string &result);
 bool getSubInfoFromNodes(const std::vector<nodeInfo> &nodes, const string_array &stream_rules, const string_array &time_rules, std::string &result);
 bool getSubInfoFromSSD(const std::string &sub, std::string &result);
 unsigned long long streamToInt(const std::string &stream);
+std::string rebindLocalPort(const std::string &config, int from, int to);
 
 #endif // SPEEDTESTUTIL_H_INCLUDED
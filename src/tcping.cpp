@@ -4,14 +4,18 @@
 #include "misc.h"
 #include "socket.h"
 #include "printout.h"
+#include "printmsg.h"
 #include "logger.h"
 #include "nodeinfo.h"
+#include "profile.h"
+#include "deadline.h"
 
 using namespace std::chrono;
 
-const int times_to_ping = 6;
+extern bool rpcmode;
+extern testProfile test_profile;
 
-void draw_progress_tping(int progress, int values[6])
+void draw_progress_tping(int progress, int values[6], int times_to_ping)
 {
     std::cerr << "\r[";
     for(int i = 0; i <= progress; i++)
@@ -30,6 +34,7 @@ int tcping(nodeInfo &node)
     writeLog(LOG_TYPE_TCPING, "TCP Ping begin.");
     int retVal;
     int rawPing[6] = {};
+    int times_to_ping = test_profile.tcping_count;
 
     std::string host, addr, addrstr;
     int port;
@@ -60,6 +65,11 @@ int tcping(nodeInfo &node)
     //simpleSend(addr, port, "."); //establish connection
     while((loopcounter < times_to_ping))
     {
+        if(deadlineExpired())
+        {
+            writeLog(LOG_TYPE_TCPING, "Node deadline reached. Stop now.");
+            break;
+        }
         auto start = steady_clock::now();
         retVal = simpleSend(addr, port, ".");
         auto end = steady_clock::now();
@@ -70,15 +80,16 @@ int tcping(nodeInfo &node)
             succeedcounter++;
             rawPing[loopcounter] = deltatime;
             totduration += deltatime;
-            writeLog(LOG_TYPE_TCPING, "Probing " + addrstr + ":" + std::to_string(port) + "/tcp - Port is open - time=" + std::to_string(deltatime) + "ms");
+            writeLog(LOG_TYPE_TCPING, [&]{ return "Probing " + addrstr + ":" + std::to_string(port) + "/tcp - Port is open - time=" + std::to_string(deltatime) + "ms"; }, LOG_LEVEL_VERBOSE);
         }
         else
         {
             failcounter++;
             rawPing[loopcounter] = 0;
-            writeLog(LOG_TYPE_TCPING, "Probing " + addrstr + ":" + std::to_string(port) + "/tcp - No response - time=" + std::to_string(deltatime) + "ms");
+            writeLog(LOG_TYPE_TCPING, [&]{ return "Probing " + addrstr + ":" + std::to_string(port) + "/tcp - No response - time=" + std::to_string(deltatime) + "ms"; }, LOG_LEVEL_VERBOSE);
         }
-        draw_progress_tping(loopcounter, rawPing);
+        printMsg(SPEEDTEST_MESSAGE_GOTPROBE, rpcmode, std::to_string(node.id), "tcp", std::to_string(loopcounter), retVal != SOCKET_ERROR ? "true" : "false", std::to_string(deltatime));
+        draw_progress_tping(loopcounter, rawPing, times_to_ping);
         loopcounter++;
         if(loopcounter < times_to_ping)
         {
@@ -95,7 +106,8 @@ int tcping(nodeInfo &node)
     if(succeedcounter > 0)
         pingval = totduration * 1.0 / succeedcounter;
     char strtmp[16] = {};
-    float pkLoss = failcounter * 100.0 / times_to_ping;
+    //probes never sent because the deadline ran out count as lost, an untested node must not look reachable
+    float pkLoss = (times_to_ping - succeedcounter) * 100.0 / times_to_ping;
     snprintf(strtmp, sizeof(strtmp), "%0.2f%%", pkLoss);
     node.pkLoss.assign(strtmp);
     snprintf(strtmp, sizeof(strtmp), "%0.2f", pingval);
@@ -0,0 +1,216 @@
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+
+#include "trace.h"
+#include "logger.h"
+#include "misc.h"
+
+using namespace std::chrono;
+
+bool trace_enabled = false;
+
+struct traceEvent
+{
+    const char *name;
+    char phase;
+    int node_id;
+    long long ts;
+    std::string args;
+};
+
+//each thread appends to its own buffer, the lock is only ever contended while exporting
+struct traceBuffer
+{
+    int tid = 0;
+    std::mutex lock;
+    std::string thread_name;
+    std::deque<traceEvent> events;
+    unsigned long long dropped = 0;
+};
+
+//web and daemon mode run for days, so the oldest events of a thread and the buffers of the oldest finished threads are dropped
+static const size_t trace_thread_events = 65536;
+static const size_t trace_finished_threads = 256;
+
+typedef std::lock_guard<std::mutex> guarded_mutex;
+static std::mutex trace_registry_mutex;
+static std::vector<std::shared_ptr<traceBuffer>> trace_buffers;
+static std::atomic_int trace_next_tid(1);
+static steady_clock::time_point trace_epoch = steady_clock::now();
+static thread_local std::shared_ptr<traceBuffer> trace_local;
+
+static traceBuffer &traceGetBuffer()
+{
+    if(!trace_local)
+    {
+        trace_local = std::make_shared<traceBuffer>();
+        trace_local->tid = trace_next_tid++;
+        guarded_mutex guard(trace_registry_mutex);
+        //only the registry still holds the buffer of a finished thread
+        size_t finished = std::count_if(trace_buffers.begin(), trace_buffers.end(), [](const std::shared_ptr<traceBuffer> &x) { return x.use_count() == 1; });
+        for(auto iter = trace_buffers.begin(); finished > trace_finished_threads && iter != trace_buffers.end();)
+        {
+            if(iter->use_count() == 1)
+            {
+                iter = trace_buffers.erase(iter);
+                finished--;
+            }
+            else
+                iter++;
+        }
+        trace_buffers.push_back(trace_local);
+    }
+    return *trace_local;
+}
+
+static inline long long traceNow()
+{
+    return duration_cast<microseconds>(steady_clock::now() - trace_epoch).count();
+}
+
+static inline void tracePush(const char *name, char phase, int node_id, const std::string &args)
+{
+    traceBuffer &buffer = traceGetBuffer();
+    guarded_mutex guard(buffer.lock);
+    if(buffer.events.size() >= trace_thread_events)
+    {
+        buffer.events.pop_front();
+        buffer.dropped++;
+    }
+    buffer.events.push_back(traceEvent{name, phase, node_id, traceNow(), args});
+}
+
+void traceInit()
+{
+    trace_epoch = steady_clock::now();
+    traceSetThreadName("main");
+}
+
+void traceSetThreadName(const std::string &name)
+{
+    if(trace_enabled)
+    {
+        traceBuffer &buffer = traceGetBuffer();
+        guarded_mutex guard(buffer.lock);
+        buffer.thread_name = name;
+    }
+}
+
+void traceBegin(const char *name, int node_id, const std::string &args)
+{
+    if(trace_enabled)
+        tracePush(name, 'B', node_id, args);
+}
+
+void traceEnd(const char *name, int node_id)
+{
+    if(trace_enabled)
+        tracePush(name, 'E', node_id, "");
+}
+
+void traceInstant(const char *name, int node_id, const std::string &args)
+{
+    if(trace_enabled)
+        tracePush(name, 'i', node_id, args);
+}
+
+static std::string traceEscape(const std::string &str)
+{
+    std::string result;
+    result.reserve(str.size());
+    for(unsigned char c : str)
+    {
+        switch(c)
+        {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        default:
+            if(c < 0x20)
+            {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                result += buf;
+            }
+            else
+                result += c;
+        }
+    }
+    return result;
+}
+
+static std::string traceArgs(const traceEvent &event)
+{
+    std::string args = "{\"node\":" + std::to_string(event.node_id);
+    if(event.args.size())
+        args += ",\"detail\":\"" + traceEscape(event.args) + "\"";
+    return args + "}";
+}
+
+//not for signal handlers, it allocates and writes files
+int traceExport(const std::string &path_prefix)
+{
+    static bool exported = false;
+    if(!trace_enabled)
+        return 0;
+    guarded_mutex guard(trace_registry_mutex);
+    if(exported)
+        return 0;
+    exported = true;
+    std::string pid = std::to_string(getpid()), chrome = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", jsonl;
+    bool first = true;
+    size_t count = 0;
+    unsigned long long dropped = 0;
+    for(auto &x : trace_buffers)
+    {
+        std::string tid = std::to_string(x->tid), thread_name;
+        std::deque<traceEvent> events;
+        {
+            guarded_mutex buffer_guard(x->lock);
+            thread_name = x->thread_name;
+            events = x->events;
+            dropped += x->dropped;
+        }
+        if(thread_name.size())
+        {
+            chrome += std::string(first ? "" : ",") + "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"args\":{\"name\":\"" + traceEscape(thread_name) + "\"}}";
+            first = false;
+        }
+        for(auto &y : events)
+        {
+            std::string ts = std::to_string(y.ts), phase(1, y.phase), args = traceArgs(y);
+            chrome += std::string(first ? "" : ",") + "\n{\"name\":\"" + y.name + "\",\"cat\":\"speedtest\",\"ph\":\"" + phase + "\",\"ts\":" + ts + ",\"pid\":" + pid + ",\"tid\":" + tid;
+            if(y.phase == 'i')
+                chrome += ",\"s\":\"t\"";
+            chrome += ",\"args\":" + args + "}";
+            jsonl += "{\"ts\":" + ts + ",\"ph\":\"" + phase + "\",\"name\":\"" + y.name + "\",\"tid\":" + tid + ",\"args\":" + args + "}\n";
+            first = false;
+            count++;
+        }
+    }
+    chrome += "\n]}\n";
+    fileWrite(path_prefix + ".trace.json", chrome, true);
+    fileWrite(path_prefix + ".trace.jsonl", jsonl, true);
+    writeLog(LOG_TYPE_INFO, "Exported " + std::to_string(count) + " trace event(s) to " + path_prefix + ".trace.json ." + (dropped ? " " + std::to_string(dropped) + " older event(s) were dropped." : ""));
+    return 0;
+}
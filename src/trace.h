@@ -0,0 +1,38 @@
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+#include <string>
+
+#include "misc.h"
+
+extern bool trace_enabled;
+
+void traceInit();
+void traceSetThreadName(const std::string &name);
+void traceBegin(const char *name, int node_id = -1, const std::string &args = "");
+void traceEnd(const char *name, int node_id = -1);
+void traceInstant(const char *name, int node_id = -1, const std::string &args = "");
+int traceExport(const std::string &path_prefix);
+
+//name must be a string literal, events only keep the pointer
+class traceScope
+{
+public:
+    traceScope(const char *name, int node_id = -1, const std::string &args = "") : _name(name), _node_id(node_id)
+    {
+        if(trace_enabled)
+            traceBegin(_name, _node_id, args);
+    }
+    ~traceScope()
+    {
+        if(trace_enabled)
+            traceEnd(_name, _node_id);
+    }
+private:
+    const char *_name;
+    int _node_id;
+};
+
+#define TRACE_SCOPE(...) traceScope DO_CONCAT(__trace_scope_,__LINE__) (__VA_ARGS__)
+
+#endif // TRACE_H_INCLUDED
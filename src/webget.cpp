@@ -9,6 +9,7 @@
 #include "version.h"
 #include "misc.h"
 #include "logger.h"
+#include "deadline.h"
 
 #ifdef _WIN32
 #ifndef _stat
@@ -69,7 +70,7 @@ static inline void curl_set_common_options(CURL *curl_handle, const char *url, l
     curl_easy_setopt(curl_handle, CURLOPT_MAXREDIRS, 20L);
     curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0L);
     curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 0L);
-    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 15L);
+    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT_MS, (long)deadlineRemaining(15000));
     curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, user_agent_str.data());
     if(max_file_size)
         curl_easy_setopt(curl_handle, CURLOPT_MAXFILESIZE, max_file_size);
@@ -130,7 +131,7 @@ static int curlGet(const FetchArgument argument, FetchResult &result)
     while(true)
     {
         *result.status_code = curl_easy_perform(curl_handle);
-        if(*result.status_code == CURLE_OK || max_fails >= fail_count)
+        if(*result.status_code == CURLE_OK || max_fails >= fail_count || deadlineExpired())
             break;
         else
             fail_count++;
@@ -14,6 +14,9 @@
 #include "printout.h"
 #include "renderer.h"
 #include "speedtestutil.h"
+#include "history.h"
+#include "daemon.h"
+#include "cluster.h"
 
 std::atomic<bool> start_flag = false;
 std::atomic<time_t> done_time = 0;
@@ -27,11 +30,15 @@ extern std::vector<color> custom_color_groups;
 extern std::vector<int> custom_color_bounds;
 extern string_array custom_exclude_remarks, custom_include_remarks;
 extern unsigned int node_count;
+extern double history_regression_threshold;
+extern std::string default_test_profile;
+extern bool worker_mode;
 
 //functions from main
 void addNodes(std::string link, bool multilink);
 void rewriteNodeID(std::vector<nodeInfo> &nodes);
 void batchTest(std::vector<nodeInfo> &nodes);
+bool selectTestProfile(const std::string &name);
 
 //webui variables
 std::vector<nodeInfo> targetNodes, testedNodes;
@@ -119,7 +126,7 @@ void json_write_node(rapidjson::Writer<rapidjson::StringBuffer> &writer, nodeInf
     writer.Key("gPingLoss");
     writer.Double(counter / total * 1.0);
     writer.Key("webPageSimulation");
-    writer.String("N/A");
+    writer.String(node.pageLoad.data());
     writer.Key("geoIP");
     writer.StartObject();
     writer.Key("inbound");
@@ -145,6 +152,46 @@ void json_write_node(rapidjson::Writer<rapidjson::StringBuffer> &writer, nodeInf
     writer.Double(ssrspeed_get_speed_number(node.avgSpeed));
     writer.Key("trafficUsed");
     writer.Int(node.totalRecvBytes);
+    writer.Key("socketOptions");
+    writer.String(node.socketOptions.data());
+    writer.Key("phaseDuration");
+    writer.StartObject();
+    for(int i = 0; i < NODE_PHASE_COUNT; i++)
+    {
+        writer.Key(node_phase_names[i]);
+        writer.Int(node.phaseDuration[i]);
+    }
+    writer.EndObject();
+    writer.Key("testFile");
+    writer.String(node.testFile.data());
+    writer.Key("screenOnly");
+    writer.Bool(node.screenOnly);
+    writer.Key("cachedTime");
+    writer.Int64(node.cachedTime);
+    writer.Key("screenSpeed");
+    writer.String(node.screenSpeed.data());
+    writer.Key("mirrorProbe");
+    writer.String(node.mirrorProbe.data());
+    writer.Key("connRate");
+    writer.String(node.connRate.data());
+    writer.Key("reqRate");
+    writer.String(node.reqRate.data());
+    writer.Key("loadTest");
+    writer.String(node.loadTest.data());
+    writer.Key("pageLoadPath");
+    writer.String(node.pageLoadPath.data());
+    writer.Key("mirrors");
+    writer.StartArray();
+    for(size_t i = 0; i < node.testMirrors.size(); i++)
+    {
+        writer.StartObject();
+        writer.Key("url");
+        writer.String(node.testMirrors[i].data());
+        writer.Key("speed");
+        writer.Uint64(i < node.mirrorSpeed.size() ? node.mirrorSpeed[i] : 0);
+        writer.EndObject();
+    }
+    writer.EndArray();
 }
 
 std::string ssrspeed_generate_results(std::vector<nodeInfo> &nodes)
@@ -272,6 +319,206 @@ std::string ssrspeed_generate_color()
     return sb.GetString();
 }
 
+void json_write_history_node(rapidjson::Writer<rapidjson::StringBuffer> &writer, const historyNode &node)
+{
+    writer.Key("key");
+    writer.String(historyKeyString(node.key).data());
+    writer.Key("identity");
+    writer.String(node.identity.data());
+    writer.Key("group");
+    writer.String(node.group.data());
+    writer.Key("remarks");
+    writer.String(node.remarks.data());
+}
+
+void json_write_history_record(rapidjson::Writer<rapidjson::StringBuffer> &writer, const historyRecord &record)
+{
+    writer.StartObject();
+    writer.Key("time");
+    writer.Int64(record.time);
+    writer.Key("online");
+    writer.Bool(record.flags & HISTORY_FLAG_ONLINE);
+    writer.Key("ping");
+    writer.Double(record.avg_ping);
+    writer.Key("loss");
+    writer.Double(record.pk_loss / 100.0);
+    writer.Key("gPing");
+    writer.Double(record.site_ping);
+    writer.Key("dspeed");
+    writer.Uint64(record.avg_speed);
+    writer.Key("maxDSpeed");
+    writer.Uint64(record.max_speed);
+    writer.Key("uspeed");
+    writer.Uint64(record.ul_speed);
+    writer.Key("trafficUsed");
+    writer.Uint64(record.traffic);
+    writer.EndObject();
+}
+
+std::string history_generate_node(const std::string &query, int hours)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    std::vector<historyNode> matched;
+    time_t from = hours > 0 ? time(NULL) - hours * 3600LL : 0;
+
+    historyFindNodes(query, matched);
+    writer.StartArray();
+    for(historyNode &x : matched)
+    {
+        std::vector<historyRecord> records;
+        historyNodeRecords(x.key, from, 0, records);
+        writer.StartObject();
+        json_write_history_node(writer, x);
+        writer.Key("records");
+        writer.StartArray();
+        for(historyRecord &y : records)
+            json_write_history_record(writer, y);
+        writer.EndArray();
+        writer.EndObject();
+    }
+    writer.EndArray();
+    return sb.GetString();
+}
+
+std::string history_generate_best(int hours, unsigned int count)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    std::vector<historySummary> summaries;
+
+    historyBestNodes(hours, count, summaries);
+    writer.StartArray();
+    for(historySummary &x : summaries)
+    {
+        writer.StartObject();
+        json_write_history_node(writer, x.node);
+        writer.Key("runs");
+        writer.Uint(x.runs);
+        writer.Key("onlineRuns");
+        writer.Uint(x.online_runs);
+        writer.Key("avgSpeed");
+        writer.Double(x.avg_speed);
+        writer.Key("avgPing");
+        writer.Double(x.avg_ping);
+        writer.Key("best");
+        json_write_history_record(writer, x.best);
+        writer.Key("latest");
+        json_write_history_record(writer, x.latest);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    return sb.GetString();
+}
+
+std::string history_generate_regressions(int hours, double threshold)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    std::vector<historyRegression> regressions;
+
+    historyRegressions(hours, threshold, regressions);
+    writer.StartArray();
+    for(historyRegression &x : regressions)
+    {
+        writer.StartObject();
+        json_write_history_node(writer, x.node);
+        writer.Key("reason");
+        writer.String(x.reason.data());
+        writer.Key("baselineSpeed");
+        writer.Double(x.baseline_speed);
+        writer.Key("baselinePing");
+        writer.Double(x.baseline_ping);
+        writer.Key("latest");
+        json_write_history_record(writer, x.latest);
+        writer.EndObject();
+    }
+    writer.EndArray();
+    return sb.GetString();
+}
+
+std::string daemon_generate_nodes(bool with_history)
+{
+    rapidjson::StringBuffer sb;
+    rapidjson::Writer<rapidjson::StringBuffer> writer(sb);
+    std::vector<daemonNodeState> nodes;
+    daemonStatus status;
+
+    daemonSnapshot(nodes, status);
+    writer.StartObject();
+    writer.Key("started");
+    writer.Int64(status.started);
+    writer.Key("lastRefresh");
+    writer.Int64(status.last_refresh);
+    writer.Key("nextRefresh");
+    writer.Int64(status.next_refresh);
+    writer.Key("tests");
+    writer.Uint(status.tests);
+    writer.Key("sweeps");
+    writer.Uint(status.sweeps);
+    writer.Key("triggered");
+    writer.Uint(status.triggered);
+    writer.Key("current");
+    writer.String(status.current.data());
+    writer.Key("nodes");
+    writer.StartArray();
+    for(daemonNodeState &x : nodes)
+    {
+        writer.StartObject();
+        writer.Key("key");
+        writer.String(historyKeyString(historyNodeKey(x.node)).data());
+        writer.Key("lastTest");
+        writer.Int64(x.last_test);
+        writer.Key("nextTest");
+        writer.Int64(x.next_test);
+        writer.Key("runs");
+        writer.Uint(x.runs);
+        writer.Key("trigger");
+        writer.String(x.trigger.data());
+        if(x.sweeps)
+        {
+            writer.Key("sweep");
+            writer.StartObject();
+            writer.Key("time");
+            writer.Int64(x.last_sweep);
+            writer.Key("next");
+            writer.Int64(x.next_sweep);
+            writer.Key("count");
+            writer.Uint(x.sweeps);
+            writer.Key("ping");
+            writer.Double(x.sweep_ping);
+            writer.Key("loss");
+            writer.Double(x.sweep_loss / 100.0);
+            writer.Key("gPing");
+            writer.Double(x.sweep_site_ping);
+            writer.Key("exitIP");
+            writer.String(x.exit_ip.data());
+            writer.EndObject();
+        }
+        if(x.runs)
+            json_write_node(writer, x.node);
+        else
+        {
+            writer.Key("group");
+            writer.String(x.node.group.data());
+            writer.Key("remarks");
+            writer.String(x.node.remarks.data());
+        }
+        if(with_history)
+        {
+            writer.Key("history");
+            writer.StartArray();
+            for(historyRecord &y : x.history)
+                json_write_history_record(writer, y);
+            writer.EndArray();
+        }
+        writer.EndObject();
+    }
+    writer.EndArray();
+    writer.EndObject();
+    return sb.GetString();
+}
+
 void ssrspeed_webserver_routine(const std::string &listen_address, int listen_port)
 {
     listener_args args = {listen_address, listen_port, 10, 4};
@@ -303,7 +550,7 @@ void ssrspeed_webserver_routine(const std::string &listen_address, int listen_po
 
     append_response("POST", "/readsubscriptions", "text/plain;charset=utf-8", [](RESPONSE_CALLBACK_ARGS) -> std::string
     {
-        if(start_flag)
+        if(start_flag || daemonRunning() || clusterWorkerRunning())
             return "running";
         rapidjson::Document json;
         std::string suburl;
@@ -316,22 +563,19 @@ void ssrspeed_webserver_routine(const std::string &listen_address, int listen_po
 
     append_response("POST", "/readfileconfig", "text/plain", [](RESPONSE_CALLBACK_ARGS) -> std::string
     {
+        if(start_flag || daemonRunning() || clusterWorkerRunning())
+            return "running";
         eraseElements(allNodes);
         //fileWrite("received.txt", getFormData(postdata), true);
-        if(start_flag)
-            return "running";
+        if(explodeConfContent(getFormData(request.postdata), override_conf_port, ss_libev, ssr_libev, allNodes) == SPEEDTEST_ERROR_UNRECOGFILE)
+            return "error";
         else
-        {
-            if(explodeConfContent(getFormData(request.postdata), override_conf_port, ss_libev, ssr_libev, allNodes) == SPEEDTEST_ERROR_UNRECOGFILE)
-                return "error";
-            else
-                return ssrspeed_generate_web_configs(allNodes);
-        }
+            return ssrspeed_generate_web_configs(allNodes);
     });
 
     append_response("POST", "/start", "text/plain", [](RESPONSE_CALLBACK_ARGS) -> std::string
     {
-        if(start_flag)
+        if(start_flag || daemonRunning() || clusterWorkerRunning())
             return "running";
         time_t cur_time = time(NULL);
         if(cur_time - done_time < 5)
@@ -340,6 +584,10 @@ void ssrspeed_webserver_routine(const std::string &listen_address, int listen_po
         rapidjson::Document json;
         json.Parse(request.postdata.data());
         std::string test_mode = GetMember(json, "testMode"), sort_method = GetMember(json, "sortMethod"), group = GetMember(json, "group"), exp_color = GetMember(json, "colors");
+        std::string profile = GetMember(json, "profile");
+
+        if(profile.empty() || !selectTestProfile(profile))
+            selectTestProfile(default_test_profile);
 
         if(test_mode == "ALL")
             speedtest_mode = "all";
@@ -363,6 +611,50 @@ void ssrspeed_webserver_routine(const std::string &listen_address, int listen_po
         return ssrspeed_generate_results(targetNodes);
     });
 
+    append_response("GET", "/history", "application/json;charset=utf-8", [](RESPONSE_CALLBACK_ARGS) -> std::string
+    {
+        return history_generate_node(UrlDecode(getUrlArg(request.argument, "node")), to_int(getUrlArg(request.argument, "hours"), 0));
+    });
+
+    append_response("GET", "/history/best", "application/json;charset=utf-8", [](RESPONSE_CALLBACK_ARGS) -> std::string
+    {
+        return history_generate_best(to_int(getUrlArg(request.argument, "hours"), 24), to_int(getUrlArg(request.argument, "count"), 20));
+    });
+
+    append_response("GET", "/history/regressions", "application/json;charset=utf-8", [](RESPONSE_CALLBACK_ARGS) -> std::string
+    {
+        std::string threshold = getUrlArg(request.argument, "threshold");
+        return history_generate_regressions(to_int(getUrlArg(request.argument, "hours"), 24), threshold.size() ? to_number<double>(threshold, history_regression_threshold) : history_regression_threshold);
+    });
+
+    append_response("GET", "/daemon/nodes", "application/json;charset=utf-8", [](RESPONSE_CALLBACK_ARGS) -> std::string
+    {
+        return daemon_generate_nodes(getUrlArg(request.argument, "history") == "true");
+    });
+
+    append_response("POST", "/worker/shard", "text/plain", [](RESPONSE_CALLBACK_ARGS) -> std::string
+    {
+        if(!worker_mode)
+            return "disabled";
+        if(start_flag || daemonRunning() || clusterWorkerRunning())
+            return "busy";
+        return clusterWorkerAccept(request.postdata);
+    });
+
+    append_response("GET", "/worker/results", "application/json;charset=utf-8", [](RESPONSE_CALLBACK_ARGS) -> std::string
+    {
+        if(!worker_mode)
+            return "disabled";
+        return clusterWorkerResults(getUrlArg(request.argument, "shard"), to_int(getUrlArg(request.argument, "from"), 0));
+    });
+
+    append_response("POST", "/worker/truncate", "application/json;charset=utf-8", [](RESPONSE_CALLBACK_ARGS) -> std::string
+    {
+        if(!worker_mode)
+            return "disabled";
+        return clusterWorkerTruncate(request.postdata);
+    });
+
     std::cerr << "Stair Speedtest " VERSION " Web server running @ http://" << listen_address << ":" << listen_port << std::endl;
     start_web_server_multi(&args);
 }
@@ -17,6 +17,7 @@
 #include "webserver.h"
 #include "socket.h"
 #include "logger.h"
+#include "affinity.h"
 
 extern std::string user_agent_str;
 std::atomic_bool SERVER_EXIT_FLAG(false);
@@ -290,6 +291,7 @@ int start_web_server(void *argv)
 
 void* httpserver_dispatch(void *arg)
 {
+    affinityPinService(); //keep workers off the cores used by node tests
     event_base_dispatch(reinterpret_cast<event_base*>(arg));
     event_base_free(reinterpret_cast<event_base*>(arg)); //free resources
     return NULL;